@@ -0,0 +1,102 @@
+#include "../engine/arena/arena.h"
+#include "../engine/jobs/jobs.h"
+
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Simulated frames of transient work: formatting messages and filling
+// scratch vectors, once on the global heap and once on the frame arena.
+// After a few frames to size the arena, arena frames must not call
+// operator new at all.
+
+static const int FRAMES = 200;
+static const int WARMUP_FRAMES = 3;
+static const int MESSAGES = 2000;
+static const int SCRATCH = 64;
+
+template<typename String>
+static void appendNumber(String& string, const int value) {
+	char digits[16];
+	const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+	string.append(digits, result.ptr);
+}
+
+// One frame's worth of work; returns a checksum so nothing is optimized
+// away.
+template<typename String, typename Vector, typename Make>
+static size_t frame(const int index, const Make& make) {
+	size_t checksum = 0;
+
+	for (int message = 0; message < MESSAGES; ++message) {
+		String line = make.template operator()<String>();
+		line += "TT::Frame: object ";
+		appendNumber(line, message);
+		line += " of frame ";
+		appendNumber(line, index);
+		line += " moved past the streaming radius";
+
+		Vector scratch = make.template operator()<Vector>();
+		for (int i = 0; i < SCRATCH; ++i) scratch.push_back((uint32_t)(message * i));
+
+		checksum += line.size() + scratch.back();
+	}
+
+	return checksum;
+}
+
+int main() {
+	// The arena belongs to the thread that starts the jobs.
+	Engine::Jobs::init(1);
+
+	const auto heap = []<typename T>() {
+		return T();
+	};
+	const auto arena = []<typename T>() {
+		return T(&Engine::FrameArena::get());
+	};
+
+	size_t checksum = 0;
+	uint64_t heapAllocations = 0, arenaAllocations = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int index = 0; index < FRAMES; ++index) {
+		checksum += frame<std::string, std::vector<uint32_t>>(index, heap);
+		Engine::FrameArena::reset();
+
+		if (index >= WARMUP_FRAMES) heapAllocations += Engine::FrameArena::getFrameHeapAllocationCount();
+	}
+	const double heapTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for (int index = 0; index < FRAMES; ++index) {
+		checksum += frame<std::pmr::string, std::pmr::vector<uint32_t>>(index, arena);
+		Engine::FrameArena::reset();
+
+		if (index >= WARMUP_FRAMES) arenaAllocations += Engine::FrameArena::getFrameHeapAllocationCount();
+	}
+	const double arenaTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const Engine::FrameArena& frameArena = Engine::FrameArena::get();
+	const int measured = FRAMES - WARMUP_FRAMES;
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << FRAMES << " frames of " << MESSAGES << " messages and scratch vectors (checksum " << checksum << ")" << std::endl;
+	std::cout << std::setw(12) << std::left << "heap" << heapTime / FRAMES << " ms/frame, "
+		<< (double)heapAllocations / measured << " operator new calls/frame" << std::endl;
+	std::cout << std::setw(12) << std::left << "arena" << arenaTime / FRAMES << " ms/frame (" << heapTime / arenaTime << "x), "
+		<< (double)arenaAllocations / measured << " operator new calls/frame, "
+		<< frameArena.getPeak() / 1024 << " KiB peak in " << frameArena.getCapacity() / 1024 << " KiB" << std::endl;
+
+	Engine::Jobs::shutdown();
+
+	if (arenaAllocations) {
+		std::cout << "HEAP ALLOCATIONS in steady arena frames" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
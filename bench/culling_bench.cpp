@@ -0,0 +1,158 @@
+#include "../engine/camera/camera.h"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Culls 1M bounding spheres and boxes against a camera frustum: a plain
+// per-object loop over array-of-structs bounds as the reference, then
+// FrustumCulling with every backend the CPU supports. All backends must
+// return the same list as the scalar one.
+
+static const size_t OBJECTS = 1000000;
+static const int RUNS = 10;
+
+struct Object {
+	glm::vec3 center;
+	float radius;
+	glm::vec3 min, max;
+};
+
+static double measure(const std::function<void()>& operation) {
+	double best = 1e30;
+
+	for (int run = 0; run < RUNS; ++run) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		operation();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+static void referenceSpheres(const Engine::Frustum& frustum, const std::vector<Object>& objects, std::vector<uint32_t>& visible) {
+	visible.clear();
+
+	for (size_t i = 0; i < objects.size(); ++i) {
+		bool inside = true;
+
+		for (const glm::vec4& plane : frustum.planes) {
+			if (glm::dot(glm::vec3(plane), objects[i].center) + plane.w < -objects[i].radius) {
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside) visible.push_back((uint32_t)i);
+	}
+}
+static void referenceBoxes(const Engine::Frustum& frustum, const std::vector<Object>& objects, std::vector<uint32_t>& visible) {
+	visible.clear();
+
+	for (size_t i = 0; i < objects.size(); ++i) {
+		bool inside = true;
+
+		// The corner furthest along the plane normal.
+		for (const glm::vec4& plane : frustum.planes) {
+			const glm::vec3 corner(plane.x >= 0.0f ? objects[i].max.x : objects[i].min.x, plane.y >= 0.0f ? objects[i].max.y : objects[i].min.y, plane.z >= 0.0f ? objects[i].max.z : objects[i].min.z);
+
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside) visible.push_back((uint32_t)i);
+	}
+}
+
+int main() {
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+	std::vector<Object> objects(OBJECTS);
+	Engine::BoundingSpheres spheres;
+	Engine::BoundingBoxes boxes;
+
+	for (Object& object : objects) {
+		object.center = glm::vec3(position(random), position(random) * 0.1f, position(random));
+		object.radius = size(random);
+		object.min = object.center - glm::vec3(size(random), size(random), size(random));
+		object.max = object.center + glm::vec3(size(random), size(random), size(random));
+
+		spheres.add(object.center, object.radius);
+		boxes.add(object.min, object.max);
+	}
+
+	Engine::Camera camera;
+	camera.setPerspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+	camera.setPosition(glm::vec3(0.0f, 20.0f, 0.0f));
+	camera.lookAt(glm::vec3(100.0f, 0.0f, -200.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	const Engine::Frustum& frustum = camera.getFrustum();
+
+	std::vector<uint32_t> referenceSphereList, referenceBoxList;
+	const double referenceSphereTime = measure([&]() {
+		referenceSpheres(frustum, objects, referenceSphereList);
+	});
+	const double referenceBoxTime = measure([&]() {
+		referenceBoxes(frustum, objects, referenceBoxList);
+	});
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << OBJECTS << " objects, best of " << RUNS << " runs, "
+		<< referenceSphereList.size() << " spheres and " << referenceBoxList.size() << " boxes visible" << std::endl;
+	std::cout << std::setw(20) << std::left << "reference" << "spheres " << referenceSphereTime << " ms, boxes " << referenceBoxTime << " ms" << std::endl;
+
+	const Engine::FrustumCulling::Backend best = Engine::FrustumCulling::getBackend();
+	std::vector<uint32_t> scalarSpheres, scalarBoxes;
+	bool matching = true;
+
+	for (int backend = Engine::FrustumCulling::SCALAR; backend <= best; ++backend) {
+		Engine::FrustumCulling::setBackend((Engine::FrustumCulling::Backend)backend);
+
+		std::vector<uint32_t> visible(OBJECTS + Engine::FrustumCulling::OUTPUT_PADDING);
+		size_t sphereCount = 0, boxCount = 0;
+
+		const double sphereTime = measure([&]() {
+			sphereCount = Engine::FrustumCulling::cull(frustum, spheres, visible.data());
+		});
+		std::vector<uint32_t> sphereList(visible.begin(), visible.begin() + sphereCount);
+
+		const double boxTime = measure([&]() {
+			boxCount = Engine::FrustumCulling::cull(frustum, boxes, visible.data());
+		});
+		std::vector<uint32_t> boxList(visible.begin(), visible.begin() + boxCount);
+
+		if (backend == Engine::FrustumCulling::SCALAR) {
+			scalarSpheres = sphereList;
+			scalarBoxes = boxList;
+		}
+		else if (sphereList != scalarSpheres || boxList != scalarBoxes) {
+			matching = false;
+		}
+
+		std::cout << std::setw(20) << std::left << Engine::FrustumCulling::getBackendName((Engine::FrustumCulling::Backend)backend)
+			<< "spheres " << sphereTime << " ms (" << referenceSphereTime / sphereTime << "x), boxes " << boxTime << " ms (" << referenceBoxTime / boxTime << "x)" << std::endl;
+	}
+
+	// The reference rounds differently, so objects touching a plane may
+	// land on either side; report how many.
+	const long sphereDifference = (long)scalarSpheres.size() - (long)referenceSphereList.size();
+	const long boxDifference = (long)scalarBoxes.size() - (long)referenceBoxList.size();
+	if (sphereDifference || boxDifference) {
+		std::cout << "boundary differences to reference: " << sphereDifference << " spheres, " << boxDifference << " boxes" << std::endl;
+	}
+
+	if (!matching) {
+		std::cout << "MISMATCH between backends" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,205 @@
+#include "../engine/ecs/ecs.h"
+#include "../engine/scheduler/scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Moves 100k objects by their velocity, once through a heap-allocated class
+// hierarchy and once through World, where the update reads only the
+// position and velocity columns and skips the cold data beside them. Then
+// runs three independent systems one after another and through Scheduler.
+
+static const size_t ENTITIES = 100000;
+static const int RUNS = 20;
+static const float DT = 1.0f / 60.0f;
+
+struct Position {
+	float x, y, z;
+};
+struct Velocity {
+	float x, y, z;
+};
+struct Health {
+	float current, maximum;
+};
+struct Name {
+	char text[48];
+};
+struct Matrix {
+	float values[16];
+};
+
+class GameObject {
+public:
+	Position position;
+	Matrix transform;
+	Name name;
+
+	virtual ~GameObject() = default;
+	virtual void update(const float dt) = 0;
+};
+class Actor : public GameObject {
+public:
+	Velocity velocity;
+	Health health;
+
+	void update(const float dt) override {
+		this->position.x += this->velocity.x * dt;
+		this->position.y += this->velocity.y * dt;
+		this->position.z += this->velocity.z * dt;
+	}
+};
+class Prop : public GameObject {
+public:
+	void update(const float) override {
+	}
+};
+
+static double measure(const std::function<void()>& operation) {
+	double best = 1e30;
+
+	for (int run = 0; run < RUNS; ++run) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		operation();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+int main() {
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	std::vector<Velocity> velocities(ENTITIES);
+	for (Velocity& velocity : velocities) velocity = { distribution(random), distribution(random), distribution(random) };
+
+	// Objects are allocated between other allocations and updated in a
+	// shuffled order, the way a long-running scene ends up.
+	std::vector<std::unique_ptr<GameObject>> objects;
+	std::vector<std::unique_ptr<char[]>> noise;
+
+	for (size_t i = 0; i < ENTITIES; ++i) {
+		std::unique_ptr<GameObject> object;
+
+		if (i % 4 == 3) {
+			object = std::make_unique<Prop>();
+		}
+		else {
+			std::unique_ptr<Actor> actor = std::make_unique<Actor>();
+			actor->velocity = velocities[i];
+			actor->health = { 100.0f, 100.0f };
+			object = std::move(actor);
+		}
+
+		object->position = { 0.0f, 0.0f, 0.0f };
+		std::memset(&object->transform, 0, sizeof(Matrix));
+		std::memset(&object->name, 0, sizeof(Name));
+
+		objects.push_back(std::move(object));
+		noise.push_back(std::make_unique<char[]>(64 + random() % 192));
+	}
+	std::shuffle(objects.begin(), objects.end(), random);
+
+	Engine::World world;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < ENTITIES; ++i) {
+		if (i % 4 == 3) {
+			world.create(Position{ 0.0f, 0.0f, 0.0f }, Matrix{}, Name{});
+		}
+		else {
+			world.create(Position{ 0.0f, 0.0f, 0.0f }, Matrix{}, Name{}, velocities[i], Health{ 100.0f, 100.0f });
+		}
+	}
+	const double createTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	Engine::World::Query<Position, const Velocity> movers = world.query<Position, const Velocity>();
+
+	const double objectTime = measure([&objects]() {
+		for (std::unique_ptr<GameObject>& object : objects) object->update(DT);
+	});
+	const double worldTime = measure([&movers]() {
+		movers.each([](Position& position, const Velocity& velocity) {
+			position.x += velocity.x * DT;
+			position.y += velocity.y * DT;
+			position.z += velocity.z * DT;
+		});
+	});
+
+	double objectSum = 0.0, worldSum = 0.0;
+	for (std::unique_ptr<GameObject>& object : objects) objectSum += object->position.x + object->position.y + object->position.z;
+	world.query<const Position>().each([&worldSum](const Position& position) {
+		worldSum += position.x + position.y + position.z;
+	});
+
+	// Independent systems: serial queries against the scheduler, which
+	// overlaps them and splits their chunks across workers.
+	Engine::World::Query<Health> healers = world.query<Health>();
+	Engine::World::Query<Matrix> spinners = world.query<Matrix>();
+
+	const auto heal = [](Health& health) {
+		health.current = std::min(health.maximum, health.current + DT);
+	};
+	const auto spin = [](Matrix& matrix) {
+		for (int i = 0; i < 16; ++i) matrix.values[i] = matrix.values[i] * 0.99f + (float)i * DT;
+	};
+	const auto move = [](Position& position, const Velocity& velocity) {
+		position.x += velocity.x * DT;
+		position.y += velocity.y * DT;
+		position.z += velocity.z * DT;
+	};
+
+	const double serialTime = measure([&]() {
+		movers.each(move);
+		healers.each(heal);
+		spinners.each(spin);
+	});
+
+	Engine::Scheduler scheduler(world);
+	scheduler.add<Position, const Velocity>("move", move);
+	scheduler.add<Health>("heal", heal);
+	scheduler.add<Matrix>("spin", spin);
+
+	const double scheduledTime = measure([&scheduler]() {
+		scheduler.run();
+	});
+	const size_t threadCount = Engine::Jobs::getThreadCount();
+
+	Engine::Jobs::shutdown();
+
+	// Structural changes recorded during iteration, applied afterwards.
+	Engine::CommandBuffer commands;
+	world.query<const Velocity>().each([&commands](const Engine::Entity entity, const Velocity& velocity) {
+		if (velocity.x < 0.0f) commands.remove<Velocity>(entity);
+	});
+
+	start = std::chrono::steady_clock::now();
+	const size_t commandCount = commands.size();
+	commands.apply(world);
+	const double applyTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << ENTITIES << " entities, best of " << RUNS << " runs" << std::endl;
+	std::cout << std::setw(28) << std::left << "class hierarchy update" << objectTime << " ms" << std::endl;
+	std::cout << std::setw(28) << std::left << "World query update" << worldTime << " ms  (" << objectTime / worldTime << "x)" << std::endl;
+	std::cout << std::setw(28) << std::left << "3 systems, serial" << serialTime << " ms" << std::endl;
+	std::cout << std::setw(28) << std::left << "3 systems, Scheduler" << scheduledTime << " ms  (" << serialTime / scheduledTime << "x, " << threadCount << " threads)" << std::endl;
+	std::cout << std::setw(28) << std::left << "World create" << createTime << " ms" << std::endl;
+	std::cout << std::setw(28) << std::left << "CommandBuffer apply" << applyTime << " ms  (" << commandCount << " removes)" << std::endl;
+	std::cout << world.getArchetypeCount() << " archetypes, " << world.getChunkCount() << " chunks of " << Engine::World::CHUNK_SIZE << " bytes" << std::endl;
+
+	if (std::abs(objectSum - worldSum) > 1e-3 * std::max(1.0, std::abs(objectSum))) {
+		std::cout << "MISMATCH: " << objectSum << " vs " << worldSum << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
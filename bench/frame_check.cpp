@@ -0,0 +1,111 @@
+#include "../engine/engine.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Real frames through Window::swapBuffers, with textures held by the
+// texture cache and the streamer and a line logged every frame. Once the
+// streamed textures are in and a few frames have sized the frame arena,
+// no frame may call operator new. Opens a window, so it is not part of
+// the CPU benchmarks: `zig build frame-check`.
+
+static const int TEXTURES = 8;
+static const int SIZE = 256;
+static const int MAX_LOADING_FRAMES = 600;
+static const int WARMUP_FRAMES = 3;
+static const int FRAMES = 120;
+
+// A binary PPM, which stb_image reads without any encoder around.
+static std::string writeImage(const std::filesystem::path& directory, const int index) {
+	const std::string path = (directory / ("texture" + std::to_string(index) + ".ppm")).string();
+
+	std::vector<uint8_t> pixels((size_t)SIZE * SIZE * 3);
+	for (int y = 0; y < SIZE; ++y) {
+		for (int x = 0; x < SIZE; ++x) {
+			uint8_t* pixel = &pixels[((size_t)y * SIZE + x) * 3];
+			pixel[0] = (uint8_t)x;
+			pixel[1] = (uint8_t)y;
+			pixel[2] = (uint8_t)(index * 32);
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << SIZE << " " << SIZE << "\n255\n";
+	file.write((const char*)pixels.data(), (std::streamsize)pixels.size());
+
+	return path;
+}
+
+int main() {
+	Engine::WindowCreateInfo info;
+	info.title = "frame_check";
+	info.vSyncEnabled = false;
+
+	Engine::Window::create(info);
+
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "frame_check";
+	std::filesystem::create_directories(directory);
+
+	std::vector<Engine::TextureCache::Handle> cached;
+	std::vector<Engine::TextureStreamer::Handle> streamed;
+
+	for (int i = 0; i < TEXTURES; ++i) {
+		cached.push_back(Engine::TextureCache::acquire(writeImage(directory, i), Engine::TextureCreateInfo(GL_LINEAR)));
+		streamed.push_back(Engine::TextureStreamer::request(writeImage(directory, TEXTURES + i), GL_LINEAR));
+	}
+
+	int loadingFrames = 0;
+	for (; loadingFrames < MAX_LOADING_FRAMES; ++loadingFrames) {
+		bool ready = true;
+		for (const Engine::TextureStreamer::Handle handle : streamed) ready = ready && Engine::TextureStreamer::isReady(handle);
+		if (ready) break;
+
+		Engine::Window::pollEvents();
+		Engine::Window::swapBuffers();
+	}
+
+	if (loadingFrames == MAX_LOADING_FRAMES) {
+		std::cout << "frame_check: Streamed textures not ready after " << MAX_LOADING_FRAMES << " frames" << std::endl;
+		return 1;
+	}
+
+	uint64_t allocations = 0;
+	int allocatingFrames = 0;
+
+	for (int frame = 0; frame < WARMUP_FRAMES + FRAMES; ++frame) {
+		Engine::Window::pollEvents();
+
+		for (int i = 0; i < TEXTURES; ++i) {
+			Engine::Texture::bind(Engine::TextureCache::get(cached[i]), 0);
+			Engine::Texture::bind(Engine::TextureStreamer::get(streamed[i]), 1);
+		}
+		Logger::Log(Logger::INFO, "frame_check: Frame ", frame, " bound ", TEXTURES * 2, " textures.");
+
+		Engine::Window::swapBuffers();
+
+		if (frame < WARMUP_FRAMES) continue;
+
+		const uint64_t count = Engine::FrameArena::getFrameHeapAllocationCount();
+		allocations += count;
+		if (count) allocatingFrames++;
+	}
+
+	std::cout << "frame_check: " << TEXTURES << " cached and " << TEXTURES << " streamed textures, ready after " << loadingFrames << " frames" << std::endl;
+	std::cout << "  " << FRAMES << " steady frames: " << allocations << " operator new calls in " << allocatingFrames << " frames" << std::endl;
+
+	for (const Engine::TextureCache::Handle handle : cached) Engine::TextureCache::release(handle);
+	for (const Engine::TextureStreamer::Handle handle : streamed) Engine::TextureStreamer::clear(handle);
+
+	Engine::Window::close();
+	std::filesystem::remove_all(directory);
+
+	if (allocations) {
+		std::cout << "HEAP ALLOCATIONS in steady frames" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
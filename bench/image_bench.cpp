@@ -0,0 +1,117 @@
+#include "../engine/image/image.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Compares ImageProcessing against naive per-pixel loops on a 4K RGBA
+// image, for every backend the CPU supports, and checks that all backends
+// agree with the scalar one.
+
+static const int WIDTH = 3840, HEIGHT = 2160;
+static const int RUNS = 10;
+
+static double measure(std::vector<uint8_t>& image, const std::vector<uint8_t>& source, const std::function<void(uint8_t*)>& operation) {
+	double best = 1e30;
+
+	for (int run = 0; run < RUNS; ++run) {
+		std::memcpy(image.data(), source.data(), source.size());
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		operation(image.data());
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+static void naivePremultiply(uint8_t* rgba) {
+	for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; ++i) {
+		uint8_t* pixel = rgba + i * 4;
+		for (int c = 0; c < 3; ++c) pixel[c] = (uint8_t)std::lround(pixel[c] * pixel[3] / 255.0);
+	}
+}
+static void naiveSrgbToLinear(uint8_t* rgba) {
+	for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; ++i) {
+		uint8_t* pixel = rgba + i * 4;
+
+		for (int c = 0; c < 3; ++c) {
+			const double value = pixel[c] / 255.0;
+			pixel[c] = (uint8_t)std::lround(255.0 * (value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4)));
+		}
+	}
+}
+static void naiveSwizzle(uint8_t* rgba) {
+	for (size_t i = 0; i < (size_t)WIDTH * HEIGHT; ++i) std::swap(rgba[i * 4], rgba[i * 4 + 2]);
+}
+static void naiveDownsample(const uint8_t* source, uint8_t* destination) {
+	for (int y = 0; y < HEIGHT / 2; ++y) {
+		for (int x = 0; x < WIDTH / 2; ++x) {
+			for (int c = 0; c < 4; ++c) {
+				const int sum = source[((y * 2) * WIDTH + x * 2) * 4 + c] + source[((y * 2) * WIDTH + x * 2 + 1) * 4 + c]
+					+ source[((y * 2 + 1) * WIDTH + x * 2) * 4 + c] + source[((y * 2 + 1) * WIDTH + x * 2 + 1) * 4 + c];
+				destination[(y * (WIDTH / 2) + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+int main() {
+	std::vector<uint8_t> source((size_t)WIDTH * HEIGHT * 4);
+	std::mt19937 random(42);
+	for (uint8_t& byte : source) byte = (uint8_t)random();
+
+	std::vector<uint8_t> image(source.size());
+	std::vector<uint8_t> half((size_t)(WIDTH / 2) * (HEIGHT / 2) * 4);
+
+	const size_t pixels = (size_t)WIDTH * HEIGHT;
+	const uint8_t bgra[4] = { 2, 1, 0, 3 };
+
+	struct Operation {
+		const char* name;
+		std::function<void(uint8_t*)> naive, processed;
+	};
+	const Operation operations[] = {
+		{ "premultiply alpha", naivePremultiply, [&](uint8_t* rgba) { Engine::ImageProcessing::premultiplyAlpha(rgba, pixels); } },
+		{ "sRGB to linear", naiveSrgbToLinear, [&](uint8_t* rgba) { Engine::ImageProcessing::srgbToLinear(rgba, pixels); } },
+		{ "swizzle to BGRA", naiveSwizzle, [&](uint8_t* rgba) { Engine::ImageProcessing::swizzle(rgba, pixels, bgra); } },
+		{ "2x2 downsample", [&](uint8_t* rgba) { naiveDownsample(rgba, half.data()); }, [&](uint8_t* rgba) { Engine::ImageProcessing::downsample(rgba, WIDTH, HEIGHT, half.data()); } },
+	};
+
+	const Engine::ImageProcessing::Backend best = Engine::ImageProcessing::getBackend();
+	bool consistent = true;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << WIDTH << "x" << HEIGHT << " RGBA, best of " << RUNS << " runs\n";
+
+	for (const Operation& operation : operations) {
+		const double naive = measure(image, source, operation.naive);
+		std::cout << operation.name << "\n\tnaive loop: " << naive << " ms\n";
+
+		std::vector<uint8_t> reference;
+
+		for (int backend = Engine::ImageProcessing::SCALAR; backend <= best; ++backend) {
+			Engine::ImageProcessing::setBackend((Engine::ImageProcessing::Backend)backend);
+
+			const double time = measure(image, source, operation.processed);
+			std::cout << "\t" << Engine::ImageProcessing::getBackendName((Engine::ImageProcessing::Backend)backend) << ": " << time << " ms (" << naive / time << "x)\n";
+
+			std::vector<uint8_t> result = operation.name[0] == '2' ? half : image;
+			if (reference.empty()) {
+				reference = result;
+			}
+			else if (result != reference) {
+				std::cout << "\t\tmismatch against scalar!\n";
+				consistent = false;
+			}
+		}
+	}
+
+	Engine::ImageProcessing::setBackend(best);
+	return consistent ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+#include "../engine/occlusion/occlusion.h"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../include/glm/gtc/matrix_transform.hpp"
+
+// A street lined with buildings: the buildings are occluders, and 200k
+// props are scattered behind and between them. Frustum culling runs
+// first, then the occlusion test on what it leaves. Every backend must
+// rasterize the same depth buffer, and the pyramid test must never cull
+// what a test against every covered full resolution pixel keeps.
+
+static const size_t OBJECTS = 200000;
+static const int BUILDINGS = 400;
+static const int RUNS = 10;
+
+static double measure(const std::function<void()>& operation) {
+	double best = 1e30;
+
+	for (int run = 0; run < RUNS; ++run) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		operation();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return best;
+}
+
+// Unit cube as 12 triangles, three floats per vertex, as a Mesh takes it.
+static std::vector<float> createCube() {
+	static const int faces[6][4] = {
+		{ 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 },
+		{ 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 }
+	};
+
+	std::vector<float> vertices;
+	for (const int* face : faces) {
+		for (const int corner : { face[0], face[1], face[2], face[0], face[2], face[3] }) {
+			vertices.push_back(corner & 1 ? 0.5f : -0.5f);
+			vertices.push_back(corner & 2 ? 0.5f : -0.5f);
+			vertices.push_back(corner & 4 ? 0.5f : -0.5f);
+		}
+	}
+
+	return vertices;
+}
+
+// Visible when any covered pixel of the full resolution buffer is at
+// least as far as the box's nearest point.
+static bool referenceVisible(const Engine::OcclusionBuffer& buffer, const glm::mat4& viewProjection, const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 low(1e30f), high(-1e30f);
+
+	for (int corner = 0; corner < 8; ++corner) {
+		const glm::vec4 clip = viewProjection * glm::vec4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z, 1.0f);
+		if (clip.z < -clip.w) return true;
+
+		low = glm::min(low, glm::vec3(clip) / clip.w);
+		high = glm::max(high, glm::vec3(clip) / clip.w);
+	}
+
+	const Engine::OcclusionBuffer::Level& level = buffer.getLevel(0);
+	const int x0 = std::max(0, (int)std::floor((low.x * 0.5f + 0.5f) * level.width));
+	const int x1 = std::min((int)level.width - 1, (int)std::floor((high.x * 0.5f + 0.5f) * level.width));
+	const int y0 = std::max(0, (int)std::floor((low.y * 0.5f + 0.5f) * level.height));
+	const int y1 = std::min((int)level.height - 1, (int)std::floor((high.y * 0.5f + 0.5f) * level.height));
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			if (low.z * 0.5f + 0.5f <= level.depth[(size_t)y * level.stride + x]) return true;
+		}
+	}
+
+	return false;
+}
+
+int main() {
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const std::vector<float> cube = createCube();
+	std::vector<glm::mat4> buildings;
+
+	// Two rows of buildings along the street, which runs down -z.
+	for (int i = 0; i < BUILDINGS; ++i) {
+		const float side = i % 2 ? 1.0f : -1.0f;
+		const glm::vec3 size(10.0f + 10.0f * unit(random), 15.0f + 40.0f * unit(random), 12.0f + 8.0f * unit(random));
+		const glm::vec3 center(side * (12.0f + size.x * 0.5f), size.y * 0.5f, -(float)(i / 2) * 20.0f);
+
+		buildings.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), size));
+	}
+
+	Engine::BoundingBoxes boxes;
+	for (size_t i = 0; i < OBJECTS; ++i) {
+		const glm::vec3 center((unit(random) - 0.5f) * 400.0f, unit(random) * 3.0f, -unit(random) * 4000.0f);
+		const glm::vec3 extent(0.3f + unit(random), 0.3f + unit(random), 0.3f + unit(random));
+		boxes.add(center - extent, center + extent);
+	}
+
+	Engine::Camera camera;
+	camera.setPerspective(glm::radians(70.0f), 2.0f, 0.1f, 1000.0f);
+	camera.setPosition(glm::vec3(2.0f, 1.8f, 5.0f));
+	camera.lookAt(glm::vec3(-10.0f, 1.5f, -100.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<uint32_t> candidates;
+	Engine::FrustumCulling::cull(camera.getFrustum(), boxes, candidates);
+
+	Engine::OcclusionBuffer buffer(256, 128);
+	const Engine::OcclusionBuffer::Backend best = Engine::OcclusionBuffer::getBackend();
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << OBJECTS << " objects, " << candidates.size() << " in the frustum, " << BUILDINGS << " occluders at "
+		<< buffer.getWidth() << "x" << buffer.getHeight() << ", best of " << RUNS << " runs" << std::endl;
+
+	std::vector<float> scalarDepth;
+	std::vector<uint32_t> scalarVisible;
+	bool matching = true;
+
+	for (int backend = Engine::OcclusionBuffer::SCALAR; backend <= best; ++backend) {
+		Engine::OcclusionBuffer::setBackend((Engine::OcclusionBuffer::Backend)backend);
+
+		const double rasterTime = measure([&]() {
+			buffer.begin(camera.getViewProjection());
+			for (const glm::mat4& model : buildings) buffer.addOccluder(cube, 3, model);
+		});
+		const double pyramidTime = measure([&]() {
+			buffer.end();
+		});
+
+		std::vector<uint32_t> visible(candidates.size());
+		size_t visibleCount = 0;
+		const double testTime = measure([&]() {
+			visibleCount = buffer.test(boxes, candidates.data(), candidates.size(), visible.data());
+		});
+		visible.resize(visibleCount);
+
+		if (backend == Engine::OcclusionBuffer::SCALAR) {
+			scalarDepth = buffer.getLevel(0).depth;
+			scalarVisible = visible;
+		}
+		else if (buffer.getLevel(0).depth != scalarDepth || visible != scalarVisible) {
+			matching = false;
+		}
+
+		std::cout << std::setw(20) << std::left << Engine::OcclusionBuffer::getBackendName((Engine::OcclusionBuffer::Backend)backend)
+			<< "rasterize " << rasterTime << " ms, pyramid " << pyramidTime << " ms, test " << testTime << " ms, "
+			<< visibleCount << " visible" << std::endl;
+	}
+
+	size_t referenceCount = 0, missed = 0;
+	size_t next = 0;
+	for (const uint32_t index : candidates) {
+		const glm::vec3 center(boxes.x[index], boxes.y[index], boxes.z[index]);
+		const glm::vec3 extent(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]);
+		const bool visible = referenceVisible(buffer, camera.getViewProjection(), center - extent, center + extent);
+		const bool kept = next < scalarVisible.size() && scalarVisible[next] == index;
+
+		if (kept) ++next;
+		if (visible) ++referenceCount;
+		if (visible && !kept) ++missed;
+	}
+
+	std::cout << "full resolution test keeps " << referenceCount << ", the pyramid " << scalarVisible.size() << std::endl;
+
+	if (missed) {
+		std::cout << "CULLED " << missed << " objects the full resolution test keeps" << std::endl;
+		return 1;
+	}
+	if (!matching) {
+		std::cout << "MISMATCH between backends" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -15,6 +15,8 @@ pub fn build(b: *std.Build) void {
     // set a preferred release mode, allowing the user to decide how to optimize.
     const optimize = b.standardOptimizeOption(.{});
 
+    const cpp_flags = &[_][]const u8{ "-std=c++20", "-DGLM_FORCE_INTRINSICS" };
+
     const glad = b.addStaticLibrary(.{
         .name = "glad",
         .target = target,
@@ -26,6 +28,28 @@ pub fn build(b: *std.Build) void {
     });
     glad.addIncludePath(.{ .path = "include/" });
 
+    // Everything but main.cpp, shared by the game and the frame check.
+    const engine_sources = [_][]const u8{
+        "engine/engine.cpp",
+        "engine/logger/logger.cpp",
+        "engine/arena/arena.cpp",
+        "engine/memory/memory.cpp",
+        "engine/ctex/ctex.cpp",
+        "engine/atlas/atlas.cpp",
+        "engine/image/image.cpp",
+        "engine/archive/archive.cpp",
+        "engine/io/io.cpp",
+        "engine/jobs/jobs.cpp",
+        "engine/async/async.cpp",
+        "engine/ecs/ecs.cpp",
+        "engine/scheduler/scheduler.cpp",
+        "engine/transform/transform.cpp",
+        "engine/camera/camera.cpp",
+        "engine/bvh/bvh.cpp",
+        "engine/occlusion/occlusion.cpp",
+        "engine/lod/lod.cpp",
+    };
+
     const exe = b.addExecutable(.{
         .name = "3dgame",
         .target = target,
@@ -33,11 +57,8 @@ pub fn build(b: *std.Build) void {
     });
     exe.linkLibCpp();
     exe.addCSourceFiles(.{
-        .files = &.{
-            "main.cpp",
-            "engine/engine.cpp",
-            "engine/logger/logger.cpp",
-        },
+        .files = &([_][]const u8{"main.cpp"} ++ engine_sources),
+        .flags = cpp_flags,
     });
     const glfw = getGlfw(b, optimize, target);
     exe.linkLibrary(glfw);
@@ -73,6 +94,158 @@ pub fn build(b: *std.Build) void {
     // This will evaluate the `run` step rather than the default, which is "install".
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
+
+    // Offline texture cooker: `zig build texcook -- input.png output.ctex bc1`
+    const texcook = b.addExecutable(.{
+        .name = "texcook",
+        .target = target,
+        .optimize = optimize,
+    });
+    texcook.linkLibCpp();
+    texcook.addCSourceFiles(.{
+        .files = &.{
+            "tools/texcook.cpp",
+            "engine/ctex/ctex.cpp",
+            "engine/image/image.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    b.installArtifact(texcook);
+
+    const texcook_cmd = b.addRunArtifact(texcook);
+    if (b.args) |args| {
+        texcook_cmd.addArgs(args);
+    }
+
+    const texcook_step = b.step("texcook", "Cook a texture into a compressed .ctex file");
+    texcook_step.dependOn(&texcook_cmd.step);
+
+    // Asset packer: `zig build assetpack -- assets.pack --lz4 shaders textures`
+    const assetpack = b.addExecutable(.{
+        .name = "assetpack",
+        .target = target,
+        .optimize = optimize,
+    });
+    assetpack.linkLibCpp();
+    assetpack.addCSourceFiles(.{
+        .files = &.{
+            "tools/assetpack.cpp",
+            "engine/archive/archive.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    b.installArtifact(assetpack);
+
+    const assetpack_cmd = b.addRunArtifact(assetpack);
+    if (b.args) |args| {
+        assetpack_cmd.addArgs(args);
+    }
+
+    const assetpack_step = b.step("assetpack", "Pack asset files into a .pack archive");
+    assetpack_step.dependOn(&assetpack_cmd.step);
+
+    // CPU-only benchmarks: `zig build bench --release=fast`
+    const bench_step = b.step("bench", "Run the CPU benchmarks");
+
+    const image_bench = b.addExecutable(.{
+        .name = "image_bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    image_bench.linkLibCpp();
+    image_bench.addCSourceFiles(.{
+        .files = &.{
+            "bench/image_bench.cpp",
+            "engine/image/image.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    bench_step.dependOn(&b.addRunArtifact(image_bench).step);
+
+    const ecs_bench = b.addExecutable(.{
+        .name = "ecs_bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    ecs_bench.linkLibCpp();
+    ecs_bench.addCSourceFiles(.{
+        .files = &.{
+            "bench/ecs_bench.cpp",
+            "engine/ecs/ecs.cpp",
+            "engine/scheduler/scheduler.cpp",
+            "engine/jobs/jobs.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    bench_step.dependOn(&b.addRunArtifact(ecs_bench).step);
+
+    const culling_bench = b.addExecutable(.{
+        .name = "culling_bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    culling_bench.linkLibCpp();
+    culling_bench.addCSourceFiles(.{
+        .files = &.{
+            "bench/culling_bench.cpp",
+            "engine/camera/camera.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    bench_step.dependOn(&b.addRunArtifact(culling_bench).step);
+
+    const occlusion_bench = b.addExecutable(.{
+        .name = "occlusion_bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    occlusion_bench.linkLibCpp();
+    occlusion_bench.addCSourceFiles(.{
+        .files = &.{
+            "bench/occlusion_bench.cpp",
+            "engine/occlusion/occlusion.cpp",
+            "engine/camera/camera.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    bench_step.dependOn(&b.addRunArtifact(occlusion_bench).step);
+
+    const arena_bench = b.addExecutable(.{
+        .name = "arena_bench",
+        .target = target,
+        .optimize = optimize,
+    });
+    arena_bench.linkLibCpp();
+    arena_bench.addCSourceFiles(.{
+        .files = &.{
+            "bench/arena_bench.cpp",
+            "engine/arena/arena.cpp",
+            "engine/jobs/jobs.cpp",
+            "engine/memory/memory.cpp",
+            "engine/logger/logger.cpp",
+        },
+        .flags = cpp_flags,
+    });
+    bench_step.dependOn(&b.addRunArtifact(arena_bench).step);
+
+    // Real frames with the texture cache and streamer; opens a window, so
+    // it needs a display: `zig build frame-check`
+    const frame_check = b.addExecutable(.{
+        .name = "frame_check",
+        .target = target,
+        .optimize = optimize,
+    });
+    frame_check.linkLibCpp();
+    frame_check.addCSourceFiles(.{
+        .files = &([_][]const u8{"bench/frame_check.cpp"} ++ engine_sources),
+        .flags = cpp_flags,
+    });
+    frame_check.linkLibrary(glfw);
+    frame_check.linkLibrary(glad);
+    frame_check.defineCMacro("GAME_DEBUG", if (optimize == .Debug) "true" else "false");
+
+    const frame_check_step = b.step("frame-check", "Check that steady frames do not allocate");
+    frame_check_step.dependOn(&b.addRunArtifact(frame_check).step);
 }
 
 fn getGlfw(
@@ -0,0 +1,388 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Engine {
+	static const char MAGIC[4] = { 'A', 'P', 'A', 'K' };
+
+	static_assert(sizeof(AssetArchive::Header) == 16, "archive header layout changed");
+	static_assert(sizeof(AssetArchive::Entry) == 40, "archive entry layout changed");
+
+	AssetArchive::AssetArchive() {
+		this->data = nullptr;
+		this->size = 0;
+	}
+	AssetArchive::~AssetArchive() {
+		this->close();
+	}
+
+	bool AssetArchive::open(const std::string& path) {
+		this->close();
+
+#ifdef __linux__
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(Header)) {
+			::close(file);
+			return false;
+		}
+
+		void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+
+		if (mapping == MAP_FAILED) return false;
+
+		this->data = (const std::byte*)mapping;
+		this->size = (size_t)info.st_size;
+#else
+		std::ifstream stream(path, std::ios::binary | std::ios::ate);
+		if (!stream.is_open()) return false;
+
+		const std::streamsize length = stream.tellg();
+		if (length < (std::streamsize)sizeof(Header)) return false;
+
+		this->buffer = std::vector<std::byte>((size_t)length);
+		stream.seekg(0);
+		if (!stream.read((char*)this->buffer.data(), length)) {
+			this->buffer.clear();
+			return false;
+		}
+
+		this->data = this->buffer.data();
+		this->size = this->buffer.size();
+#endif
+
+		Header header;
+		std::memcpy(&header, this->data, sizeof(header));
+
+		const size_t tableSize = (size_t)header.entryCount * sizeof(Entry);
+
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || tableSize > this->size - sizeof(Header)) {
+			this->close();
+			return false;
+		}
+
+		this->entries = std::vector<Entry>(header.entryCount);
+		std::memcpy(this->entries.data(), this->data + sizeof(Header), tableSize);
+
+		// findEntry binary searches, so the table must be strictly sorted.
+		for (size_t i = 0; i < this->entries.size(); ++i) {
+			const Entry& entry = this->entries[i];
+
+			if (entry.offset > this->size || entry.size > this->size - entry.offset || (i > 0 && entry.hash <= this->entries[i - 1].hash)) {
+				this->close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+	void AssetArchive::close() {
+#ifdef __linux__
+		if (this->data) munmap((void*)this->data, this->size);
+#endif
+
+		this->data = nullptr;
+		this->size = 0;
+		this->buffer.clear();
+		this->entries.clear();
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->decompressed.clear();
+	}
+	bool AssetArchive::isOpen() const {
+		return this->data != nullptr;
+	}
+
+	const AssetArchive::Entry* AssetArchive::findEntry(const uint64_t hash) const {
+		auto entry = std::lower_bound(this->entries.begin(), this->entries.end(), hash, [](const Entry& entry, const uint64_t hash) {
+			return entry.hash < hash;
+		});
+
+		if (entry == this->entries.end() || entry->hash != hash) return nullptr;
+		return &*entry;
+	}
+
+	std::optional<std::span<const std::byte>> AssetArchive::find(const std::string& path) {
+		const Entry* entry = this->findEntry(AssetArchive::hash(path));
+		if (!entry) return std::nullopt;
+
+		std::span<const std::byte> stored(this->data + entry->offset, (size_t)entry->size);
+		if (entry->compression == NONE) return stored;
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		auto cached = this->decompressed.find(entry->hash);
+		if (cached != this->decompressed.end()) return cached->second;
+
+		if (entry->compression != LZ4) return std::nullopt;
+
+		std::vector<std::byte> output((size_t)entry->originalSize);
+		if (!AssetArchive::decompressLZ4(stored, output)) return std::nullopt;
+
+		return this->decompressed.emplace(entry->hash, std::move(output)).first->second;
+	}
+	bool AssetArchive::contains(const std::string& path) const {
+		return this->findEntry(AssetArchive::hash(path)) != nullptr;
+	}
+
+	uint32_t AssetArchive::getEntryCount() const {
+		return (uint32_t)this->entries.size();
+	}
+
+	uint64_t AssetArchive::hash(const std::string& path) {
+		uint64_t hash = 14695981039346656037ull;
+
+		for (const char c : AssetArchive::normalize(path)) {
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+	std::string AssetArchive::normalize(const std::string& path) {
+		return std::filesystem::path(path).lexically_normal().generic_string();
+	}
+
+	// LZ4 part
+
+	// Matches may not start in the last 12 bytes and the last 5 bytes are
+	// always literals; decoders rely on both.
+	static const size_t MIN_MATCH = 4;
+	static const size_t MATCH_LIMIT = 12;
+	static const size_t LAST_LITERALS = 5;
+	static const size_t MAX_OFFSET = 65535;
+	static const int HASH_BITS = 16;
+
+	static uint32_t read32(const uint8_t* pointer) {
+		uint32_t value;
+		std::memcpy(&value, pointer, sizeof(value));
+		return value;
+	}
+	static void writeLength(std::vector<std::byte>& output, size_t length) {
+		while (length >= 255) {
+			output.push_back((std::byte)255);
+			length -= 255;
+		}
+
+		output.push_back((std::byte)length);
+	}
+	static void writeSequence(std::vector<std::byte>& output, const uint8_t* literals, const size_t literalLength, const size_t offset, const size_t matchLength) {
+		const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+		output.push_back((std::byte)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+
+		if (literalLength >= 15) writeLength(output, literalLength - 15);
+		output.insert(output.end(), (const std::byte*)literals, (const std::byte*)literals + literalLength);
+
+		if (!matchLength) return;
+
+		output.push_back((std::byte)(offset & 0xFF));
+		output.push_back((std::byte)(offset >> 8));
+
+		if (matchCode >= 15) writeLength(output, matchCode - 15);
+	}
+
+	std::vector<std::byte> AssetArchive::compressLZ4(std::span<const std::byte> source) {
+		const uint8_t* input = (const uint8_t*)source.data();
+		const size_t length = source.size();
+
+		std::vector<std::byte> output;
+		output.reserve(length + length / 255 + 16);
+
+		std::vector<uint32_t> table((size_t)1 << HASH_BITS, UINT32_MAX);
+		size_t anchor = 0, position = 0;
+
+		while (position + MATCH_LIMIT <= length) {
+			const uint32_t sequence = read32(input + position);
+			const uint32_t slot = (sequence * 2654435761u) >> (32 - HASH_BITS);
+
+			const uint32_t candidate = table[slot];
+			table[slot] = (uint32_t)position;
+
+			if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET || read32(input + candidate) != sequence) {
+				++position;
+				continue;
+			}
+
+			size_t matchLength = MIN_MATCH;
+			while (position + matchLength < length - LAST_LITERALS && input[candidate + matchLength] == input[position + matchLength]) {
+				++matchLength;
+			}
+
+			writeSequence(output, input + anchor, position - anchor, position - candidate, matchLength);
+
+			position += matchLength;
+			anchor = position;
+		}
+
+		writeSequence(output, input + anchor, length - anchor, 0, 0);
+		return output;
+	}
+	bool AssetArchive::decompressLZ4(std::span<const std::byte> source, std::span<std::byte> destination) {
+		const uint8_t* input = (const uint8_t*)source.data();
+		uint8_t* output = (uint8_t*)destination.data();
+
+		size_t in = 0, out = 0;
+
+		while (in < source.size()) {
+			const uint8_t token = input[in++];
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15) {
+				uint8_t extra;
+				do {
+					if (in >= source.size()) return false;
+					extra = input[in++];
+					literalLength += extra;
+				} while (extra == 255);
+			}
+
+			if (literalLength > source.size() - in || literalLength > destination.size() - out) return false;
+
+			std::memcpy(output + out, input + in, literalLength);
+			in += literalLength;
+			out += literalLength;
+
+			// The last sequence has no match.
+			if (in == source.size()) break;
+			if (source.size() - in < 2) return false;
+
+			const size_t offset = input[in] | ((size_t)input[in + 1] << 8);
+			in += 2;
+
+			if (offset == 0 || offset > out) return false;
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15) {
+				uint8_t extra;
+				do {
+					if (in >= source.size()) return false;
+					extra = input[in++];
+					matchLength += extra;
+				} while (extra == 255);
+			}
+			matchLength += MIN_MATCH;
+
+			if (matchLength > destination.size() - out) return false;
+
+			// Byte by byte, the match may overlap what it writes.
+			const uint8_t* match = output + out - offset;
+			for (size_t i = 0; i < matchLength; ++i) output[out + i] = match[i];
+			out += matchLength;
+		}
+
+		return out == destination.size();
+	}
+
+	// Builder part
+
+	void AssetArchiveBuilder::add(const std::string& path, std::vector<std::byte> data, const bool compress) {
+		this->blobs.push_back({ AssetArchive::normalize(path), std::move(data), compress });
+	}
+
+	bool AssetArchiveBuilder::save(const std::string& path, const uint32_t alignment, std::string& error) const {
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+			error = "alignment must be a power of two";
+			return false;
+		}
+
+		struct Pending {
+			AssetArchive::Entry entry;
+			const Blob* blob;
+			std::vector<std::byte> compressed;
+		};
+
+		std::vector<Pending> pending;
+		pending.reserve(this->blobs.size());
+
+		for (const Blob& blob : this->blobs) {
+			Pending item = {};
+			item.blob = &blob;
+			item.entry.hash = AssetArchive::hash(blob.path);
+			item.entry.size = blob.data.size();
+			item.entry.originalSize = blob.data.size();
+			item.entry.compression = AssetArchive::NONE;
+
+			if (blob.compress && !blob.data.empty()) {
+				std::vector<std::byte> compressed = AssetArchive::compressLZ4(blob.data);
+
+				if (compressed.size() < blob.data.size()) {
+					item.compressed = std::move(compressed);
+					item.entry.size = item.compressed.size();
+					item.entry.compression = AssetArchive::LZ4;
+				}
+			}
+
+			pending.push_back(std::move(item));
+		}
+
+		std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+			return a.entry.hash < b.entry.hash;
+		});
+
+		for (size_t i = 1; i < pending.size(); ++i) {
+			if (pending[i].entry.hash == pending[i - 1].entry.hash) {
+				error = "\"" + pending[i].blob->path + "\" and \"" + pending[i - 1].blob->path + "\" have the same path hash";
+				return false;
+			}
+		}
+
+		uint64_t offset = sizeof(AssetArchive::Header) + pending.size() * sizeof(AssetArchive::Entry);
+		for (Pending& item : pending) {
+			offset = (offset + alignment - 1) & ~(uint64_t)(alignment - 1);
+			item.entry.offset = offset;
+			offset += item.entry.size;
+		}
+
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open()) {
+			error = "could not write \"" + path + "\"";
+			return false;
+		}
+
+		AssetArchive::Header header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = AssetArchive::VERSION;
+		header.entryCount = (uint32_t)pending.size();
+		header.alignment = alignment;
+
+		stream.write((const char*)&header, sizeof(header));
+		for (const Pending& item : pending) {
+			stream.write((const char*)&item.entry, sizeof(item.entry));
+		}
+
+		const char padding[256] = {};
+		uint64_t written = sizeof(AssetArchive::Header) + pending.size() * sizeof(AssetArchive::Entry);
+
+		for (const Pending& item : pending) {
+			while (written < item.entry.offset) {
+				const uint64_t count = std::min<uint64_t>(item.entry.offset - written, sizeof(padding));
+				stream.write(padding, (std::streamsize)count);
+				written += count;
+			}
+
+			const std::vector<std::byte>& bytes = item.entry.compression == AssetArchive::NONE ? item.blob->data : item.compressed;
+			stream.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+			written += bytes.size();
+		}
+
+		if (!stream.good()) {
+			error = "could not write \"" + path + "\"";
+			return false;
+		}
+
+		return true;
+	}
+}
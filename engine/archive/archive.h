@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine {
+	// Read-only pack of many asset files, as written by the assetpack tool.
+	// The table of contents is sorted by a hash of each normalized path and
+	// blobs start on an aligned offset, so the whole file is memory mapped
+	// and uncompressed entries are handed out without a copy.
+	//
+	// Layout: header, table of contents, blobs.
+	class AssetArchive {
+	public:
+		enum Compression : uint32_t {
+			NONE = 0,
+			LZ4 = 1
+		};
+
+		struct Header {
+			char magic[4];
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t alignment;
+		};
+		struct Entry {
+			uint64_t hash;
+			uint64_t offset;
+			uint64_t size;
+			uint64_t originalSize;
+			Compression compression;
+			uint32_t reserved;
+		};
+	private:
+		const std::byte* data;
+		size_t size;
+		std::vector<std::byte> buffer;
+
+		std::vector<Entry> entries;
+
+		// Decompressed copies live until close(), so views stay valid.
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::vector<std::byte>> decompressed;
+
+		const Entry* findEntry(const uint64_t hash) const;
+	public:
+		AssetArchive();
+		~AssetArchive();
+
+		AssetArchive(const AssetArchive&) = delete;
+		AssetArchive& operator=(const AssetArchive&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+		bool isOpen() const;
+
+		// Nothing when the path is not in the archive or fails to
+		// decompress; an empty file is found with an empty view.
+		std::optional<std::span<const std::byte>> find(const std::string& path);
+		bool contains(const std::string& path) const;
+
+		uint32_t getEntryCount() const;
+
+		// FNV-1a over the normalized path.
+		static uint64_t hash(const std::string& path);
+		static std::string normalize(const std::string& path);
+
+		// LZ4 block format, without the frame header.
+		static std::vector<std::byte> compressLZ4(std::span<const std::byte> source);
+		static bool decompressLZ4(std::span<const std::byte> source, std::span<std::byte> destination);
+
+		static const uint32_t VERSION = 1;
+	};
+
+	// Collects files and writes them as an AssetArchive.
+	class AssetArchiveBuilder {
+	private:
+		struct Blob {
+			std::string path;
+			std::vector<std::byte> data;
+			bool compress;
+		};
+
+		std::vector<Blob> blobs;
+	public:
+		void add(const std::string& path, std::vector<std::byte> data, const bool compress);
+
+		// Fails on a path hash collision. Entries that do not shrink are stored as they are.
+		bool save(const std::string& path, const uint32_t alignment, std::string& error) const;
+	};
+}
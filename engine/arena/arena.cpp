@@ -0,0 +1,130 @@
+#include "arena.h"
+#include "../jobs/jobs.h"
+#include "../memory/memory.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace Engine {
+	// Frame arena part
+
+	std::atomic<uint64_t> FrameArena::frame = 0;
+	std::atomic<uint64_t> FrameArena::frameMark = 0;
+	std::atomic<uint64_t> FrameArena::frameHeapAllocations = 0;
+
+	FrameArena::FrameArena() : block(0), cursor(nullptr), end(nullptr), used(0), peak(0), stamp(FrameArena::frame.load(std::memory_order_acquire)) {
+	}
+	FrameArena::~FrameArena() {
+		for (const Block& block : this->blocks) ::operator delete(block.data);
+	}
+
+	void FrameArena::rewind() {
+		this->stamp = FrameArena::frame.load(std::memory_order_acquire);
+		this->used = 0;
+
+		if (this->blocks.empty()) return;
+
+		// The frame outgrew the first block: replace them all with one
+		// block holding as much, so the next frames fit without growing.
+		if (this->blocks.size() > 1) {
+			MemoryScope scope(Memory::FRAME);
+			size_t total = 0;
+			for (const Block& block : this->blocks) {
+				total += block.size;
+				::operator delete(block.data);
+			}
+
+			this->blocks.resize(1);
+			this->blocks[0] = { static_cast<std::byte*>(::operator new(total)), total };
+		}
+
+		this->block = 0;
+		this->cursor = this->blocks[0].data;
+		this->end = this->cursor + this->blocks[0].size;
+	}
+	void FrameArena::grow(const size_t bytes, const size_t alignment) {
+		const size_t needed = bytes + alignment;
+
+		for (size_t next = this->cursor ? this->block + 1 : 0; next < this->blocks.size(); ++next) {
+			if (this->blocks[next].size < needed) continue;
+
+			this->block = next;
+			this->cursor = this->blocks[next].data;
+			this->end = this->cursor + this->blocks[next].size;
+			return;
+		}
+
+		MemoryScope scope(Memory::FRAME);
+		const size_t size = std::max({ FrameArena::BLOCK_SIZE, this->blocks.empty() ? 0 : this->blocks.back().size * 2, needed });
+
+		this->blocks.push_back({ static_cast<std::byte*>(::operator new(size)), size });
+		this->block = this->blocks.size() - 1;
+		this->cursor = this->blocks.back().data;
+		this->end = this->cursor + size;
+	}
+
+	static std::byte* alignPointer(std::byte* pointer, const size_t alignment) {
+		return reinterpret_cast<std::byte*>((reinterpret_cast<uintptr_t>(pointer) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	}
+
+	void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+		if (this->stamp != FrameArena::frame.load(std::memory_order_acquire)) this->rewind();
+
+		std::byte* pointer = alignPointer(this->cursor, alignment);
+
+		if (!this->cursor || pointer + bytes > this->end) {
+			this->grow(bytes, alignment);
+			pointer = alignPointer(this->cursor, alignment);
+		}
+
+		this->used += (size_t)(pointer + bytes - this->cursor);
+		this->peak = std::max(this->peak, this->used);
+		this->cursor = pointer + bytes;
+
+		return pointer;
+	}
+	void FrameArena::do_deallocate(void*, size_t, size_t) {
+	}
+	bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+		return this == &other;
+	}
+
+	FrameArena& FrameArena::get() {
+		assert(FrameArena::isAvailable() && "FrameArena is for the render thread only");
+
+		static FrameArena arena;
+		return arena;
+	}
+	bool FrameArena::isAvailable() {
+		return Jobs::getThreadIndex() == 0;
+	}
+	void FrameArena::reset() {
+		FrameArena::frame.fetch_add(1, std::memory_order_release);
+
+		const uint64_t count = Memory::getAllocationCount();
+		FrameArena::frameHeapAllocations.store(count - FrameArena::frameMark.exchange(count, std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	uint64_t FrameArena::getFrame() {
+		return FrameArena::frame.load(std::memory_order_acquire);
+	}
+
+	size_t FrameArena::getUsed() const {
+		return this->stamp == FrameArena::frame.load(std::memory_order_acquire) ? this->used : 0;
+	}
+	size_t FrameArena::getPeak() const {
+		return this->peak;
+	}
+	size_t FrameArena::getCapacity() const {
+		size_t capacity = 0;
+		for (const Block& block : this->blocks) capacity += block.size;
+
+		return capacity;
+	}
+
+	uint64_t FrameArena::getHeapAllocationCount() {
+		return Memory::getAllocationCount();
+	}
+	uint64_t FrameArena::getFrameHeapAllocationCount() {
+		return FrameArena::frameHeapAllocations.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace Engine {
+	// Bump allocator for data that dies with the frame: formatted strings,
+	// scratch vectors and the like, through std::pmr containers:
+	//
+	//   std::pmr::vector<uint32_t> visible(&FrameArena::get());
+	//
+	// There is one arena, not one per thread, and only the render thread
+	// uses it: the thread that called Jobs::init(), which calls reset()
+	// from Window::swapBuffers. Worker threads have no point at which a
+	// rewind is safe, since a job can run past the frame that started it
+	// and one that waits can resume on another worker, so jobs, IO and
+	// Async work off the render thread keep using the heap; isAvailable()
+	// tells whether the calling thread may. Allocating takes no lock.
+	//
+	// Deallocation does nothing; the arena starts over on its first
+	// allocation after reset(), so nothing allocated here may be used
+	// after the swapBuffers that ends its frame, nor kept across a
+	// co_await. Blocks are kept, and merged into one after a frame that
+	// needed more, so steady frames do not touch the heap at all.
+	//
+	// Memory counts every operator new call, which makes that claim
+	// checkable per frame; arena blocks are charged to Memory::FRAME.
+	// bench/frame_check.cpp runs real frames with the texture cache and
+	// streamer active and fails on any.
+	class FrameArena : public std::pmr::memory_resource {
+	private:
+		struct Block {
+			std::byte* data;
+			size_t size;
+		};
+
+		static const size_t BLOCK_SIZE = 64 * 1024;
+
+		static std::atomic<uint64_t> frame;
+		static std::atomic<uint64_t> frameMark;
+		static std::atomic<uint64_t> frameHeapAllocations;
+
+		std::vector<Block> blocks;
+		size_t block;
+		std::byte* cursor;
+		std::byte* end;
+
+		// Bytes handed out this frame and the most handed out in one frame.
+		size_t used, peak;
+		uint64_t stamp;
+
+		void rewind();
+		void grow(const size_t bytes, const size_t alignment);
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	public:
+		FrameArena();
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// The render thread's arena; asserts it is called there.
+		static FrameArena& get();
+		static bool isAvailable();
+		// Ends the frame.
+		static void reset();
+		static uint64_t getFrame();
+
+		size_t getUsed() const;
+		size_t getPeak() const;
+		size_t getCapacity() const;
+
+		// operator new calls since the program started, and during the
+		// frame the last reset() ended.
+		static uint64_t getHeapAllocationCount();
+		static uint64_t getFrameHeapAllocationCount();
+	};
+}
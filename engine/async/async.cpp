@@ -0,0 +1,87 @@
+#include "async.h"
+#include "../arena/arena.h"
+
+#include <algorithm>
+
+namespace Engine {
+	std::mutex Async::mutex;
+	std::vector<std::coroutine_handle<>> Async::frameQueue;
+	std::vector<std::coroutine_handle<>> Async::spawned;
+
+	Async::Spawned Async::run(Task<void> task) {
+		co_await task;
+	}
+	void Async::spawn(Task<void> task) {
+		Async::run(std::move(task));
+	}
+	void Async::track(std::coroutine_handle<> handle) {
+		std::lock_guard<std::mutex> lock(Async::mutex);
+		Async::spawned.push_back(handle);
+	}
+	void Async::untrack(std::coroutine_handle<> handle) {
+		std::lock_guard<std::mutex> lock(Async::mutex);
+
+		auto found = std::find(Async::spawned.begin(), Async::spawned.end(), handle);
+		if (found != Async::spawned.end()) Async::spawned.erase(found);
+	}
+
+	void Async::ReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+		IO::read(this->path, this->priority, [this, handle](IO::Result& result) {
+			this->result = std::move(result);
+			handle.resume();
+		});
+	}
+	void Async::JobAwaiter::await_suspend(std::coroutine_handle<> handle) {
+		// The job may resume the coroutine before this returns, so nothing
+		// here touches the awaiter after scheduling.
+		Jobs::run([handle]() {
+			handle.resume();
+		}, nullptr);
+	}
+	void Async::FrameAwaiter::await_suspend(std::coroutine_handle<> handle) {
+		std::lock_guard<std::mutex> lock(Async::mutex);
+		Async::frameQueue.push_back(handle);
+	}
+
+	Async::ReadAwaiter Async::read(const std::string& path, const IO::Priority priority) {
+		return { path, priority, {} };
+	}
+	Async::JobAwaiter Async::resumeOnJobs() {
+		return {};
+	}
+	Async::FrameAwaiter Async::resumeOnFrame() {
+		return {};
+	}
+
+	void Async::update() {
+		std::pmr::vector<std::coroutine_handle<>> ready(&FrameArena::get());
+
+		{
+			std::lock_guard<std::mutex> lock(Async::mutex);
+			ready.assign(Async::frameQueue.begin(), Async::frameQueue.end());
+			Async::frameQueue.clear();
+		}
+
+		// Coroutines that ask for another frame while running here land in
+		// the next batch.
+		for (std::coroutine_handle<> handle : ready) {
+			handle.resume();
+		}
+	}
+	void Async::clear() {
+		std::vector<std::coroutine_handle<>> unfinished;
+
+		{
+			std::lock_guard<std::mutex> lock(Async::mutex);
+
+			// The queued handles belong to frames the spawned tasks own.
+			Async::frameQueue.clear();
+			unfinished = Async::spawned;
+		}
+
+		// Each frame takes itself out of the list as it is destroyed.
+		for (std::coroutine_handle<> handle : unfinished) {
+			handle.destroy();
+		}
+	}
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../io/io.h"
+#include "../jobs/jobs.h"
+
+namespace Engine {
+	// Lazily started coroutine. Awaiting a task starts it, and the awaiting
+	// coroutine resumes where the task finishes, without going through a
+	// scheduler. Top-level tasks are handed to Async::spawn.
+	template<typename T>
+	class Task;
+
+	class TaskPromiseBase {
+	public:
+		std::coroutine_handle<> continuation;
+		std::exception_ptr exception;
+
+		struct FinalAwaiter {
+			bool await_ready() noexcept {
+				return false;
+			}
+			template<typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+				std::coroutine_handle<> continuation = handle.promise().continuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() noexcept {
+			}
+		};
+
+		std::suspend_always initial_suspend() noexcept {
+			return {};
+		}
+		FinalAwaiter final_suspend() noexcept {
+			return {};
+		}
+		void unhandled_exception() {
+			this->exception = std::current_exception();
+		}
+	};
+
+	template<typename T>
+	class TaskPromise : public TaskPromiseBase {
+	public:
+		std::optional<T> value;
+
+		Task<T> get_return_object();
+
+		void return_value(T value) {
+			this->value = std::move(value);
+		}
+	};
+	template<>
+	class TaskPromise<void> : public TaskPromiseBase {
+	public:
+		Task<void> get_return_object();
+
+		void return_void() {
+		}
+	};
+
+	template<typename T>
+	class Task {
+	public:
+		typedef TaskPromise<T> promise_type;
+	private:
+		std::coroutine_handle<promise_type> handle;
+	public:
+		explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {
+		}
+		Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {
+		}
+		Task& operator=(Task&& other) noexcept {
+			if (this != &other) {
+				if (this->handle) this->handle.destroy();
+				this->handle = std::exchange(other.handle, nullptr);
+			}
+			return *this;
+		}
+		~Task() {
+			if (this->handle) this->handle.destroy();
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		bool await_ready() const noexcept {
+			return !this->handle || this->handle.done();
+		}
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+			this->handle.promise().continuation = awaiting;
+			return this->handle;
+		}
+		T await_resume() {
+			promise_type& promise = this->handle.promise();
+			if (promise.exception) std::rethrow_exception(promise.exception);
+
+			if constexpr (!std::is_void_v<T>) {
+				return std::move(*promise.value);
+			}
+		}
+	};
+
+	template<typename T>
+	Task<T> TaskPromise<T>::get_return_object() {
+		return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+	}
+	inline Task<void> TaskPromise<void>::get_return_object() {
+		return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+	}
+
+	// Awaitables that move a coroutine between the render thread, IO
+	// completions and job workers, so loading code reads top to bottom:
+	//
+	//   IO::Result file = co_await Async::read(path, IO::NORMAL);
+	//   co_await Async::resumeOnJobs();   // decode on a worker
+	//   co_await Async::resumeOnFrame();  // upload on the render thread
+	class Async {
+	private:
+		// Owns the frame of a spawned task, which owns the frames of the
+		// tasks it awaits, so destroying it tears down the whole chain.
+		struct Spawned {
+			struct promise_type {
+				promise_type() = default;
+				promise_type(const promise_type&) = delete;
+				~promise_type() {
+					Async::untrack(std::coroutine_handle<promise_type>::from_promise(*this));
+				}
+
+				Spawned get_return_object() {
+					Async::track(std::coroutine_handle<promise_type>::from_promise(*this));
+					return {};
+				}
+				std::suspend_never initial_suspend() noexcept {
+					return {};
+				}
+				std::suspend_never final_suspend() noexcept {
+					return {};
+				}
+				void return_void() noexcept {
+				}
+				void unhandled_exception() noexcept {
+					std::terminate();
+				}
+			};
+		};
+
+		static std::mutex mutex;
+		static std::vector<std::coroutine_handle<>> frameQueue;
+		// Spawned tasks that have not finished.
+		static std::vector<std::coroutine_handle<>> spawned;
+
+		static Spawned run(Task<void> task);
+		static void track(std::coroutine_handle<> handle);
+		static void untrack(std::coroutine_handle<> handle);
+	public:
+		struct ReadAwaiter {
+			std::string path;
+			IO::Priority priority;
+			IO::Result result;
+
+			bool await_ready() const noexcept {
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<> handle);
+			IO::Result await_resume() {
+				return std::move(this->result);
+			}
+		};
+		struct JobAwaiter {
+			bool await_ready() const noexcept {
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<> handle);
+			void await_resume() const noexcept {
+			}
+		};
+		struct FrameAwaiter {
+			bool await_ready() const noexcept {
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<> handle);
+			void await_resume() const noexcept {
+			}
+		};
+
+		// Starts a task that nobody awaits; its frame frees itself at the
+		// end, or in clear().
+		static void spawn(Task<void> task);
+
+		// Resumes from IO::update() on the render thread with the file.
+		static ReadAwaiter read(const std::string& path, const IO::Priority priority);
+		// Resumes as a job on a worker.
+		static JobAwaiter resumeOnJobs();
+		// Resumes on the render thread at the next frame boundary.
+		static FrameAwaiter resumeOnFrame();
+
+		// Called from Window::swapBuffers.
+		static void update();
+		// Destroys every spawned task that has not finished, together with
+		// the tasks it awaits, without resuming any. Call it once nothing
+		// can resume them any more, after IO and Jobs are shut down.
+		static void clear();
+	};
+}
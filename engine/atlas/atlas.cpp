@@ -0,0 +1,98 @@
+#include "atlas.h"
+
+#include <algorithm>
+
+namespace Engine {
+	SkylinePacker::SkylinePacker(const int width, const int height) {
+		this->width = width;
+		this->height = height;
+
+		this->reset();
+	}
+
+	void SkylinePacker::reset() {
+		this->usedArea = 0;
+		this->skyline = { { 0, 0, this->width } };
+	}
+
+	int SkylinePacker::fit(const size_t index, const int width, const int height) const {
+		const int x = this->skyline[index].x;
+		if (x + width > this->width) return -1;
+
+		int y = 0;
+		int remaining = width;
+
+		for (size_t i = index; remaining > 0; ++i) {
+			y = std::max(y, this->skyline[i].y);
+			if (y + height > this->height) return -1;
+
+			remaining -= this->skyline[i].width;
+		}
+
+		return y;
+	}
+
+	bool SkylinePacker::insert(const int width, const int height, Rect& rect) {
+		size_t bestIndex = this->skyline.size();
+		int bestTop = this->height + 1, bestWidth = this->width + 1;
+
+		for (size_t i = 0; i < this->skyline.size(); ++i) {
+			const int y = this->fit(i, width, height);
+			if (y < 0) continue;
+
+			if (y + height < bestTop || (y + height == bestTop && this->skyline[i].width < bestWidth)) {
+				bestIndex = i;
+				bestTop = y + height;
+				bestWidth = this->skyline[i].width;
+
+				rect = { this->skyline[i].x, y, width, height };
+			}
+		}
+
+		if (bestIndex == this->skyline.size()) return false;
+
+		this->place(bestIndex, rect);
+		this->usedArea += (long long)width * height;
+
+		return true;
+	}
+
+	void SkylinePacker::place(const size_t index, const Rect& rect) {
+		this->skyline.insert(this->skyline.begin() + index, { rect.x, rect.y + rect.height, rect.width });
+
+		// Cut away the parts of the following nodes now under the new one.
+		for (size_t i = index + 1; i < this->skyline.size();) {
+			Node& previous = this->skyline[i - 1];
+			Node& node = this->skyline[i];
+
+			const int overlap = previous.x + previous.width - node.x;
+			if (overlap <= 0) break;
+
+			node.x += overlap;
+			node.width -= overlap;
+
+			if (node.width > 0) break;
+			this->skyline.erase(this->skyline.begin() + i);
+		}
+
+		for (size_t i = 0; i + 1 < this->skyline.size();) {
+			if (this->skyline[i].y == this->skyline[i + 1].y) {
+				this->skyline[i].width += this->skyline[i + 1].width;
+				this->skyline.erase(this->skyline.begin() + i + 1);
+			}
+			else {
+				++i;
+			}
+		}
+	}
+
+	int SkylinePacker::getWidth() const {
+		return this->width;
+	}
+	int SkylinePacker::getHeight() const {
+		return this->height;
+	}
+	float SkylinePacker::getOccupancy() const {
+		return (float)((double)this->usedArea / ((double)this->width * this->height));
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Engine {
+	// Bottom-left skyline bin packer. The skyline is the upper outline of
+	// the rectangles placed so far; each insert picks the spot that keeps
+	// the new rectangle's top edge lowest.
+	class SkylinePacker {
+	public:
+		struct Rect {
+			int x, y;
+			int width, height;
+		};
+	private:
+		struct Node {
+			int x, y;
+			int width;
+		};
+
+		int width, height;
+		long long usedArea;
+
+		std::vector<Node> skyline;
+
+		int fit(const size_t index, const int width, const int height) const;
+		void place(const size_t index, const Rect& rect);
+	public:
+		SkylinePacker(const int width, const int height);
+
+		bool insert(const int width, const int height, Rect& rect);
+		void reset();
+
+		int getWidth() const;
+		int getHeight() const;
+		float getOccupancy() const;
+	};
+}
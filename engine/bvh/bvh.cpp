@@ -0,0 +1,700 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include "../../include/glm/gtx/intersect.hpp"
+
+namespace Engine {
+	// Traversal stack that lives on the C++ stack for any sane tree depth.
+	// Queries may nest from inside callbacks, so nothing is shared.
+	template<typename T>
+	class TraversalStack {
+	private:
+		static const size_t LOCAL = 64;
+
+		T local[LOCAL];
+		std::vector<T> overflow;
+		size_t count = 0;
+	public:
+		void push(const T& value) {
+			if (this->count < LOCAL) this->local[this->count] = value;
+			else this->overflow.push_back(value);
+
+			++this->count;
+		}
+		T pop() {
+			--this->count;
+			if (this->count < LOCAL) return this->local[this->count];
+
+			T value = this->overflow.back();
+			this->overflow.pop_back();
+			return value;
+		}
+		bool empty() const {
+			return this->count == 0;
+		}
+	};
+
+	// Frustum planes still crossing a box. -1 when the box is outside one
+	// of them; 0 when it is inside all.
+	static int classify(const AABB& box, const Frustum& frustum, const int mask) {
+		const glm::vec3 center = (box.min + box.max) * 0.5f;
+		const glm::vec3 extent = (box.max - box.min) * 0.5f;
+		int result = mask;
+
+		for (int p = 0; p < 6; ++p) {
+			if (!(mask & (1 << p))) continue;
+
+			const glm::vec4& plane = frustum.planes[p];
+			const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			const float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+
+			if (distance < -radius) return -1;
+			if (distance >= radius) result &= ~(1 << p);
+		}
+
+		return result;
+	}
+
+	static const int ALL_PLANES = 0x3F;
+
+	// AABB part
+
+	AABB::AABB() : min(0.0f), max(0.0f) {
+	}
+	AABB::AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {
+	}
+
+	AABB AABB::merge(const AABB& a, const AABB& b) {
+		return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+	}
+
+	float AABB::area() const {
+		const glm::vec3 size = this->max - this->min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+	bool AABB::contains(const AABB& other) const {
+		return glm::all(glm::lessThanEqual(this->min, other.min)) && glm::all(glm::lessThanEqual(other.max, this->max));
+	}
+	bool AABB::overlaps(const AABB& other) const {
+		return glm::all(glm::lessThanEqual(this->min, other.max)) && glm::all(glm::lessThanEqual(other.min, this->max));
+	}
+	bool AABB::overlaps(const glm::vec3& center, const float radius) const {
+		const glm::vec3 closest = glm::clamp(center, this->min, this->max);
+		const glm::vec3 offset = closest - center;
+
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+	bool AABB::overlaps(const Frustum& frustum) const {
+		return classify(*this, frustum, ALL_PLANES) >= 0;
+	}
+	bool AABB::intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, const float maxDistance, float& distance) const {
+		const glm::vec3 t0 = (this->min - origin) * inverseDirection;
+		const glm::vec3 t1 = (this->max - origin) * inverseDirection;
+		const glm::vec3 entries = glm::min(t0, t1);
+		const glm::vec3 exits = glm::max(t0, t1);
+
+		const float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+		const float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+
+		distance = enter;
+		return enter <= exit;
+	}
+
+	// Dynamic tree part
+
+	bool AABBTree::Node::isLeaf() const {
+		return this->child1 == NONE;
+	}
+
+	AABBTree::AABBTree(const float margin) : root(NONE), freeList(NONE), proxyCount(0), margin(margin) {
+	}
+
+	uint32_t AABBTree::allocateNode() {
+		uint32_t node;
+
+		if (this->freeList != NONE) {
+			node = this->freeList;
+			this->freeList = this->nodes[node].parent;
+		}
+		else {
+			node = (uint32_t)this->nodes.size();
+			this->nodes.emplace_back();
+		}
+
+		this->nodes[node].parent = NONE;
+		this->nodes[node].child1 = NONE;
+		this->nodes[node].child2 = NONE;
+		this->nodes[node].height = 0;
+		this->nodes[node].data = 0;
+
+		return node;
+	}
+	void AABBTree::freeNode(const uint32_t node) {
+		this->nodes[node].parent = this->freeList;
+		this->nodes[node].height = -1;
+		this->freeList = node;
+	}
+
+	void AABBTree::insertLeaf(const uint32_t leaf) {
+		if (this->root == NONE) {
+			this->root = leaf;
+			this->nodes[leaf].parent = NONE;
+			return;
+		}
+
+		// Walk down while pushing the leaf into a child is cheaper than
+		// pairing it with the current node. A child's cost includes the
+		// growth of every ancestor on the way.
+		const AABB bounds = this->nodes[leaf].bounds;
+		uint32_t index = this->root;
+
+		while (!this->nodes[index].isLeaf()) {
+			const Node& node = this->nodes[index];
+
+			const float area = node.bounds.area();
+			const float combinedArea = AABB::merge(node.bounds, bounds).area();
+
+			const float cost = 2.0f * combinedArea;
+			const float inheritance = 2.0f * (combinedArea - area);
+
+			const auto descend = [this, &bounds, inheritance](const uint32_t child) {
+				const float merged = AABB::merge(bounds, this->nodes[child].bounds).area();
+				return this->nodes[child].isLeaf() ? merged + inheritance : merged - this->nodes[child].bounds.area() + inheritance;
+			};
+
+			const float cost1 = descend(node.child1);
+			const float cost2 = descend(node.child2);
+
+			if (cost < cost1 && cost < cost2) break;
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		const uint32_t sibling = index;
+		const uint32_t oldParent = this->nodes[sibling].parent;
+		const uint32_t newParent = this->allocateNode();
+
+		this->nodes[newParent].parent = oldParent;
+		this->nodes[newParent].bounds = AABB::merge(bounds, this->nodes[sibling].bounds);
+		this->nodes[newParent].height = this->nodes[sibling].height + 1;
+		this->nodes[newParent].child1 = sibling;
+		this->nodes[newParent].child2 = leaf;
+		this->nodes[sibling].parent = newParent;
+		this->nodes[leaf].parent = newParent;
+
+		if (oldParent == NONE) {
+			this->root = newParent;
+		}
+		else if (this->nodes[oldParent].child1 == sibling) {
+			this->nodes[oldParent].child1 = newParent;
+		}
+		else {
+			this->nodes[oldParent].child2 = newParent;
+		}
+
+		this->refit(oldParent);
+	}
+	void AABBTree::removeLeaf(const uint32_t leaf) {
+		if (leaf == this->root) {
+			this->root = NONE;
+			return;
+		}
+
+		const uint32_t parent = this->nodes[leaf].parent;
+		const uint32_t grandParent = this->nodes[parent].parent;
+		const uint32_t sibling = this->nodes[parent].child1 == leaf ? this->nodes[parent].child2 : this->nodes[parent].child1;
+
+		this->nodes[sibling].parent = grandParent;
+		this->freeNode(parent);
+
+		if (grandParent == NONE) {
+			this->root = sibling;
+			return;
+		}
+
+		if (this->nodes[grandParent].child1 == parent) {
+			this->nodes[grandParent].child1 = sibling;
+		}
+		else {
+			this->nodes[grandParent].child2 = sibling;
+		}
+
+		this->refit(grandParent);
+	}
+	void AABBTree::refit(uint32_t node) {
+		while (node != NONE) {
+			Node& current = this->nodes[node];
+			const Node& child1 = this->nodes[current.child1];
+			const Node& child2 = this->nodes[current.child2];
+
+			current.bounds = AABB::merge(child1.bounds, child2.bounds);
+			current.height = 1 + std::max(child1.height, child2.height);
+
+			this->rotate(node);
+			node = this->nodes[node].parent;
+		}
+	}
+	void AABBTree::rotate(const uint32_t a) {
+		// Swapping a child of a with a grandchild under the other child
+		// changes only that other child's bounds; take the swap that
+		// shrinks it most.
+		const uint32_t b = this->nodes[a].child1;
+		const uint32_t c = this->nodes[a].child2;
+
+		float bestGain = 0.0f;
+		uint32_t outer = NONE, parent = NONE, inner = NONE;
+
+		const auto consider = [this, &bestGain, &outer, &parent, &inner](const uint32_t child, const uint32_t other) {
+			const Node& otherNode = this->nodes[other];
+			if (otherNode.isLeaf()) return;
+
+			const float area = otherNode.bounds.area();
+			const AABB& bounds = this->nodes[child].bounds;
+
+			// child takes grandchild1's place: other then holds child and grandchild2.
+			const float gain1 = area - AABB::merge(bounds, this->nodes[otherNode.child2].bounds).area();
+			const float gain2 = area - AABB::merge(bounds, this->nodes[otherNode.child1].bounds).area();
+
+			if (gain1 > bestGain) {
+				bestGain = gain1;
+				outer = child;
+				parent = other;
+				inner = otherNode.child1;
+			}
+			if (gain2 > bestGain) {
+				bestGain = gain2;
+				outer = child;
+				parent = other;
+				inner = otherNode.child2;
+			}
+		};
+
+		consider(b, c);
+		consider(c, b);
+
+		if (outer == NONE) return;
+
+		Node& aNode = this->nodes[a];
+		Node& parentNode = this->nodes[parent];
+
+		if (aNode.child1 == outer) aNode.child1 = inner;
+		else aNode.child2 = inner;
+
+		if (parentNode.child1 == inner) parentNode.child1 = outer;
+		else parentNode.child2 = outer;
+
+		this->nodes[inner].parent = a;
+		this->nodes[outer].parent = parent;
+
+		parentNode.bounds = AABB::merge(this->nodes[parentNode.child1].bounds, this->nodes[parentNode.child2].bounds);
+		parentNode.height = 1 + std::max(this->nodes[parentNode.child1].height, this->nodes[parentNode.child2].height);
+		aNode.height = 1 + std::max(this->nodes[aNode.child1].height, this->nodes[aNode.child2].height);
+	}
+
+	AABBTree::Proxy AABBTree::insert(const AABB& bounds, const uint32_t data) {
+		const uint32_t leaf = this->allocateNode();
+
+		this->nodes[leaf].bounds = AABB(bounds.min - glm::vec3(this->margin), bounds.max + glm::vec3(this->margin));
+		this->nodes[leaf].data = data;
+
+		this->insertLeaf(leaf);
+		++this->proxyCount;
+
+		return leaf;
+	}
+	void AABBTree::remove(const Proxy proxy) {
+		this->removeLeaf(proxy);
+		this->freeNode(proxy);
+		--this->proxyCount;
+	}
+	bool AABBTree::move(const Proxy proxy, const AABB& bounds) {
+		if (this->nodes[proxy].bounds.contains(bounds)) return false;
+
+		this->removeLeaf(proxy);
+		this->nodes[proxy].bounds = AABB(bounds.min - glm::vec3(this->margin), bounds.max + glm::vec3(this->margin));
+		this->insertLeaf(proxy);
+
+		return true;
+	}
+
+	const AABB& AABBTree::getBounds(const Proxy proxy) const {
+		return this->nodes[proxy].bounds;
+	}
+	uint32_t AABBTree::getData(const Proxy proxy) const {
+		return this->nodes[proxy].data;
+	}
+
+	void AABBTree::query(const AABB& box, const Callback& callback) const {
+		if (this->root == NONE) return;
+
+		TraversalStack<uint32_t> stack;
+		stack.push(this->root);
+
+		while (!stack.empty()) {
+			const Node& node = this->nodes[stack.pop()];
+			if (!node.bounds.overlaps(box)) continue;
+
+			if (node.isLeaf()) {
+				if (!callback((Proxy)(&node - this->nodes.data()))) return;
+				continue;
+			}
+
+			stack.push(node.child1);
+			stack.push(node.child2);
+		}
+	}
+	void AABBTree::query(const glm::vec3& center, const float radius, const Callback& callback) const {
+		if (this->root == NONE) return;
+
+		TraversalStack<uint32_t> stack;
+		stack.push(this->root);
+
+		while (!stack.empty()) {
+			const Node& node = this->nodes[stack.pop()];
+			if (!node.bounds.overlaps(center, radius)) continue;
+
+			if (node.isLeaf()) {
+				if (!callback((Proxy)(&node - this->nodes.data()))) return;
+				continue;
+			}
+
+			stack.push(node.child1);
+			stack.push(node.child2);
+		}
+	}
+	void AABBTree::query(const Frustum& frustum, const Callback& callback) const {
+		if (this->root == NONE) return;
+
+		struct Entry {
+			uint32_t node;
+			int planes;
+		};
+
+		TraversalStack<Entry> stack;
+		stack.push({ this->root, ALL_PLANES });
+
+		while (!stack.empty()) {
+			const Entry entry = stack.pop();
+			const Node& node = this->nodes[entry.node];
+
+			const int planes = entry.planes ? classify(node.bounds, frustum, entry.planes) : 0;
+			if (planes < 0) continue;
+
+			if (node.isLeaf()) {
+				if (!callback(entry.node)) return;
+				continue;
+			}
+
+			stack.push({ node.child1, planes });
+			stack.push({ node.child2, planes });
+		}
+	}
+	void AABBTree::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const RayCallback& callback) const {
+		if (this->root == NONE) return;
+
+		const glm::vec3 inverseDirection = 1.0f / direction;
+
+		TraversalStack<uint32_t> stack;
+		stack.push(this->root);
+
+		while (!stack.empty()) {
+			const uint32_t index = stack.pop();
+			const Node& node = this->nodes[index];
+
+			float distance;
+			if (!node.bounds.intersectRay(origin, inverseDirection, maxDistance, distance)) continue;
+
+			if (node.isLeaf()) {
+				maxDistance = callback(index, distance);
+				if (maxDistance <= 0.0f) return;
+				continue;
+			}
+
+			// Nearer child on top, so hits shrink maxDistance early.
+			float distance1, distance2;
+			const bool hit1 = this->nodes[node.child1].bounds.intersectRay(origin, inverseDirection, maxDistance, distance1);
+			const bool hit2 = this->nodes[node.child2].bounds.intersectRay(origin, inverseDirection, maxDistance, distance2);
+
+			if (hit1 && hit2) {
+				stack.push(distance1 < distance2 ? node.child2 : node.child1);
+				stack.push(distance1 < distance2 ? node.child1 : node.child2);
+			}
+			else if (hit1) {
+				stack.push(node.child1);
+			}
+			else if (hit2) {
+				stack.push(node.child2);
+			}
+		}
+	}
+
+	size_t AABBTree::getProxyCount() const {
+		return this->proxyCount;
+	}
+	int AABBTree::getHeight() const {
+		return this->root == NONE ? 0 : this->nodes[this->root].height;
+	}
+	float AABBTree::getAreaRatio() const {
+		if (this->root == NONE) return 0.0f;
+
+		float total = 0.0f;
+		for (const Node& node : this->nodes) {
+			if (node.height > 0) total += node.bounds.area();
+		}
+
+		return total / this->nodes[this->root].bounds.area();
+	}
+
+	// Static BVH part
+
+	static const int BINS = 16;
+
+	uint32_t StaticBVH::buildNode(std::vector<uint32_t>& order, const std::vector<AABB>& bounds, const std::vector<glm::vec3>& centroids, const uint32_t begin, const uint32_t end) {
+		const uint32_t index = (uint32_t)this->nodes.size();
+		this->nodes.emplace_back();
+
+		AABB nodeBounds = bounds[order[begin]];
+		AABB centroidBounds(centroids[order[begin]], centroids[order[begin]]);
+
+		for (uint32_t i = begin + 1; i < end; ++i) {
+			nodeBounds = AABB::merge(nodeBounds, bounds[order[i]]);
+			centroidBounds = AABB::merge(centroidBounds, AABB(centroids[order[i]], centroids[order[i]]));
+		}
+
+		this->nodes[index].min = nodeBounds.min;
+		this->nodes[index].max = nodeBounds.max;
+
+		const uint32_t count = end - begin;
+
+		if (count <= StaticBVH::MAX_LEAF_TRIANGLES) {
+			this->nodes[index].offset = begin;
+			this->nodes[index].count = count;
+			return index;
+		}
+
+		// Binned SAH: sweep the bins of every axis from both sides and
+		// split where count times area summed over both halves is least.
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1, bestBin = 0;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			const float low = centroidBounds.min[axis], high = centroidBounds.max[axis];
+			if (high <= low) continue;
+
+			AABB binBounds[BINS];
+			uint32_t binCounts[BINS] = {};
+			const float scale = BINS / (high - low);
+
+			for (uint32_t i = begin; i < end; ++i) {
+				const int bin = std::min(BINS - 1, (int)((centroids[order[i]][axis] - low) * scale));
+
+				binBounds[bin] = binCounts[bin] ? AABB::merge(binBounds[bin], bounds[order[i]]) : bounds[order[i]];
+				++binCounts[bin];
+			}
+
+			float leftAreas[BINS - 1];
+			uint32_t leftCounts[BINS - 1];
+			AABB sweep;
+			uint32_t sweepCount = 0;
+
+			for (int bin = 0; bin < BINS - 1; ++bin) {
+				if (binCounts[bin]) {
+					sweep = sweepCount ? AABB::merge(sweep, binBounds[bin]) : binBounds[bin];
+					sweepCount += binCounts[bin];
+				}
+
+				leftAreas[bin] = sweepCount ? sweep.area() : 0.0f;
+				leftCounts[bin] = sweepCount;
+			}
+
+			sweepCount = 0;
+			for (int bin = BINS - 1; bin > 0; --bin) {
+				if (binCounts[bin]) {
+					sweep = sweepCount ? AABB::merge(sweep, binBounds[bin]) : binBounds[bin];
+					sweepCount += binCounts[bin];
+				}
+
+				if (!sweepCount || !leftCounts[bin - 1]) continue;
+
+				const float cost = leftAreas[bin - 1] * leftCounts[bin - 1] + sweep.area() * sweepCount;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		uint32_t middle = begin + count / 2;
+
+		if (bestAxis >= 0) {
+			const float low = centroidBounds.min[bestAxis];
+			const float scale = BINS / (centroidBounds.max[bestAxis] - low);
+
+			middle = (uint32_t)(std::partition(order.begin() + begin, order.begin() + end, [&](const uint32_t triangle) {
+				return std::min(BINS - 1, (int)((centroids[triangle][bestAxis] - low) * scale)) < bestBin;
+			}) - order.begin());
+		}
+
+		// All centroids in one spot: split the list in half.
+		if (middle == begin || middle == end) middle = begin + count / 2;
+
+		this->buildNode(order, bounds, centroids, begin, middle);
+		const uint32_t right = this->buildNode(order, bounds, centroids, middle, end);
+
+		this->nodes[index].offset = right;
+		this->nodes[index].count = 0;
+
+		return index;
+	}
+
+	void StaticBVH::build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+		this->clear();
+
+		const size_t triangleCount = indices.empty() ? positions.size() / 3 : indices.size() / 3;
+		if (triangleCount == 0) return;
+
+		const auto corner = [&positions, &indices](const size_t triangle, const int vertex) -> const glm::vec3& {
+			return positions[indices.empty() ? triangle * 3 + vertex : indices[triangle * 3 + vertex]];
+		};
+
+		std::vector<AABB> bounds(triangleCount);
+		std::vector<glm::vec3> centroids(triangleCount);
+		std::vector<uint32_t> order(triangleCount);
+
+		for (size_t i = 0; i < triangleCount; ++i) {
+			const glm::vec3& a = corner(i, 0);
+			const glm::vec3& b = corner(i, 1);
+			const glm::vec3& c = corner(i, 2);
+
+			bounds[i] = AABB(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)));
+			centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+			order[i] = (uint32_t)i;
+		}
+
+		this->nodes.reserve(triangleCount * 2 / StaticBVH::MAX_LEAF_TRIANGLES + 1);
+		this->buildNode(order, bounds, centroids, 0, (uint32_t)triangleCount);
+		this->nodes.shrink_to_fit();
+
+		this->corners.resize(triangleCount * 3);
+		for (size_t slot = 0; slot < triangleCount; ++slot) {
+			for (int vertex = 0; vertex < 3; ++vertex) this->corners[slot * 3 + vertex] = corner(order[slot], vertex);
+		}
+		this->triangles = std::move(order);
+	}
+	void StaticBVH::clear() {
+		this->nodes.clear();
+		this->corners.clear();
+		this->triangles.clear();
+	}
+
+	bool StaticBVH::raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, Hit& hit) const {
+		if (this->nodes.empty()) return false;
+
+		const glm::vec3 inverseDirection = 1.0f / direction;
+		float closest = maxDistance;
+		bool found = false;
+
+		TraversalStack<uint32_t> stack;
+		stack.push(0);
+
+		while (!stack.empty()) {
+			const Node& node = this->nodes[stack.pop()];
+
+			if (node.count) {
+				for (uint32_t slot = node.offset; slot < node.offset + node.count; ++slot) {
+					glm::vec2 barycentric;
+					float distance;
+
+					if (glm::intersectRayTriangle(origin, direction, this->corners[slot * 3], this->corners[slot * 3 + 1], this->corners[slot * 3 + 2], barycentric, distance)
+						&& distance >= 0.0f && distance < closest) {
+						closest = distance;
+						found = true;
+						hit = { this->triangles[slot], distance, barycentric };
+					}
+				}
+				continue;
+			}
+
+			const uint32_t left = (uint32_t)(&node - this->nodes.data()) + 1;
+			const uint32_t right = node.offset;
+
+			float leftDistance, rightDistance;
+			const bool leftHit = AABB(this->nodes[left].min, this->nodes[left].max).intersectRay(origin, inverseDirection, closest, leftDistance);
+			const bool rightHit = AABB(this->nodes[right].min, this->nodes[right].max).intersectRay(origin, inverseDirection, closest, rightDistance);
+
+			if (leftHit && rightHit) {
+				stack.push(leftDistance < rightDistance ? right : left);
+				stack.push(leftDistance < rightDistance ? left : right);
+			}
+			else if (leftHit) {
+				stack.push(left);
+			}
+			else if (rightHit) {
+				stack.push(right);
+			}
+		}
+
+		return found;
+	}
+
+	void StaticBVH::query(const std::function<int(const Node&)>& test, const Callback& callback) const {
+		if (this->nodes.empty()) return;
+
+		// Entries carry whether the test still has to run below.
+		struct Entry {
+			uint32_t node;
+			bool test;
+		};
+
+		TraversalStack<Entry> stack;
+		stack.push({ 0, true });
+
+		while (!stack.empty()) {
+			const Entry entry = stack.pop();
+			const Node& node = this->nodes[entry.node];
+
+			const int result = entry.test ? test(node) : 2;
+			if (result == 0) continue;
+
+			if (node.count) {
+				for (uint32_t slot = node.offset; slot < node.offset + node.count; ++slot) {
+					if (!callback(this->triangles[slot])) return;
+				}
+				continue;
+			}
+
+			stack.push({ node.offset, result == 1 });
+			stack.push({ entry.node + 1, result == 1 });
+		}
+	}
+	void StaticBVH::query(const AABB& box, const Callback& callback) const {
+		this->query([&box](const Node& node) {
+			return AABB(node.min, node.max).overlaps(box) ? 1 : 0;
+		}, callback);
+	}
+	void StaticBVH::query(const glm::vec3& center, const float radius, const Callback& callback) const {
+		this->query([&center, radius](const Node& node) {
+			return AABB(node.min, node.max).overlaps(center, radius) ? 1 : 0;
+		}, callback);
+	}
+	void StaticBVH::query(const Frustum& frustum, const Callback& callback) const {
+		// 0 outside, 1 crossing, 2 inside all planes.
+		this->query([&frustum](const Node& node) {
+			const int planes = classify(AABB(node.min, node.max), frustum, ALL_PLANES);
+			return planes < 0 ? 0 : (planes == 0 ? 2 : 1);
+		}, callback);
+	}
+
+	AABB StaticBVH::getBounds() const {
+		return this->nodes.empty() ? AABB() : AABB(this->nodes[0].min, this->nodes[0].max);
+	}
+	size_t StaticBVH::getNodeCount() const {
+		return this->nodes.size();
+	}
+	size_t StaticBVH::getTriangleCount() const {
+		return this->triangles.size();
+	}
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../../include/glm/glm.hpp"
+#include "../camera/camera.h"
+
+namespace Engine {
+	struct AABB {
+		glm::vec3 min, max;
+
+		AABB();
+		AABB(const glm::vec3& min, const glm::vec3& max);
+
+		static AABB merge(const AABB& a, const AABB& b);
+
+		// Surface area, the SAH cost measure.
+		float area() const;
+		bool contains(const AABB& other) const;
+		bool overlaps(const AABB& other) const;
+		bool overlaps(const glm::vec3& center, const float radius) const;
+		// Not entirely behind any of the six planes.
+		bool overlaps(const Frustum& frustum) const;
+		// Slab test; distance is where the ray enters, 0 when it starts inside.
+		bool intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, const float maxDistance, float& distance) const;
+	};
+
+	// Incrementally updated tree over moving objects. Leaves hold bounds
+	// enlarged by a margin, so small movements need no update at all.
+	// Insertion walks down choosing the cheaper side by surface area
+	// heuristic; every node touched on the way back up is refitted and
+	// rotated when swapping a grandchild lowers the summed area.
+	class AABBTree {
+	public:
+		typedef uint32_t Proxy;
+
+		static constexpr Proxy NONE = UINT32_MAX;
+
+		// Return false to stop the query.
+		typedef std::function<bool(Proxy)> Callback;
+		// Gets the distance where the ray enters the proxy's bounds and
+		// returns the new maximum distance, e.g. the distance of an exact
+		// hit; 0 stops the query.
+		typedef std::function<float(Proxy, float)> RayCallback;
+	private:
+		struct Node {
+			AABB bounds;
+			uint32_t parent;
+			uint32_t child1, child2;
+			int32_t height;
+			uint32_t data;
+
+			bool isLeaf() const;
+		};
+
+		std::vector<Node> nodes;
+		uint32_t root;
+		uint32_t freeList;
+		size_t proxyCount;
+		float margin;
+
+		uint32_t allocateNode();
+		void freeNode(const uint32_t node);
+
+		void insertLeaf(const uint32_t leaf);
+		void removeLeaf(const uint32_t leaf);
+		void refit(uint32_t node);
+		void rotate(const uint32_t node);
+	public:
+		AABBTree(const float margin = 0.1f);
+
+		Proxy insert(const AABB& bounds, const uint32_t data);
+		void remove(const Proxy proxy);
+		// Returns true when bounds left the enlarged box and the proxy was
+		// reinserted.
+		bool move(const Proxy proxy, const AABB& bounds);
+
+		const AABB& getBounds(const Proxy proxy) const;
+		uint32_t getData(const Proxy proxy) const;
+
+		void query(const AABB& box, const Callback& callback) const;
+		void query(const glm::vec3& center, const float radius, const Callback& callback) const;
+		// Subtrees entirely inside the frustum are reported without
+		// further plane tests.
+		void query(const Frustum& frustum, const Callback& callback) const;
+		// direction need not be normalized; distances are in its units.
+		void raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, const RayCallback& callback) const;
+
+		size_t getProxyCount() const;
+		int getHeight() const;
+		// Sum of internal node areas over root area; lower is better.
+		float getAreaRatio() const;
+	};
+
+	// Bounding volume hierarchy over static triangles, built once with a
+	// binned surface area heuristic. Nodes are 32 bytes, laid out depth
+	// first so the left child follows its parent, and each leaf's triangles
+	// are stored next to each other.
+	class StaticBVH {
+	public:
+		struct Hit {
+			uint32_t triangle;
+			float distance;
+			glm::vec2 barycentric;
+		};
+
+		typedef std::function<bool(uint32_t)> Callback;
+	private:
+		struct alignas(32) Node {
+			glm::vec3 min;
+			// Leaf: first triangle slot. Inner node: index of the right child.
+			uint32_t offset;
+			glm::vec3 max;
+			// Triangles in a leaf, 0 for inner nodes.
+			uint32_t count;
+		};
+
+		std::vector<Node> nodes;
+		// Three corners per triangle slot, in leaf order.
+		std::vector<glm::vec3> corners;
+		// Original triangle index of every slot.
+		std::vector<uint32_t> triangles;
+
+		uint32_t buildNode(std::vector<uint32_t>& order, const std::vector<AABB>& bounds, const std::vector<glm::vec3>& centroids, const uint32_t begin, const uint32_t end);
+
+		void query(const std::function<int(const Node&)>& test, const Callback& callback) const;
+	public:
+		static const uint32_t MAX_LEAF_TRIANGLES = 4;
+
+		// Every three indices form a triangle; with no indices every three
+		// positions do.
+		void build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+		void clear();
+
+		// Closest hit before maxDistance, triangles tested with
+		// glm::intersectRayTriangle. direction need not be normalized.
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance, Hit& hit) const;
+
+		// Triangles in leaves whose bounds pass the test; callbacks get
+		// original triangle indices.
+		void query(const AABB& box, const Callback& callback) const;
+		void query(const glm::vec3& center, const float radius, const Callback& callback) const;
+		void query(const Frustum& frustum, const Callback& callback) const;
+
+		AABB getBounds() const;
+		size_t getNodeCount() const;
+		size_t getTriangleCount() const;
+	};
+}
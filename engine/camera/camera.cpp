@@ -0,0 +1,475 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../../include/glm/gtc/matrix_transform.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ENGINE_CAMERA_X86
+#include <immintrin.h>
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Engine {
+	// Frustum part
+
+	Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+		const glm::vec4 rowX(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		const glm::vec4 rowY(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		const glm::vec4 rowZ(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const glm::vec4 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.planes[0] = rowW + rowX;
+		frustum.planes[1] = rowW - rowX;
+		frustum.planes[2] = rowW + rowY;
+		frustum.planes[3] = rowW - rowY;
+		frustum.planes[4] = rowW + rowZ;
+		frustum.planes[5] = rowW - rowZ;
+
+		for (glm::vec4& plane : frustum.planes) plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+
+	// Bounds part
+
+	void BoundingSpheres::add(const glm::vec3& center, const float radius) {
+		this->x.push_back(center.x);
+		this->y.push_back(center.y);
+		this->z.push_back(center.z);
+		this->radius.push_back(radius);
+	}
+	void BoundingSpheres::set(const size_t index, const glm::vec3& center, const float radius) {
+		this->x[index] = center.x;
+		this->y[index] = center.y;
+		this->z[index] = center.z;
+		this->radius[index] = radius;
+	}
+	void BoundingSpheres::clear() {
+		this->x.clear();
+		this->y.clear();
+		this->z.clear();
+		this->radius.clear();
+	}
+	size_t BoundingSpheres::size() const {
+		return this->x.size();
+	}
+
+	void BoundingBoxes::add(const glm::vec3& min, const glm::vec3& max) {
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+
+		this->x.push_back(center.x);
+		this->y.push_back(center.y);
+		this->z.push_back(center.z);
+		this->extentX.push_back(extent.x);
+		this->extentY.push_back(extent.y);
+		this->extentZ.push_back(extent.z);
+	}
+	void BoundingBoxes::set(const size_t index, const glm::vec3& min, const glm::vec3& max) {
+		const glm::vec3 center = (min + max) * 0.5f;
+		const glm::vec3 extent = (max - min) * 0.5f;
+
+		this->x[index] = center.x;
+		this->y[index] = center.y;
+		this->z[index] = center.z;
+		this->extentX[index] = extent.x;
+		this->extentY[index] = extent.y;
+		this->extentZ[index] = extent.z;
+	}
+	void BoundingBoxes::clear() {
+		this->x.clear();
+		this->y.clear();
+		this->z.clear();
+		this->extentX.clear();
+		this->extentY.clear();
+		this->extentZ.clear();
+	}
+	size_t BoundingBoxes::size() const {
+		return this->x.size();
+	}
+
+	// Camera part
+
+	Camera::Camera() : position(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), orthographic(false),
+		fov(glm::radians(60.0f)), aspect(1.0f), nearPlane(0.1f), farPlane(1000.0f),
+		left(-1.0f), right(1.0f), bottom(-1.0f), top(1.0f),
+		viewDirty(true), projectionDirty(true), frustumDirty(true) {
+	}
+
+	void Camera::setPosition(const glm::vec3& position) {
+		this->position = position;
+		this->viewDirty = true;
+	}
+	void Camera::setRotation(const glm::quat& rotation) {
+		this->rotation = glm::normalize(rotation);
+		this->viewDirty = true;
+	}
+	void Camera::lookAt(const glm::vec3& target, const glm::vec3& up) {
+		this->rotation = glm::quatLookAt(glm::normalize(target - this->position), up);
+		this->viewDirty = true;
+	}
+
+	void Camera::setPerspective(const float fov, const float aspect, const float nearPlane, const float farPlane) {
+		this->orthographic = false;
+		this->fov = fov;
+		this->aspect = aspect;
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		this->projectionDirty = true;
+	}
+	void Camera::setOrthographic(const float left, const float right, const float bottom, const float top, const float nearPlane, const float farPlane) {
+		this->orthographic = true;
+		this->left = left;
+		this->right = right;
+		this->bottom = bottom;
+		this->top = top;
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		this->projectionDirty = true;
+	}
+	void Camera::setAspect(const float aspect) {
+		this->aspect = aspect;
+		this->projectionDirty = true;
+	}
+
+	const glm::vec3& Camera::getPosition() const {
+		return this->position;
+	}
+	const glm::quat& Camera::getRotation() const {
+		return this->rotation;
+	}
+	glm::vec3 Camera::getForward() const {
+		return this->rotation * glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+	glm::vec3 Camera::getRight() const {
+		return this->rotation * glm::vec3(1.0f, 0.0f, 0.0f);
+	}
+	glm::vec3 Camera::getUp() const {
+		return this->rotation * glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+
+	void Camera::updateMatrices() const {
+		if (!this->viewDirty && !this->projectionDirty) return;
+
+		if (this->viewDirty) {
+			this->view = glm::mat4_cast(glm::conjugate(this->rotation)) * glm::translate(glm::mat4(1.0f), -this->position);
+		}
+		if (this->projectionDirty) {
+			this->projection = this->orthographic
+				? glm::ortho(this->left, this->right, this->bottom, this->top, this->nearPlane, this->farPlane)
+				: glm::perspective(this->fov, this->aspect, this->nearPlane, this->farPlane);
+		}
+
+		this->viewProjection = this->projection * this->view;
+		this->viewDirty = false;
+		this->projectionDirty = false;
+		this->frustumDirty = true;
+	}
+
+	const glm::mat4& Camera::getView() const {
+		this->updateMatrices();
+		return this->view;
+	}
+	const glm::mat4& Camera::getProjection() const {
+		this->updateMatrices();
+		return this->projection;
+	}
+	const glm::mat4& Camera::getViewProjection() const {
+		this->updateMatrices();
+		return this->viewProjection;
+	}
+	const Frustum& Camera::getFrustum() const {
+		this->updateMatrices();
+
+		if (this->frustumDirty) {
+			this->frustum = Frustum::fromMatrix(this->viewProjection);
+			this->frustumDirty = false;
+		}
+
+		return this->frustum;
+	}
+
+	// Frustum culling part
+
+	static FrustumCulling::Backend detectBackend() {
+#ifdef ENGINE_CAMERA_X86
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? FrustumCulling::AVX2 : FrustumCulling::SSE2;
+#else
+		return FrustumCulling::SCALAR;
+#endif
+	}
+
+	FrustumCulling::Backend FrustumCulling::backend = detectBackend();
+
+	FrustumCulling::Backend FrustumCulling::getBackend() {
+		return FrustumCulling::backend;
+	}
+	const char* FrustumCulling::getBackendName(const Backend backend) {
+		switch (backend) {
+		case SCALAR:
+			return "scalar";
+		case SSE2:
+			return "SSE2";
+		case AVX2:
+			return "AVX2";
+		}
+
+		return "unknown";
+	}
+	void FrustumCulling::setBackend(const Backend backend) {
+		FrustumCulling::backend = std::min(backend, detectBackend());
+	}
+
+	// Scalar code, also used for the tails the vector loops leave over. The
+	// vector code keeps the same operation order so results match exactly;
+	// products are separate statements so compilers cannot fuse them into
+	// FMAs the vector code does not use.
+
+	static size_t cullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres, const size_t begin, uint32_t* visible) {
+		size_t count = 0;
+
+		for (size_t i = begin; i < spheres.size(); ++i) {
+			const float radius = -spheres.radius[i];
+			bool inside = true;
+
+			for (const glm::vec4& plane : frustum.planes) {
+				const float dx = plane.x * spheres.x[i];
+				const float dy = plane.y * spheres.y[i];
+				const float dz = plane.z * spheres.z[i];
+
+				if (dx + dy + dz + plane.w < radius) inside = false;
+			}
+
+			if (inside) visible[count++] = (uint32_t)i;
+		}
+
+		return count;
+	}
+	static size_t cullBoxesScalar(const Frustum& frustum, const BoundingBoxes& boxes, const size_t begin, uint32_t* visible) {
+		size_t count = 0;
+
+		for (size_t i = begin; i < boxes.size(); ++i) {
+			bool inside = true;
+
+			for (const glm::vec4& plane : frustum.planes) {
+				const float dx = plane.x * boxes.x[i];
+				const float dy = plane.y * boxes.y[i];
+				const float dz = plane.z * boxes.z[i];
+				const float rx = std::fabs(plane.x) * boxes.extentX[i];
+				const float ry = std::fabs(plane.y) * boxes.extentY[i];
+				const float rz = std::fabs(plane.z) * boxes.extentZ[i];
+
+				if (dx + dy + dz + plane.w < -(rx + ry + rz)) inside = false;
+			}
+
+			if (inside) visible[count++] = (uint32_t)i;
+		}
+
+		return count;
+	}
+
+#ifdef ENGINE_CAMERA_X86
+	static size_t compactSSE2(int mask, const uint32_t base, uint32_t* visible) {
+		size_t count = 0;
+
+		while (mask) {
+			visible[count++] = base + (uint32_t)__builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+
+		return count;
+	}
+
+	static size_t cullSpheresSSE2(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const size_t end = spheres.size() & ~(size_t)3;
+		size_t count = 0;
+
+		for (size_t i = 0; i < end; i += 4) {
+			const __m128 x = _mm_loadu_ps(spheres.x.data() + i);
+			const __m128 y = _mm_loadu_ps(spheres.y.data() + i);
+			const __m128 z = _mm_loadu_ps(spheres.z.data() + i);
+			const __m128 radius = _mm_xor_ps(_mm_loadu_ps(spheres.radius.data() + i), sign);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; ++p) {
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_mul_ps(planeZ[p], z)), planeW[p]);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, radius));
+			}
+
+			count += compactSSE2(~_mm_movemask_ps(outside) & 0xF, (uint32_t)i, visible + count);
+		}
+
+		return count + cullSpheresScalar(frustum, spheres, end, visible + count);
+	}
+	static size_t cullBoxesSSE2(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+			absX[p] = _mm_set1_ps(std::fabs(frustum.planes[p].x));
+			absY[p] = _mm_set1_ps(std::fabs(frustum.planes[p].y));
+			absZ[p] = _mm_set1_ps(std::fabs(frustum.planes[p].z));
+		}
+
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const size_t end = boxes.size() & ~(size_t)3;
+		size_t count = 0;
+
+		for (size_t i = 0; i < end; i += 4) {
+			const __m128 x = _mm_loadu_ps(boxes.x.data() + i);
+			const __m128 y = _mm_loadu_ps(boxes.y.data() + i);
+			const __m128 z = _mm_loadu_ps(boxes.z.data() + i);
+			const __m128 extentX = _mm_loadu_ps(boxes.extentX.data() + i);
+			const __m128 extentY = _mm_loadu_ps(boxes.extentY.data() + i);
+			const __m128 extentZ = _mm_loadu_ps(boxes.extentZ.data() + i);
+
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; ++p) {
+				const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_mul_ps(planeZ[p], z)), planeW[p]);
+				const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], extentX), _mm_mul_ps(absY[p], extentY)), _mm_mul_ps(absZ[p], extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_xor_ps(radius, sign)));
+			}
+
+			count += compactSSE2(~_mm_movemask_ps(outside) & 0xF, (uint32_t)i, visible + count);
+		}
+
+		return count + cullBoxesScalar(frustum, boxes, end, visible + count);
+	}
+
+	// For every 8-bit mask, the positions of its set bits packed in
+	// nibbles, lowest first: one permute then moves the visible lanes
+	// to the front.
+	struct CompactTable {
+		uint32_t masks[256];
+
+		CompactTable() {
+			for (uint32_t mask = 0; mask < 256; ++mask) {
+				uint32_t packed = 0, count = 0;
+
+				for (uint32_t bit = 0; bit < 8; ++bit) {
+					if (mask & (1u << bit)) packed |= bit << (4 * count++);
+				}
+
+				this->masks[mask] = packed;
+			}
+		}
+	};
+	static const CompactTable compactTable;
+
+	ENGINE_TARGET_AVX2 static size_t compactAVX2(const int mask, const uint32_t base, uint32_t* visible) {
+		const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+		const __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)compactTable.masks[mask]), shifts), _mm256_set1_epi32(0xF));
+		const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32((int)base), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible), _mm256_permutevar8x32_epi32(indices, lanes));
+
+		return (size_t)__builtin_popcount(mask);
+	}
+
+	ENGINE_TARGET_AVX2 static size_t cullSpheresAVX2(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		const size_t end = spheres.size() & ~(size_t)7;
+		size_t count = 0;
+
+		for (size_t i = 0; i < end; i += 8) {
+			const __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+			const __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+			const __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+			const __m256 radius = _mm256_xor_ps(_mm256_loadu_ps(spheres.radius.data() + i), sign);
+
+			__m256 outside = _mm256_setzero_ps();
+			for (int p = 0; p < 6; ++p) {
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)), _mm256_mul_ps(planeZ[p], z)), planeW[p]);
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, radius, _CMP_LT_OQ));
+			}
+
+			count += compactAVX2(~_mm256_movemask_ps(outside) & 0xFF, (uint32_t)i, visible + count);
+		}
+
+		return count + cullSpheresScalar(frustum, spheres, end, visible + count);
+	}
+	ENGINE_TARGET_AVX2 static size_t cullBoxesAVX2(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+		for (int p = 0; p < 6; ++p) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+			absX[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].x));
+			absY[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].y));
+			absZ[p] = _mm256_set1_ps(std::fabs(frustum.planes[p].z));
+		}
+
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		const size_t end = boxes.size() & ~(size_t)7;
+		size_t count = 0;
+
+		for (size_t i = 0; i < end; i += 8) {
+			const __m256 x = _mm256_loadu_ps(boxes.x.data() + i);
+			const __m256 y = _mm256_loadu_ps(boxes.y.data() + i);
+			const __m256 z = _mm256_loadu_ps(boxes.z.data() + i);
+			const __m256 extentX = _mm256_loadu_ps(boxes.extentX.data() + i);
+			const __m256 extentY = _mm256_loadu_ps(boxes.extentY.data() + i);
+			const __m256 extentZ = _mm256_loadu_ps(boxes.extentZ.data() + i);
+
+			__m256 outside = _mm256_setzero_ps();
+			for (int p = 0; p < 6; ++p) {
+				const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)), _mm256_mul_ps(planeZ[p], z)), planeW[p]);
+				const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absX[p], extentX), _mm256_mul_ps(absY[p], extentY)), _mm256_mul_ps(absZ[p], extentZ));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_xor_ps(radius, sign), _CMP_LT_OQ));
+			}
+
+			count += compactAVX2(~_mm256_movemask_ps(outside) & 0xFF, (uint32_t)i, visible + count);
+		}
+
+		return count + cullBoxesScalar(frustum, boxes, end, visible + count);
+	}
+#endif
+
+	size_t FrustumCulling::cull(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible) {
+#ifdef ENGINE_CAMERA_X86
+		if (FrustumCulling::backend == AVX2) return cullSpheresAVX2(frustum, spheres, visible);
+		if (FrustumCulling::backend == SSE2) return cullSpheresSSE2(frustum, spheres, visible);
+#endif
+		return cullSpheresScalar(frustum, spheres, 0, visible);
+	}
+	size_t FrustumCulling::cull(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible) {
+#ifdef ENGINE_CAMERA_X86
+		if (FrustumCulling::backend == AVX2) return cullBoxesAVX2(frustum, boxes, visible);
+		if (FrustumCulling::backend == SSE2) return cullBoxesSSE2(frustum, boxes, visible);
+#endif
+		return cullBoxesScalar(frustum, boxes, 0, visible);
+	}
+
+	void FrustumCulling::cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible) {
+		visible.resize(spheres.size() + FrustumCulling::OUTPUT_PADDING);
+		visible.resize(FrustumCulling::cull(frustum, spheres, visible.data()));
+	}
+	void FrustumCulling::cull(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible) {
+		visible.resize(boxes.size() + FrustumCulling::OUTPUT_PADDING);
+		visible.resize(FrustumCulling::cull(frustum, boxes, visible.data()));
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../include/glm/glm.hpp"
+#include "../../include/glm/gtc/quaternion.hpp"
+
+namespace Engine {
+	// Six planes with inward normals: a point p is inside when
+	// dot(plane.xyz, p) + plane.w >= 0 for all of them. Order: left,
+	// right, bottom, top, near, far.
+	struct Frustum {
+		glm::vec4 planes[6];
+
+		// Gribb-Hartmann extraction for OpenGL clip space, normalized.
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+	};
+
+	// Bounds stored one array per coordinate, so culling loads 4 or 8
+	// objects per instruction.
+	struct BoundingSpheres {
+		std::vector<float> x, y, z, radius;
+
+		void add(const glm::vec3& center, const float radius);
+		void set(const size_t index, const glm::vec3& center, const float radius);
+		void clear();
+		size_t size() const;
+	};
+	// Axis-aligned boxes as center and half extent.
+	struct BoundingBoxes {
+		std::vector<float> x, y, z, extentX, extentY, extentZ;
+
+		void add(const glm::vec3& min, const glm::vec3& max);
+		void set(const size_t index, const glm::vec3& min, const glm::vec3& max);
+		void clear();
+		size_t size() const;
+	};
+
+	class Camera {
+	private:
+		glm::vec3 position;
+		glm::quat rotation;
+
+		bool orthographic;
+		float fov, aspect, nearPlane, farPlane;
+		float left, right, bottom, top;
+
+		// Rebuilt on first use after a change.
+		mutable glm::mat4 view, projection, viewProjection;
+		mutable Frustum frustum;
+		mutable bool viewDirty, projectionDirty, frustumDirty;
+
+		void updateMatrices() const;
+	public:
+		// 60 degree perspective, aspect 1, planes at 0.1 and 1000.
+		Camera();
+
+		void setPosition(const glm::vec3& position);
+		void setRotation(const glm::quat& rotation);
+		void lookAt(const glm::vec3& target, const glm::vec3& up);
+
+		// fov is the vertical field of view in radians.
+		void setPerspective(const float fov, const float aspect, const float nearPlane, const float farPlane);
+		void setOrthographic(const float left, const float right, const float bottom, const float top, const float nearPlane, const float farPlane);
+		void setAspect(const float aspect);
+
+		const glm::vec3& getPosition() const;
+		const glm::quat& getRotation() const;
+		glm::vec3 getForward() const;
+		glm::vec3 getRight() const;
+		glm::vec3 getUp() const;
+
+		// The getters below refresh the cached values, so one thread at a
+		// time.
+		const glm::mat4& getView() const;
+		const glm::mat4& getProjection() const;
+		const glm::mat4& getViewProjection() const;
+		const Frustum& getFrustum() const;
+	};
+
+	// Writes the indices of bounds that intersect the frustum to visible,
+	// ascending, and returns how many there are. Picks AVX2 (8 per step),
+	// SSE2 (4 per step) or plain C++ at runtime; all give the same list.
+	class FrustumCulling {
+	public:
+		enum Backend {
+			SCALAR = 0,
+			SSE2 = 1,
+			AVX2 = 2
+		};
+
+		// visible must have room for this many entries past the bound count.
+		static const size_t OUTPUT_PADDING = 8;
+	private:
+		static Backend backend;
+	public:
+		static Backend getBackend();
+		static const char* getBackendName(const Backend backend);
+		// Requests above what the CPU supports are clamped.
+		static void setBackend(const Backend backend);
+
+		static size_t cull(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t* visible);
+		static size_t cull(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t* visible);
+
+		// Resizes visible to the result.
+		static void cull(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visible);
+		static void cull(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<uint32_t>& visible);
+	};
+}
@@ -0,0 +1,358 @@
+#include "ctex.h"
+#include "../image/image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace Engine {
+	static const char MAGIC[4] = { 'C', 'T', 'E', 'X' };
+	static const uint32_t VERSION = 1;
+
+	CompressedTexture::CompressedTexture() {
+		this->format = BC1;
+		this->srgb = false;
+
+		this->width = 0;
+		this->height = 0;
+	}
+
+	size_t CompressedTexture::getBlockSize(const Format format) {
+		return (format == BC1 || format == BC4) ? 8 : 16;
+	}
+	const char* CompressedTexture::getFormatName(const Format format) {
+		switch (format) {
+		case BC1:
+			return "BC1";
+		case BC3:
+			return "BC3";
+		case BC4:
+			return "BC4";
+		case BC5:
+			return "BC5";
+		}
+
+		return "unknown";
+	}
+
+	CompressedTexture CompressedTexture::cook(const uint8_t* rgba, const uint32_t width, const uint32_t height, const Format format, const bool srgb, const bool mipmaps) {
+		CompressedTexture texture;
+		texture.format = format;
+		texture.srgb = srgb;
+		texture.width = width;
+		texture.height = height;
+
+		std::vector<uint8_t> level(rgba, rgba + (size_t)width * height * 4);
+		uint32_t levelWidth = width, levelHeight = height;
+
+		while (true) {
+			CompressedTextureLevel info;
+			info.width = levelWidth;
+			info.height = levelHeight;
+			info.offset = texture.data.size();
+			info.size = (uint64_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * CompressedTexture::getBlockSize(format);
+
+			texture.data.resize(info.offset + info.size);
+			CompressedTexture::encodeLevel(level, levelWidth, levelHeight, format, &texture.data[info.offset]);
+			texture.levels.push_back(info);
+
+			if (!mipmaps || (levelWidth == 1 && levelHeight == 1)) break;
+
+			std::vector<uint8_t> next((size_t)std::max(levelWidth / 2, 1u) * std::max(levelHeight / 2, 1u) * 4);
+			ImageProcessing::downsample(level.data(), (int)levelWidth, (int)levelHeight, next.data());
+
+			level.swap(next);
+			levelWidth = std::max(levelWidth / 2, 1u);
+			levelHeight = std::max(levelHeight / 2, 1u);
+		}
+
+		return texture;
+	}
+
+	bool CompressedTexture::save(const std::string& path) const {
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open()) return false;
+
+		const uint32_t levelCount = (uint32_t)this->levels.size();
+		const uint32_t format = this->format;
+		const uint32_t srgb = this->srgb;
+
+		stream.write(MAGIC, sizeof(MAGIC));
+		stream.write((const char*)&VERSION, sizeof(VERSION));
+		stream.write((const char*)&format, sizeof(format));
+		stream.write((const char*)&srgb, sizeof(srgb));
+		stream.write((const char*)&this->width, sizeof(this->width));
+		stream.write((const char*)&this->height, sizeof(this->height));
+		stream.write((const char*)&levelCount, sizeof(levelCount));
+
+		for (const CompressedTextureLevel& level : this->levels) {
+			stream.write((const char*)&level.width, sizeof(level.width));
+			stream.write((const char*)&level.height, sizeof(level.height));
+			stream.write((const char*)&level.offset, sizeof(level.offset));
+			stream.write((const char*)&level.size, sizeof(level.size));
+		}
+
+		stream.write((const char*)this->data.data(), (std::streamsize)this->data.size());
+		return stream.good();
+	}
+	bool CompressedTexture::load(const std::string& path, CompressedTexture& texture) {
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream.is_open()) return false;
+
+		return CompressedTexture::read(stream, texture);
+	}
+	bool CompressedTexture::load(std::span<const std::byte> data, CompressedTexture& texture) {
+		// Reads the bytes in place rather than copying them into a stringstream.
+		struct MemoryBuffer : std::streambuf {
+			MemoryBuffer(char* begin, char* end) {
+				this->setg(begin, begin, end);
+			}
+		};
+
+		MemoryBuffer buffer((char*)data.data(), (char*)data.data() + data.size());
+		std::istream stream(&buffer);
+
+		return CompressedTexture::read(stream, texture);
+	}
+	bool CompressedTexture::read(std::istream& stream, CompressedTexture& texture) {
+		char magic[4];
+		uint32_t version, format, srgb, levelCount;
+
+		stream.read(magic, sizeof(magic));
+		stream.read((char*)&version, sizeof(version));
+
+		if (!stream || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+			return false;
+		}
+
+		stream.read((char*)&format, sizeof(format));
+		stream.read((char*)&srgb, sizeof(srgb));
+		stream.read((char*)&texture.width, sizeof(texture.width));
+		stream.read((char*)&texture.height, sizeof(texture.height));
+		stream.read((char*)&levelCount, sizeof(levelCount));
+
+		if (!stream || levelCount == 0 || levelCount > 32) return false;
+
+		texture.format = (Format)format;
+		texture.srgb = srgb != 0;
+
+		uint64_t dataSize = 0;
+		texture.levels = std::vector<CompressedTextureLevel>(levelCount);
+
+		for (CompressedTextureLevel& level : texture.levels) {
+			stream.read((char*)&level.width, sizeof(level.width));
+			stream.read((char*)&level.height, sizeof(level.height));
+			stream.read((char*)&level.offset, sizeof(level.offset));
+			stream.read((char*)&level.size, sizeof(level.size));
+
+			if (level.size > UINT64_MAX - level.offset) return false;
+			dataSize = std::max(dataSize, level.offset + level.size);
+		}
+
+		if (!stream) return false;
+
+		texture.data = std::vector<uint8_t>(dataSize);
+		stream.read((char*)texture.data.data(), (std::streamsize)dataSize);
+
+		if (!stream) return false;
+
+		// Every level has to lie inside the data, or uploading it would
+		// read past the end.
+		for (const CompressedTextureLevel& level : texture.levels) {
+			if (level.offset > texture.data.size() || level.size > texture.data.size() - level.offset) return false;
+		}
+
+		return true;
+	}
+
+	void CompressedTexture::encodeLevel(const std::vector<uint8_t>& rgba, const uint32_t width, const uint32_t height, const Format format, uint8_t* output) {
+		const size_t blockSize = CompressedTexture::getBlockSize(format);
+
+		for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+			for (uint32_t blockX = 0; blockX < width; blockX += 4) {
+				// Edge blocks repeat the last row and column.
+				uint8_t block[64];
+				for (uint32_t y = 0; y < 4; ++y) {
+					for (uint32_t x = 0; x < 4; ++x) {
+						const uint32_t sourceX = std::min(blockX + x, width - 1);
+						const uint32_t sourceY = std::min(blockY + y, height - 1);
+
+						std::memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+					}
+				}
+
+				switch (format) {
+				case BC1:
+					CompressedTexture::encodeColorBlock(block, output);
+					break;
+				case BC3:
+					CompressedTexture::encodeChannelBlock(block, 3, output);
+					CompressedTexture::encodeColorBlock(block, output + 8);
+					break;
+				case BC4:
+					CompressedTexture::encodeChannelBlock(block, 0, output);
+					break;
+				case BC5:
+					CompressedTexture::encodeChannelBlock(block, 0, output);
+					CompressedTexture::encodeChannelBlock(block, 1, output + 8);
+					break;
+				}
+
+				output += blockSize;
+			}
+		}
+	}
+
+	static uint16_t packColor565(const float color[3]) {
+		const int r = std::clamp((int)std::lround(color[0] * 31.0f / 255.0f), 0, 31);
+		const int g = std::clamp((int)std::lround(color[1] * 63.0f / 255.0f), 0, 63);
+		const int b = std::clamp((int)std::lround(color[2] * 31.0f / 255.0f), 0, 31);
+
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+	static void unpackColor565(const uint16_t packed, int color[3]) {
+		const int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	void CompressedTexture::encodeColorBlock(const uint8_t block[64], uint8_t output[8]) {
+		// Endpoints are the extremes of the block along its principal axis.
+		float mean[3] = {};
+		for (int i = 0; i < 16; ++i) {
+			for (int c = 0; c < 3; ++c) mean[c] += block[i * 4 + c] / 16.0f;
+		}
+
+		float covariance[6] = {};
+		for (int i = 0; i < 16; ++i) {
+			const float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; ++iteration) {
+			const float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+			const float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+			const float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+
+			const float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+			if (length < 1e-6f) break;
+
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+
+		float minimum = 1e30f, maximum = -1e30f;
+		int minimumIndex = 0, maximumIndex = 0;
+
+		for (int i = 0; i < 16; ++i) {
+			const float projection = block[i * 4] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+
+			if (projection < minimum) {
+				minimum = projection;
+				minimumIndex = i;
+			}
+			if (projection > maximum) {
+				maximum = projection;
+				maximumIndex = i;
+			}
+		}
+
+		float high[3], low[3];
+		for (int c = 0; c < 3; ++c) {
+			high[c] = block[maximumIndex * 4 + c];
+			low[c] = block[minimumIndex * 4 + c];
+		}
+
+		uint16_t color0 = packColor565(high), color1 = packColor565(low);
+		if (color0 < color1) std::swap(color0, color1);
+
+		uint32_t indices = 0;
+
+		// Equal endpoints select three-color mode; index 0 is still exact there.
+		if (color0 != color1) {
+			int palette[4][3];
+			unpackColor565(color0, palette[0]);
+			unpackColor565(color1, palette[1]);
+
+			for (int c = 0; c < 3; ++c) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; ++i) {
+				int best = 0, bestError = 1 << 30;
+
+				for (int p = 0; p < 4; ++p) {
+					int error = 0;
+					for (int c = 0; c < 3; ++c) {
+						const int difference = block[i * 4 + c] - palette[p][c];
+						error += difference * difference;
+					}
+
+					if (error < bestError) {
+						bestError = error;
+						best = p;
+					}
+				}
+
+				indices |= (uint32_t)best << (i * 2);
+			}
+		}
+
+		output[0] = (uint8_t)(color0 & 0xFF);
+		output[1] = (uint8_t)(color0 >> 8);
+		output[2] = (uint8_t)(color1 & 0xFF);
+		output[3] = (uint8_t)(color1 >> 8);
+
+		for (int i = 0; i < 4; ++i) output[4 + i] = (uint8_t)(indices >> (i * 8));
+	}
+
+	void CompressedTexture::encodeChannelBlock(const uint8_t block[64], const int channel, uint8_t output[8]) {
+		int minimum = 255, maximum = 0;
+		for (int i = 0; i < 16; ++i) {
+			minimum = std::min<int>(minimum, block[i * 4 + channel]);
+			maximum = std::max<int>(maximum, block[i * 4 + channel]);
+		}
+
+		uint64_t indices = 0;
+
+		// maximum > minimum selects the eight-value ramp; a flat block keeps index 0.
+		if (maximum > minimum) {
+			int palette[8];
+			palette[0] = maximum;
+			palette[1] = minimum;
+			for (int i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * maximum + i * minimum) / 7;
+
+			for (int i = 0; i < 16; ++i) {
+				int best = 0, bestError = 1 << 30;
+
+				for (int p = 0; p < 8; ++p) {
+					const int error = std::abs(block[i * 4 + channel] - palette[p]);
+
+					if (error < bestError) {
+						bestError = error;
+						best = p;
+					}
+				}
+
+				indices |= (uint64_t)best << (i * 3);
+			}
+		}
+
+		output[0] = (uint8_t)maximum;
+		output[1] = (uint8_t)minimum;
+
+		for (int i = 0; i < 6; ++i) output[2 + i] = (uint8_t)(indices >> (i * 8));
+	}
+}
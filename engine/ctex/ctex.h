@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Engine {
+	// Block-compressed texture with its full mip chain, as written by the
+	// texcook tool into ".ctex" files. Levels are stored largest first and
+	// are ready to hand to glCompressedTexImage2D as they are.
+	struct CompressedTextureLevel {
+		uint32_t width, height;
+		uint64_t offset, size;
+	};
+	class CompressedTexture {
+	public:
+		enum Format : uint32_t {
+			BC1 = 1,
+			BC3 = 3,
+			BC4 = 4,
+			BC5 = 5
+		};
+
+		Format format;
+		bool srgb;
+
+		uint32_t width, height;
+
+		std::vector<CompressedTextureLevel> levels;
+		std::vector<uint8_t> data;
+
+		CompressedTexture();
+
+		static CompressedTexture cook(const uint8_t* rgba, const uint32_t width, const uint32_t height, const Format format, const bool srgb, const bool mipmaps);
+
+		bool save(const std::string& path) const;
+		static bool load(const std::string& path, CompressedTexture& texture);
+		static bool load(std::span<const std::byte> data, CompressedTexture& texture);
+
+		static size_t getBlockSize(const Format format);
+		static const char* getFormatName(const Format format);
+	private:
+		static bool read(std::istream& stream, CompressedTexture& texture);
+
+		static void encodeLevel(const std::vector<uint8_t>& rgba, const uint32_t width, const uint32_t height, const Format format, uint8_t* output);
+
+		static void encodeColorBlock(const uint8_t block[64], uint8_t output[8]);
+		static void encodeChannelBlock(const uint8_t block[64], const int channel, uint8_t output[8]);
+	};
+}
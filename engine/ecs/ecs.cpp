@@ -0,0 +1,255 @@
+#include "ecs.h"
+
+#include <algorithm>
+
+namespace Engine {
+	// Command buffer part
+
+	void CommandBuffer::destroy(const Entity entity) {
+		this->record([entity](World& world) {
+			if (world.isAlive(entity)) world.destroy(entity);
+		});
+	}
+
+	void CommandBuffer::apply(World& world) {
+		for (std::unique_ptr<Command>& command : this->commands) command->apply(world);
+		this->commands.clear();
+	}
+	void CommandBuffer::clear() {
+		this->commands.clear();
+	}
+
+	size_t CommandBuffer::size() const {
+		return this->commands.size();
+	}
+
+	// Archetype part
+
+	int World::Archetype::getColumn(const ComponentId component) const {
+		std::vector<ComponentId>::const_iterator it = std::lower_bound(this->components.begin(), this->components.end(), component);
+		if (it == this->components.end() || *it != component) return -1;
+
+		return (int)(it - this->components.begin());
+	}
+	uint32_t World::Archetype::getChunkCount(const size_t chunk) const {
+		return std::min(this->capacity, this->count - (uint32_t)chunk * this->capacity);
+	}
+	void* World::Archetype::getComponent(const uint32_t row, const int column) const {
+		return this->chunks[row / this->capacity] + this->offsets[column] + (size_t)(row % this->capacity) * World::componentInfos[this->components[column]].size;
+	}
+	Entity& World::Archetype::getEntity(const uint32_t row) const {
+		return reinterpret_cast<Entity*>(this->chunks[row / this->capacity])[row % this->capacity];
+	}
+
+	// World part
+
+	std::array<World::ComponentInfo, World::MAX_COMPONENTS> World::componentInfos;
+	std::atomic<uint32_t> World::componentCount = 0;
+	std::mutex World::componentMutex;
+
+	World::World() : entityCount(0) {
+		this->getArchetype(Mask());
+	}
+	World::~World() {
+		for (std::unique_ptr<Archetype>& archetype : this->archetypes) {
+			for (uint32_t row = 0; row < archetype->count; ++row) {
+				for (size_t column = 0; column < archetype->components.size(); ++column) {
+					World::componentInfos[archetype->components[column]].destroy(archetype->getComponent(row, (int)column));
+				}
+			}
+
+			for (std::byte* chunk : archetype->chunks) ::operator delete(chunk, std::align_val_t(64));
+		}
+	}
+
+	World::ComponentId World::registerComponent(const ComponentInfo& info) {
+		std::lock_guard<std::mutex> lock(World::componentMutex);
+
+		const ComponentId id = World::componentCount.load();
+		if (id >= World::MAX_COMPONENTS) std::abort();
+
+		World::componentInfos[id] = info;
+		World::componentCount.store(id + 1);
+
+		return id;
+	}
+
+	World::Archetype* World::getArchetype(const Mask& mask) {
+		std::unordered_map<Mask, Archetype*>::iterator it = this->archetypeMap.find(mask);
+		if (it != this->archetypeMap.end()) return it->second;
+
+		std::unique_ptr<Archetype> archetype = std::make_unique<Archetype>();
+		archetype->mask = mask;
+		archetype->count = 0;
+
+		size_t rowSize = sizeof(Entity);
+		for (ComponentId id = 0; id < World::MAX_COMPONENTS; ++id) {
+			if (!mask.test(id)) continue;
+
+			archetype->components.push_back(id);
+			rowSize += World::componentInfos[id].size;
+		}
+
+		// Columns follow the entity column, each aligned for its type; drop
+		// rows until the padding fits. Rows too large for one chunk get a
+		// bigger chunk holding a single entity.
+		auto layout = [&archetype](const uint32_t capacity) {
+			archetype->offsets.clear();
+			size_t offset = (size_t)capacity * sizeof(Entity);
+
+			for (ComponentId id : archetype->components) {
+				const ComponentInfo& info = World::componentInfos[id];
+
+				offset = (offset + info.alignment - 1) / info.alignment * info.alignment;
+				archetype->offsets.push_back((uint32_t)offset);
+				offset += (size_t)capacity * info.size;
+			}
+
+			return offset;
+		};
+
+		archetype->capacity = std::max<uint32_t>(1, (uint32_t)(World::CHUNK_SIZE / rowSize));
+		while (archetype->capacity > 1 && layout(archetype->capacity) > World::CHUNK_SIZE) --archetype->capacity;
+		archetype->chunkSize = std::max(World::CHUNK_SIZE, layout(archetype->capacity));
+
+		Archetype* result = archetype.get();
+		this->archetypeMap.emplace(mask, result);
+		this->archetypes.push_back(std::move(archetype));
+
+		return result;
+	}
+	World::Archetype* World::getAddTarget(Archetype* archetype, const ComponentId component) {
+		std::unordered_map<ComponentId, Archetype*>::iterator it = archetype->addEdges.find(component);
+		if (it != archetype->addEdges.end()) return it->second;
+
+		Mask mask = archetype->mask;
+		mask.set(component);
+
+		Archetype* target = this->getArchetype(mask);
+		archetype->addEdges.emplace(component, target);
+		target->removeEdges.emplace(component, archetype);
+
+		return target;
+	}
+	World::Archetype* World::getRemoveTarget(Archetype* archetype, const ComponentId component) {
+		std::unordered_map<ComponentId, Archetype*>::iterator it = archetype->removeEdges.find(component);
+		if (it != archetype->removeEdges.end()) return it->second;
+
+		Mask mask = archetype->mask;
+		mask.reset(component);
+
+		Archetype* target = this->getArchetype(mask);
+		archetype->removeEdges.emplace(component, target);
+		target->addEdges.emplace(component, archetype);
+
+		return target;
+	}
+
+	Entity World::allocateEntity() {
+		++this->entityCount;
+
+		if (!this->freeIndices.empty()) {
+			const uint32_t index = this->freeIndices.back();
+			this->freeIndices.pop_back();
+
+			return { index, this->records[index].generation };
+		}
+
+		this->records.push_back({ nullptr, 0, 0 });
+		return { (uint32_t)(this->records.size() - 1), 0 };
+	}
+	void World::place(const Entity entity, Archetype* archetype) {
+		if (archetype->count == archetype->chunks.size() * archetype->capacity) {
+			archetype->chunks.push_back(static_cast<std::byte*>(::operator new(archetype->chunkSize, std::align_val_t(64))));
+		}
+
+		const uint32_t row = archetype->count++;
+		archetype->getEntity(row) = entity;
+
+		Record& record = this->records[entity.index];
+		record.archetype = archetype;
+		record.row = row;
+	}
+	void World::move(const Entity entity, Archetype* target) {
+		Record& record = this->records[entity.index];
+		Archetype* source = record.archetype;
+		const uint32_t row = record.row;
+
+		this->place(entity, target);
+
+		for (size_t column = 0; column < source->components.size(); ++column) {
+			const ComponentId id = source->components[column];
+			const int targetColumn = target->getColumn(id);
+
+			if (targetColumn < 0) {
+				World::componentInfos[id].destroy(source->getComponent(row, (int)column));
+			}
+			else {
+				World::componentInfos[id].move(target->getComponent(record.row, targetColumn), source->getComponent(row, (int)column));
+			}
+		}
+
+		this->fill(source, row);
+	}
+	void World::fill(Archetype* archetype, const uint32_t row) {
+		const uint32_t last = --archetype->count;
+
+		if (row != last) {
+			for (size_t column = 0; column < archetype->components.size(); ++column) {
+				World::componentInfos[archetype->components[column]].move(archetype->getComponent(row, (int)column), archetype->getComponent(last, (int)column));
+			}
+
+			const Entity moved = archetype->getEntity(last);
+			archetype->getEntity(row) = moved;
+			this->records[moved.index].row = row;
+		}
+
+		if (archetype->count == (archetype->chunks.size() - 1) * archetype->capacity) {
+			::operator delete(archetype->chunks.back(), std::align_val_t(64));
+			archetype->chunks.pop_back();
+		}
+	}
+
+	void* World::getComponent(const Entity entity, const ComponentId component) const {
+		if (!this->isAlive(entity)) return nullptr;
+
+		const Record& record = this->records[entity.index];
+		const int column = record.archetype->getColumn(component);
+		if (column < 0) return nullptr;
+
+		return record.archetype->getComponent(record.row, column);
+	}
+
+	void World::destroy(const Entity entity) {
+		if (!this->isAlive(entity)) return;
+
+		Record& record = this->records[entity.index];
+		Archetype* archetype = record.archetype;
+
+		for (size_t column = 0; column < archetype->components.size(); ++column) {
+			World::componentInfos[archetype->components[column]].destroy(archetype->getComponent(record.row, (int)column));
+		}
+
+		this->fill(archetype, record.row);
+
+		record.archetype = nullptr;
+		++record.generation;
+		this->freeIndices.push_back(entity.index);
+		--this->entityCount;
+	}
+	bool World::isAlive(const Entity entity) const {
+		return entity.index < this->records.size() && this->records[entity.index].archetype && this->records[entity.index].generation == entity.generation;
+	}
+
+	uint32_t World::getEntityCount() const {
+		return this->entityCount;
+	}
+	size_t World::getArchetypeCount() const {
+		return this->archetypes.size();
+	}
+	size_t World::getChunkCount() const {
+		size_t count = 0;
+		for (const std::unique_ptr<Archetype>& archetype : this->archetypes) count += archetype->chunks.size();
+		return count;
+	}
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+	struct Entity {
+		uint32_t index;
+		uint32_t generation;
+
+		bool operator==(const Entity& other) const = default;
+	};
+
+	class World;
+
+	// Records structural changes (create, destroy, add, remove) so systems
+	// can request them while iterating and apply them afterwards. One
+	// buffer per thread; apply() runs the commands in recording order.
+	class CommandBuffer {
+	private:
+		struct Command {
+			virtual ~Command() = default;
+			virtual void apply(World& world) = 0;
+		};
+		template<typename Function>
+		struct Deferred : Command {
+			Function function;
+
+			Deferred(Function&& function) : function(std::move(function)) {
+			}
+			void apply(World& world) override {
+				this->function(world);
+			}
+		};
+
+		std::vector<std::unique_ptr<Command>> commands;
+
+		template<typename Function>
+		void record(Function&& function) {
+			this->commands.push_back(std::make_unique<Deferred<std::decay_t<Function>>>(std::forward<Function>(function)));
+		}
+	public:
+		template<typename... T>
+		void create(T... components);
+		void destroy(const Entity entity);
+		template<typename T>
+		void add(const Entity entity, T component);
+		template<typename T>
+		void remove(const Entity entity);
+
+		void apply(World& world);
+		void clear();
+
+		size_t size() const;
+	};
+
+	// Archetype-based entity storage. Entities with the same set of
+	// components share an archetype, which stores them in 16 KB chunks with
+	// one column per component, so a query reads only the columns it names.
+	// Adding or removing a component moves the entity to another archetype;
+	// removals fill the hole with the archetype's last entity.
+	//
+	// Structural changes invalidate component pointers and must not happen
+	// while a query iterates; record them in a CommandBuffer instead.
+	class World {
+	public:
+		static constexpr size_t CHUNK_SIZE = 16 * 1024;
+		static constexpr size_t MAX_COMPONENTS = 128;
+
+		typedef uint32_t ComponentId;
+		typedef std::bitset<MAX_COMPONENTS> Mask;
+	private:
+		struct ComponentInfo {
+			size_t size;
+			size_t alignment;
+			// Move-constructs into destination and destroys source.
+			void (*move)(void* destination, void* source);
+			void (*destroy)(void* component);
+		};
+
+		struct Archetype {
+			Mask mask;
+			std::vector<ComponentId> components;
+			// Column offset inside a chunk, per entry of components.
+			std::vector<uint32_t> offsets;
+
+			uint32_t capacity;
+			size_t chunkSize;
+			uint32_t count;
+			std::vector<std::byte*> chunks;
+
+			std::unordered_map<ComponentId, Archetype*> addEdges;
+			std::unordered_map<ComponentId, Archetype*> removeEdges;
+
+			int getColumn(const ComponentId component) const;
+			uint32_t getChunkCount(const size_t chunk) const;
+			void* getComponent(const uint32_t row, const int column) const;
+			Entity& getEntity(const uint32_t row) const;
+		};
+
+		struct Record {
+			Archetype* archetype;
+			uint32_t row;
+			uint32_t generation;
+		};
+
+		static std::array<ComponentInfo, MAX_COMPONENTS> componentInfos;
+		static std::atomic<uint32_t> componentCount;
+		static std::mutex componentMutex;
+
+		std::vector<std::unique_ptr<Archetype>> archetypes;
+		std::unordered_map<Mask, Archetype*> archetypeMap;
+
+		std::vector<Record> records;
+		std::vector<uint32_t> freeIndices;
+		uint32_t entityCount;
+
+		static ComponentId registerComponent(const ComponentInfo& info);
+
+		Archetype* getArchetype(const Mask& mask);
+		Archetype* getAddTarget(Archetype* archetype, const ComponentId component);
+		Archetype* getRemoveTarget(Archetype* archetype, const ComponentId component);
+
+		Entity allocateEntity();
+		// Appends a row for entity and points its record at it.
+		void place(const Entity entity, Archetype* archetype);
+		// Moves the row to target; components target lacks are destroyed,
+		// components only target has are left unconstructed.
+		void move(const Entity entity, Archetype* target);
+		// Moves the last row of the archetype into row.
+		void fill(Archetype* archetype, const uint32_t row);
+
+		void* getComponent(const Entity entity, const ComponentId component) const;
+	public:
+		template<typename... T>
+		class Query {
+		private:
+			World* world;
+			Mask mask;
+			std::array<ComponentId, sizeof...(T)> ids;
+
+			std::vector<Archetype*> archetypes;
+			std::vector<std::array<uint32_t, sizeof...(T)>> offsets;
+			size_t checked;
+
+			// First chunk of each archetype in the flat chunk numbering used
+			// by the range functions, plus the total at the end.
+			std::vector<size_t> chunkStarts;
+
+			template<typename Function, size_t... I>
+			static void invoke(Function& function, std::byte* chunk, const uint32_t count, const std::array<uint32_t, sizeof...(T)>& offsets, std::index_sequence<I...>) {
+				function(count, reinterpret_cast<const Entity*>(chunk), reinterpret_cast<T*>(chunk + offsets[I])...);
+			}
+		public:
+			Query(World& world) : world(&world), ids{ World::getComponentId<T>()... }, checked(0) {
+				for (ComponentId id : this->ids) this->mask.set(id);
+			}
+
+			// Picks up archetypes created since the last call.
+			void refresh() {
+				for (; this->checked < this->world->archetypes.size(); ++this->checked) {
+					Archetype* archetype = this->world->archetypes[this->checked].get();
+					if ((archetype->mask & this->mask) != this->mask) continue;
+
+					std::array<uint32_t, sizeof...(T)> columns;
+					for (size_t i = 0; i < sizeof...(T); ++i) columns[i] = archetype->offsets[archetype->getColumn(this->ids[i])];
+
+					this->archetypes.push_back(archetype);
+					this->offsets.push_back(columns);
+				}
+			}
+
+			// Numbers the matching chunks 0..count-1 for the range functions
+			// below, which only read and can run on several threads at once.
+			// The numbering holds until the next structural change.
+			size_t getChunkCount() {
+				this->refresh();
+
+				size_t total = 0;
+				this->chunkStarts.resize(this->archetypes.size() + 1);
+
+				for (size_t a = 0; a < this->archetypes.size(); ++a) {
+					this->chunkStarts[a] = total;
+					total += this->archetypes[a]->chunks.size();
+				}
+				this->chunkStarts.back() = total;
+
+				return total;
+			}
+
+			// function(count, entities, columns...) once per chunk in the range.
+			template<typename Function>
+			void eachChunk(const size_t begin, const size_t end, Function&& function) const {
+				size_t a = 0;
+
+				for (size_t chunk = begin; chunk < end; ++chunk) {
+					while (this->chunkStarts[a + 1] <= chunk) ++a;
+
+					const Archetype* archetype = this->archetypes[a];
+					const size_t c = chunk - this->chunkStarts[a];
+
+					Query::invoke(function, archetype->chunks[c], archetype->getChunkCount(c), this->offsets[a], std::index_sequence_for<T...>{});
+				}
+			}
+			template<typename Function>
+			void eachChunk(Function&& function) {
+				this->eachChunk(0, this->getChunkCount(), function);
+			}
+			// function(components&...) or function(entity, components&...)
+			// for every entity in the chunk range.
+			template<typename Function>
+			void each(const size_t begin, const size_t end, Function&& function) const {
+				this->eachChunk(begin, end, [&function](const uint32_t count, const Entity* entities, T*... columns) {
+					for (uint32_t i = 0; i < count; ++i) {
+						if constexpr (std::is_invocable_v<Function&, Entity, T&...>) {
+							function(entities[i], columns[i]...);
+						}
+						else {
+							function(columns[i]...);
+						}
+					}
+				});
+			}
+			template<typename Function>
+			void each(Function&& function) {
+				this->each(0, this->getChunkCount(), function);
+			}
+
+			size_t count() {
+				this->refresh();
+
+				size_t total = 0;
+				for (Archetype* archetype : this->archetypes) total += archetype->count;
+				return total;
+			}
+		};
+
+		World();
+		~World();
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		// const T names the same component as T; queries use it to mark
+		// columns they only read.
+		template<typename T>
+		static ComponentId getComponentId() {
+			typedef std::remove_cvref_t<T> Type;
+			static_assert(alignof(Type) <= 64, "World: component alignment above 64 is not supported");
+
+			if constexpr (!std::is_same_v<T, Type>) return World::getComponentId<Type>();
+
+			static const ComponentId id = World::registerComponent({
+				sizeof(Type),
+				alignof(Type),
+				[](void* destination, void* source) {
+					new (destination) Type(std::move(*static_cast<Type*>(source)));
+					static_cast<Type*>(source)->~Type();
+				},
+				[](void* component) {
+					static_cast<Type*>(component)->~Type();
+				}
+			});
+
+			return id;
+		}
+		template<typename... T>
+		static Mask getMask() {
+			Mask mask;
+			(mask.set(World::getComponentId<T>()), ...);
+			return mask;
+		}
+
+		template<typename... T>
+		Entity create(T... components) {
+			const Entity entity = this->allocateEntity();
+			this->place(entity, this->getArchetype(World::getMask<T...>()));
+
+			(new (this->getComponent(entity, World::getComponentId<T>())) T(std::move(components)), ...);
+
+			return entity;
+		}
+		void destroy(const Entity entity);
+		bool isAlive(const Entity entity) const;
+
+		// Replaces the component if the entity already has one. The entity
+		// must be alive.
+		template<typename T>
+		T& add(const Entity entity, T component) {
+			const ComponentId id = World::getComponentId<T>();
+
+			if (T* existing = static_cast<T*>(this->getComponent(entity, id))) {
+				*existing = std::move(component);
+				return *existing;
+			}
+
+			this->move(entity, this->getAddTarget(this->records[entity.index].archetype, id));
+			return *new (this->getComponent(entity, id)) T(std::move(component));
+		}
+		template<typename T>
+		void remove(const Entity entity) {
+			const ComponentId id = World::getComponentId<T>();
+			if (!this->getComponent(entity, id)) return;
+
+			this->move(entity, this->getRemoveTarget(this->records[entity.index].archetype, id));
+		}
+
+		// nullptr when the entity is dead or lacks the component.
+		template<typename T>
+		T* get(const Entity entity) const {
+			return static_cast<T*>(this->getComponent(entity, World::getComponentId<T>()));
+		}
+		template<typename T>
+		bool has(const Entity entity) const {
+			return this->getComponent(entity, World::getComponentId<T>()) != nullptr;
+		}
+
+		// Queries cache matching archetypes and stay valid for the world's
+		// lifetime; keep them around instead of building one per frame.
+		template<typename... T>
+		Query<T...> query() {
+			return Query<T...>(*this);
+		}
+
+		uint32_t getEntityCount() const;
+		size_t getArchetypeCount() const;
+		size_t getChunkCount() const;
+	};
+
+	template<typename... T>
+	void CommandBuffer::create(T... components) {
+		this->record([... components = std::move(components)](World& world) mutable {
+			world.create<T...>(std::move(components)...);
+		});
+	}
+	template<typename T>
+	void CommandBuffer::add(const Entity entity, T component) {
+		this->record([entity, component = std::move(component)](World& world) mutable {
+			if (world.isAlive(entity)) world.add<T>(entity, std::move(component));
+		});
+	}
+	template<typename T>
+	void CommandBuffer::remove(const Entity entity) {
+		this->record([entity](World& world) {
+			if (world.isAlive(entity)) world.remove<T>(entity);
+		});
+	}
+}
@@ -1,7 +1,125 @@
+#include "memory/memory.h"
+
+// Decoded images are charged to Memory::TEXTURE wherever they are loaded.
+#define STBI_MALLOC(size) Engine::Memory::allocate(size, Engine::Memory::TEXTURE)
+#define STBI_REALLOC(pointer, size) Engine::Memory::reallocate(pointer, size, Engine::Memory::TEXTURE)
+#define STBI_FREE(pointer) Engine::Memory::free(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include "engine.h"
 
+#include <filesystem>
+#include <algorithm>
+#include <regex>
+#include <cstring>
+#include <iomanip>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 namespace Engine {
+	// Extensions part
+
+	bool Extensions::textureStorage = false;
+	bool Extensions::textureSwizzle = false;
+	bool Extensions::textureCompressionS3TC = false;
+	bool Extensions::bindlessTexture = false;
+	bool Extensions::copyImage = false;
+
+	Extensions::TexStorage2DProc Extensions::texStorage2D = nullptr;
+	Extensions::GetTextureHandleProc Extensions::getTextureHandle = nullptr;
+	Extensions::MakeTextureHandleResidentProc Extensions::makeTextureHandleResident = nullptr;
+	Extensions::MakeTextureHandleNonResidentProc Extensions::makeTextureHandleNonResident = nullptr;
+	Extensions::CopyImageSubDataProc Extensions::copyImageSubData = nullptr;
+
+	void Extensions::load() {
+		Extensions::textureStorage = Extensions::isSupported(4, 2, "GL_ARB_texture_storage");
+		if (Extensions::textureStorage) {
+			Extensions::texStorage2D = (TexStorage2DProc)glfwGetProcAddress("glTexStorage2D");
+			Extensions::textureStorage = Extensions::texStorage2D != nullptr;
+		}
+
+		Extensions::textureSwizzle = Extensions::isSupported(3, 3, "GL_ARB_texture_swizzle");
+
+		Extensions::copyImage = Extensions::isSupported(4, 3, "GL_ARB_copy_image");
+		if (Extensions::copyImage) {
+			Extensions::copyImageSubData = (CopyImageSubDataProc)glfwGetProcAddress("glCopyImageSubData");
+			Extensions::copyImage = Extensions::copyImageSubData != nullptr;
+		}
+
+		// S3TC never became core, but every desktop driver ships it.
+		Extensions::textureCompressionS3TC = glfwExtensionSupported("GL_EXT_texture_compression_s3tc");
+
+		Extensions::bindlessTexture = glfwExtensionSupported("GL_ARB_bindless_texture");
+		if (Extensions::bindlessTexture) {
+			Extensions::getTextureHandle = (GetTextureHandleProc)glfwGetProcAddress("glGetTextureHandleARB");
+			Extensions::makeTextureHandleResident = (MakeTextureHandleResidentProc)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+			Extensions::makeTextureHandleNonResident = (MakeTextureHandleNonResidentProc)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+
+			Extensions::bindlessTexture = Extensions::getTextureHandle && Extensions::makeTextureHandleResident && Extensions::makeTextureHandleNonResident;
+		}
+	}
+	bool Extensions::isSupported(const int major, const int minor, const char* extension) {
+		if (GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor)) {
+			return true;
+		}
+
+		return glfwExtensionSupported(extension);
+	}
+
+	// Assets part
+
+	std::vector<std::unique_ptr<AssetArchive>> Assets::archives;
+
+	bool Assets::mount(const std::string& path) {
+		std::unique_ptr<AssetArchive> archive = std::make_unique<AssetArchive>();
+
+		if (!archive->open(path)) {
+			Logger::Log(Logger::ERROR, "TT::Assets::mount: Could not open archive \"", path, "\".");
+			return false;
+		}
+
+		Logger::Log(Logger::INFO, "TT::Assets::mount: Mounted \"", path, "\" with ", archive->getEntryCount(), " entries.");
+
+		Assets::archives.push_back(std::move(archive));
+		return true;
+	}
+	void Assets::unmountAll() {
+		Assets::archives.clear();
+	}
+
+	std::optional<std::span<const std::byte>> Assets::find(const std::string& path) {
+		for (auto archive = Assets::archives.rbegin(); archive != Assets::archives.rend(); ++archive) {
+			std::optional<std::span<const std::byte>> data = (*archive)->find(path);
+			if (data) return data;
+		}
+
+		return std::nullopt;
+	}
+	uint8_t* Assets::loadImage(const std::string& path, int* width, int* height, int* channels, const int desiredChannels) {
+		std::optional<std::span<const std::byte>> data = Assets::find(path);
+
+		if (!data) {
+			return stbi_load(path.c_str(), width, height, channels, desiredChannels);
+		}
+
+		return stbi_load_from_memory((const stbi_uc*)data->data(), (int)data->size(), width, height, channels, desiredChannels);
+	}
+	bool Assets::loadCompressed(const std::string& path, CompressedTexture& texture) {
+		std::optional<std::span<const std::byte>> data = Assets::find(path);
+
+		if (!data) {
+			return CompressedTexture::load(path, texture);
+		}
+
+		return CompressedTexture::load(*data, texture);
+	}
+
 	// Window part
 
 	WindowCreateInfo::WindowCreateInfo() {
@@ -92,6 +210,11 @@ namespace Engine {
 			exit(1);
 		}
 
+		Extensions::load();
+
+		// The render thread owns deque 0 and runs jobs while it waits.
+		Jobs::init(0);
+
 		stbi_set_flip_vertically_on_load(true);
         Logger::Log(Logger::INFO, "TT::Window::create (const WindowCreateInfo &createInfo): Successfully");
 	}
@@ -111,9 +234,32 @@ namespace Engine {
 	}
 	void Window::swapBuffers() {
 		glfwSwapBuffers(Window::handle);
+
+		// Everything allocated from frame arenas during the frame is dead
+		// from here on; the update calls below start the next frame.
+		FrameArena::reset();
+		Memory::endFrame();
+
+		IO::update();
+		Async::update();
+		ShaderHotReload::update();
+		TextureStreamer::update();
+		TextureCache::update();
+		Resources::update();
 	}
 
 	void Window::close() {
+		ShaderHotReload::disable();
+		IO::shutdown();
+		TextureStreamer::shutdown();
+		TextureTable::shutdown();
+		TextureCache::clear();
+		Resources::clear();
+		Assets::unmountAll();
+		Jobs::shutdown();
+		// Last, no thread resumes coroutines any more.
+		Async::clear();
+
 		Window::running = false;
 		Window::created = false;
 
@@ -271,6 +417,8 @@ namespace Engine {
 
 	MeshBufferInfo::MeshBufferInfo() : data(), dimensions() {}
 	MeshBufferInfo::MeshBufferInfo(const std::vector<float> &data, const int dimensions) {
+		MemoryScope scope(Memory::MESH);
+
 		this->dimensions = dimensions;
 		this->data = std::vector<float>(data);
 	}
@@ -281,7 +429,8 @@ namespace Engine {
 		glBindBuffer(GL_ARRAY_BUFFER, vboId);
 
 		glBufferData(GL_ARRAY_BUFFER, vertices.data.size() * sizeof(float), &vertices.data[0], GL_STATIC_DRAW);
-		
+		Memory::trackBuffer(vboId, vertices.data.size() * sizeof(float), Memory::MESH);
+
 		glEnableVertexAttribArray(index);
 		glVertexAttribPointer(index, vertices.dimensions, GL_FLOAT, false, 0, NULL);
 
@@ -295,6 +444,8 @@ namespace Engine {
 		this->renderMode = GL_TRIANGLES;
 	}
 	Mesh::Mesh(const MeshBufferInfo &vertices, const std::vector<MeshBufferInfo> &additional, const GLint renderMode) {
+		MemoryScope scope(Memory::MESH);
+
 		this->vaoId = 0;
 		this->vboIds = std::vector<GLuint>(additional.size() + 1);
 		
@@ -331,7 +482,10 @@ namespace Engine {
 		this->unload();
 
 		glDeleteVertexArrays(1, &this->vaoId);
-		for (GLuint i : this->vboIds) glDeleteBuffers(1, &i);
+		for (GLuint i : this->vboIds) {
+			Memory::untrackBuffer(i);
+			glDeleteBuffers(1, &i);
+		}
 
 		vboIds.clear();
 	}
@@ -340,54 +494,266 @@ namespace Engine {
 		glBindVertexArray(0);
 	}
 
+	MeshLOD::MeshLOD() {}
+	MeshLOD::MeshLOD(const std::vector<MeshLODInfo>& levels) {
+		for (const MeshLODInfo& level : levels) {
+			this->meshes.push_back(std::make_unique<Mesh>(level.vertices, level.additional, GL_TRIANGLES));
+			this->errors.push_back(level.error);
+		}
+	}
+
+	std::vector<MeshLODInfo> MeshLOD::generate(const MeshBufferInfo& vertices, const std::vector<MeshBufferInfo>& additional, const size_t maxLevels, const float ratio) {
+		std::vector<std::vector<float>> streams = { vertices.data };
+		std::vector<int> dimensions = { vertices.dimensions };
+
+		for (const MeshBufferInfo& buffer : additional) {
+			streams.push_back(buffer.data);
+			dimensions.push_back(buffer.dimensions);
+		}
+
+		const IndexedMesh mesh = MeshSimplifier::weld(streams, dimensions);
+		std::vector<MeshLODInfo> levels;
+
+		for (const LODLevel& level : MeshSimplifier::generate(mesh, maxLevels, ratio)) {
+			const std::vector<std::vector<float>> data = MeshSimplifier::unweld(mesh, level.indices);
+
+			MeshLODInfo info;
+			info.vertices = MeshBufferInfo(data[0], dimensions[0]);
+			for (size_t i = 1; i < data.size(); ++i) info.additional.push_back(MeshBufferInfo(data[i], dimensions[i]));
+			info.error = level.error;
+
+			levels.push_back(info);
+		}
+
+		return levels;
+	}
+
+	void MeshLOD::render(const size_t level) const {
+		if (this->meshes.empty()) return;
+
+		const Mesh& mesh = *this->meshes[std::min(level, this->meshes.size() - 1)];
+		mesh.load();
+		mesh.render();
+	}
+	void MeshLOD::clear() {
+		this->meshes.clear();
+		this->errors.clear();
+	}
+
+	size_t MeshLOD::getLevelCount() const {
+		return this->meshes.size();
+	}
+	const Mesh& MeshLOD::getMesh(const size_t level) const {
+		return *this->meshes[level];
+	}
+	const std::vector<float>& MeshLOD::getErrors() const {
+		return this->errors;
+	}
+
 	// Shader part
 
-	GLuint Shader::loadFromSource(const std::string &code, const GLenum type) {
+	static std::string normalizeShaderPath(const std::string& path) {
+		return std::filesystem::path(path).lexically_normal().string();
+	}
+
+	GLuint Shader::loadFromSource(const std::string &code, const GLenum type, const std::vector<std::string>& files, float& milliseconds) {
 		const char *c_strCode = code.c_str();
 
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
 		GLuint id = glCreateShader(type);
 		glShaderSource(id, 1, &c_strCode, NULL);
 		glCompileShader(id);
 
+		// Querying the status waits for the driver to finish compiling.
 		GLint success;
 		glGetShaderiv(id, GL_COMPILE_STATUS, &success);
 
+		milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
 		std::string name = "";
 		if (type == GL_VERTEX_SHADER) {
 			name = "[VERTEX]";
 		}
 		else if (type == GL_FRAGMENT_SHADER) {
-			name = "[FRAGMENT";
+			name = "[FRAGMENT]";
 		}
 		else if (type == GL_GEOMETRY_SHADER) {
 			name = "[GEOMETRY]";
 		}
 
+		if (!files.empty()) {
+			name += " \"" + files[0] + "\"";
+		}
+
 		if (!success) {
-			const size_t errorLength = 500;
+			GLint logLength = 0;
+			glGetShaderiv(id, GL_INFO_LOG_LENGTH, &logLength);
 
-			char error[errorLength];
-			glGetShaderInfoLog(id, errorLength, NULL, error);
+			std::string error(std::max(logLength, 1), '\0');
+			glGetShaderInfoLog(id, (GLsizei)error.size(), NULL, &error[0]);
+			error.resize(std::strlen(error.c_str()));
 
-			std::cerr << name << " Could not compile! Error:\n" << error << '\n';
+			Logger::Log(Logger::ERROR, "TT::Shader::loadFromSource: ", name, " Could not compile! Error:\n", Shader::mapLog(error, files));
 		}
 
 		return id;
 	}
+	bool Shader::preprocess(const std::string& path, std::vector<std::string>& files, std::string& code) {
+		MemoryScope scope(Memory::SHADER);
+		std::string source;
+
+		if (!path.empty() && path.front() == '<') {
+			auto builtin = Shader::builtins.find(path.substr(1, path.size() - 2));
+
+			if (builtin == Shader::builtins.end()) {
+				Logger::Log(Logger::ERROR, "TT::Shader::preprocess: Unknown builtin include ", path, ".");
+				return false;
+			}
+
+			source = builtin->second;
+		}
+		else if (std::optional<std::span<const std::byte>> packed = Assets::find(path)) {
+			source.assign((const char*)packed->data(), packed->size());
+		}
+		else {
+			std::ifstream file{ path };
+
+			if (!file.is_open()) {
+				Logger::Log(Logger::ERROR, "TT::Shader::preprocess: Could not open \"", path, "\".");
+				return false;
+			}
+
+			std::stringstream sstream;
+			sstream << file.rdbuf();
+			source = sstream.str();
+		}
+
+		const size_t index = files.size();
+		files.push_back(path);
+
+		const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+		std::istringstream stream(source);
+		std::string line;
+		size_t number = 0;
+
+		while (std::getline(stream, line)) {
+			number++;
+
+			const size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+				code += line;
+				code += '\n';
+				continue;
+			}
+
+			// "#include "file"" is relative to the including file,
+			// "#include <name>" refers to code registered with setBuiltin.
+			const size_t open = line.find_first_of("\"<", start + 8);
+			const size_t close = open == std::string::npos ? open : line.find(line[open] == '<' ? '>' : '"', open + 1);
+
+			if (close == std::string::npos) {
+				Logger::Log(Logger::ERROR, "TT::Shader::preprocess: Malformed #include at ", path, ":", number, ".");
+				return false;
+			}
+
+			const std::string name = line.substr(open + 1, close - open - 1);
+			const std::string include = line[open] == '<' ? "<" + name + ">" : normalizeShaderPath((directory / name).string());
+
+			// Every file is pasted once, which also breaks include cycles.
+			if (std::find(files.begin(), files.end(), include) != files.end()) {
+				code += '\n';
+				continue;
+			}
+
+			// "#line <line> <source>" numbers the following line (GLSL 3.30+),
+			// so driver logs point at the original file instead of the
+			// concatenated source.
+			code += "#line 1 " + std::to_string(files.size()) + '\n';
+
+			if (!Shader::preprocess(include, files, code)) {
+				return false;
+			}
+
+			code += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + '\n';
+		}
+
+		return true;
+	}
+	std::string Shader::mapLog(const std::string& log, const std::vector<std::string>& files) {
+		if (files.empty()) return log;
+
+		// Drivers report locations as "<source>:<line>" (Mesa, AMD, Intel)
+		// or "<source>(<line>)" (NVIDIA).
+		static const std::regex location(R"((\d{1,4})(?::(\d+)|\((\d+)\)))");
+
+		std::istringstream stream(log);
+		std::string result, line;
+
+		while (std::getline(stream, line)) {
+			std::smatch match;
+
+			if (std::regex_search(line, match, location)) {
+				const size_t source = std::stoul(match[1].str());
+
+				if (source < files.size()) {
+					const std::string number = match[2].matched ? match[2].str() : match[3].str();
+					line = match.prefix().str() + files[source] + ":" + number + match.suffix().str();
+				}
+			}
+
+			result += line;
+			result += '\n';
+		}
+
+		return result;
+	}
+	std::unordered_map<std::string, std::string> Shader::builtins = {};
+
+	void Shader::setBuiltin(const std::string& name, const std::string& code) {
+		MemoryScope scope(Memory::SHADER);
+		Shader::builtins[name] = code;
+	}
+
 	Shader Shader::loadFromFile(const std::string& path, const GLenum type) {
-		std::ifstream stream{ path };
-		std::stringstream sstream;
+		MemoryScope scope(Memory::SHADER);
+
+		std::vector<std::string> files;
+		std::string code;
 
-		if (stream.is_open()) {
-			sstream << stream.rdbuf();
-			stream.close();
+		// Partial source would only make the compiler report errors in the
+		// wrong place. The files are kept, so hot reload still watches them.
+		if (!Shader::preprocess(normalizeShaderPath(path), files, code)) {
+			Logger::Log(Logger::ERROR, "TT::Shader::loadFromFile: Could not assemble \"", path, "\".");
+
+			Shader shader(type, files);
+			shader.path = path;
+
+			return shader;
 		}
 
-		return Shader(sstream.str(), type);
+		Shader shader(code, type, files);
+		shader.path = path;
+
+		return shader;
 	}
 	
-	Shader::Shader(const std::string& code, const GLenum type) {
-		this->id = Shader::loadFromSource(code, type);
+	Shader::Shader(const std::string& code, const GLenum type) : Shader(code, type, {}) {}
+	Shader::Shader(const GLenum type, const std::vector<std::string>& files) {
+		this->id = 0;
+		this->type = type;
+		this->path = "";
+		this->files = files;
+		this->compileMilliseconds = 0.0f;
+	}
+	Shader::Shader(const std::string& code, const GLenum type, const std::vector<std::string>& files) {
+		MemoryScope scope(Memory::SHADER);
+
+		this->id = Shader::loadFromSource(code, type, files, this->compileMilliseconds);
+		this->type = type;
+		this->path = "";
+		this->files = files;
 	}
 
 	void Shader::clear() {
@@ -396,43 +762,107 @@ namespace Engine {
 	GLuint Shader::getId() const {
 		return this->id;
 	}
+	GLenum Shader::getType() const {
+		return this->type;
+	}
+	const std::string& Shader::getPath() const {
+		return this->path;
+	}
+	const std::vector<std::string>& Shader::getFiles() const {
+		return this->files;
+	}
+
+	bool Shader::isCompiled() const {
+		if (!this->id) return false;
+
+		GLint success;
+		glGetShaderiv(this->id, GL_COMPILE_STATUS, &success);
+
+		return success;
+	}
+	float Shader::getCompileMilliseconds() const {
+		return this->compileMilliseconds;
+	}
+
+	std::vector<ShaderProgramStatistics> ShaderProgram::statistics = {};
 
 	ShaderProgram::ShaderProgram() {
 		this->id = glCreateProgram();
 	}
 	ShaderProgram::~ShaderProgram() {
+		ShaderHotReload::untrack(this);
+
 		this->unload();
 		this->clear();
 	}
 
-	void ShaderProgram::logProgramError(const GLuint id) {
-		const size_t errorLength = 500;
+	void ShaderProgram::logProgramError(const GLuint id, const std::string& message) {
+		GLint logLength = 0;
+		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &logLength);
 
-		char error[errorLength];
-		glGetProgramInfoLog(id, errorLength, NULL, error);
+		std::string error(std::max(logLength, 1), '\0');
+		glGetProgramInfoLog(id, (GLsizei)error.size(), NULL, &error[0]);
+		error.resize(std::strlen(error.c_str()));
 
-		std::cerr << "Could not compile program. Error:\n" << error;
+		Logger::Log(Logger::ERROR, "TT::ShaderProgram::logProgramError: ", message, " Error:\n", error);
 	}
 
 	void ShaderProgram::bind(const Shader shader) {
-		glAttachShader(this->id, shader.getId());
+		MemoryScope scope(Memory::SHADER);
+
+		// An invalid shader is kept, so the link fails and hot reload can
+		// rebuild the program once its files are fixed.
+		if (shader.getId()) glAttachShader(this->id, shader.getId());
 		this->shaders.emplace_back(shader);
 	}
 	void ShaderProgram::compile() {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
 		glLinkProgram(this->id);
 		
 		GLint success;
 		glGetProgramiv(this->id, GL_LINK_STATUS, &success);
 
+		ShaderProgramStatistics statistics;
+		statistics.linkMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		statistics.compileMilliseconds = 0.0f;
+
+		for (const Shader& shader : this->shaders) {
+			if (!statistics.name.empty()) statistics.name += " + ";
+			statistics.name += shader.getPath().empty() ? "<source>" : shader.getPath();
+
+			statistics.compileMilliseconds += shader.getCompileMilliseconds();
+		}
+		ShaderProgram::statistics.push_back(statistics);
+
 		if (!success) {
-			ShaderProgram::logProgramError(this->id);
+			ShaderProgram::logProgramError(this->id, "Could not link program \"" + statistics.name + "\".");
 		}
 
 		glValidateProgram(this->id);
 		glGetProgramiv(this->id, GL_VALIDATE_STATUS, &success);
 
 		if (!success) {
-			ShaderProgram::logProgramError(this->id);
+			ShaderProgram::logProgramError(this->id, "Program \"" + statistics.name + "\" did not validate.");
+		}
+
+		ShaderHotReload::track(this);
+	}
+
+	void ShaderProgram::replace(const GLuint id, const std::vector<Shader>& shaders) {
+		GLint current;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+
+		const bool loaded = (GLuint)current == this->id;
+
+		this->clear();
+		this->id = id;
+		this->shaders = shaders;
+
+		// Uniform values live in the program object, so callers that set
+		// them once must set them again; per-frame setters just keep working.
+		if (loaded) {
+			glUseProgram(this->id);
 		}
 	}
 
@@ -440,8 +870,10 @@ namespace Engine {
 		glUseProgram(this->id);
 	}
 	void ShaderProgram::clear() {
+		TextureTable::detach(this->id);
+
 		for (Shader& shader : this->shaders) {
-			glDetachShader(this->id, shader.getId());
+			if (shader.getId()) glDetachShader(this->id, shader.getId());
 			shader.clear();
 		}
 
@@ -453,6 +885,42 @@ namespace Engine {
 		glUseProgram(0);
 	}
 
+	GLuint ShaderProgram::getId() const {
+		return this->id;
+	}
+
+	bool ShaderProgram::isLinked() const {
+		GLint success;
+		glGetProgramiv(this->id, GL_LINK_STATUS, &success);
+
+		return success;
+	}
+
+	const std::vector<ShaderProgramStatistics>& ShaderProgram::getStatistics() {
+		return ShaderProgram::statistics;
+	}
+	void ShaderProgram::logStatistics() {
+		std::vector<ShaderProgramStatistics> sorted = ShaderProgram::statistics;
+		std::sort(sorted.begin(), sorted.end(), [](const ShaderProgramStatistics& a, const ShaderProgramStatistics& b) {
+			return a.compileMilliseconds + a.linkMilliseconds > b.compileMilliseconds + b.linkMilliseconds;
+		});
+
+		float total = 0.0f;
+		for (const ShaderProgramStatistics& program : sorted) {
+			total += program.compileMilliseconds + program.linkMilliseconds;
+		}
+
+		std::ostringstream message;
+		message << std::fixed << std::setprecision(2);
+		message << "TT::ShaderProgram::logStatistics: " << sorted.size() << " programs built in " << total << " ms (slowest first)";
+
+		for (const ShaderProgramStatistics& program : sorted) {
+			message << "\n\t" << program.compileMilliseconds << " ms compile, " << program.linkMilliseconds << " ms link: " << program.name;
+		}
+
+		Logger::Log(Logger::INFO, message.str());
+	}
+
 	void ShaderProgram::setBoolean(const char* name, const bool value) const {
 		glUniform1i(glGetUniformLocation(this->id, name), value);
 	}
@@ -481,51 +949,1724 @@ namespace Engine {
 		glUniformMatrix4fv(glGetUniformLocation(this->id, name), 1, false, &value[0][0]);
 	}
 
-	// Texture part
+	// Shader hot reload part
 
-	GLuint Texture::loadFromFile(const std::string& path, GLint filter) {
-		int width, height, channels;
-		uint8_t* image = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	GLFWwindow* ShaderHotReload::context = nullptr;
+	std::thread ShaderHotReload::watcher;
+	std::atomic<bool> ShaderHotReload::enabled = false;
 
+	std::mutex ShaderHotReload::mutex;
+	std::vector<ShaderProgram*> ShaderHotReload::programs = {};
+	std::vector<ShaderHotReload::Result> ShaderHotReload::results = {};
 
-		switch (channels) {
-		case 3:
-			channels = GL_RGB;
-			break;
-		case 4:
-			channels = GL_RGBA;
-			break;
-		default:
-			std::cerr << '\"' << path << '\"' << " Channels format isn't supported.\n";
-			return 0;
+	int ShaderHotReload::inotifyId = -1;
+	std::unordered_map<int, std::string> ShaderHotReload::directories = {};
+
+	void ShaderHotReload::enable() {
+		if (ShaderHotReload::enabled) {
+			Logger::Log(Logger::WARNING, "TT::ShaderHotReload::enable: Hot reload already enabled!");
+			return;
+		}
+#ifdef __linux__
+		if (!Window::getHandle()) {
+			Logger::Log(Logger::ERROR, "TT::ShaderHotReload::enable: Window must be created first.");
+			return;
 		}
 
-		GLuint textureId;
-		glGenTextures(1, &textureId);
-		glBindTexture(GL_TEXTURE_2D, textureId);
+		ShaderHotReload::inotifyId = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (ShaderHotReload::inotifyId < 0) {
+			Logger::Log(Logger::ERROR, "TT::ShaderHotReload::enable: Could not initialize inotify.");
+			return;
+		}
+
+		// Programs are rebuilt on a hidden context that shares objects with
+		// the window, so compiling never stalls the render thread.
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		ShaderHotReload::context = glfwCreateWindow(1, 1, "", NULL, Window::getHandle());
+		glfwDefaultWindowHints();
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		if (!ShaderHotReload::context) {
+			close(ShaderHotReload::inotifyId);
+			ShaderHotReload::inotifyId = -1;
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			Logger::Log(Logger::ERROR, "TT::ShaderHotReload::enable: Shared context not created.");
+			return;
+		}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, channels, width, height, 0, channels, GL_UNSIGNED_BYTE, image);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		{
+			std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
 
-		return textureId;
+			for (ShaderProgram* program : ShaderHotReload::programs) {
+				for (const Shader& shader : program->shaders) {
+					for (const std::string& file : shader.files) ShaderHotReload::watchDirectory(file);
+				}
+			}
+		}
+
+		ShaderHotReload::enabled = true;
+		ShaderHotReload::watcher = std::thread(ShaderHotReload::watch);
+
+		Logger::Log(Logger::INFO, "TT::ShaderHotReload::enable: Watching shader sources.");
+#else
+		Logger::Log(Logger::WARNING, "TT::ShaderHotReload::enable: Hot reload needs inotify and is only available on Linux.");
+#endif
 	}
+	void ShaderHotReload::disable() {
+		if (!ShaderHotReload::enabled) return;
 
-	void Texture::bind(const GLuint texture, const uint8_t bank) {
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glActiveTexture(GL_TEXTURE0 + bank);
+		ShaderHotReload::enabled = false;
+		ShaderHotReload::watcher.join();
+
+#ifdef __linux__
+		close(ShaderHotReload::inotifyId);
+#endif
+		ShaderHotReload::inotifyId = -1;
+
+		glfwDestroyWindow(ShaderHotReload::context);
+		ShaderHotReload::context = nullptr;
+
+		std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+		for (Result& result : ShaderHotReload::results) {
+			for (Shader& shader : result.shaders) shader.clear();
+			glDeleteProgram(result.id);
+		}
+
+		ShaderHotReload::results.clear();
+		ShaderHotReload::directories.clear();
+
+		Logger::Log(Logger::INFO, "TT::ShaderHotReload::disable: Stopped watching shader sources.");
 	}
-	void Texture::unbind() {
-		glBindTexture(GL_TEXTURE_2D, 0);
+	bool ShaderHotReload::isEnabled() {
+		return ShaderHotReload::enabled;
 	}
-	void Texture::clear(GLuint texture) {
-		Texture::unbind();
-		glDeleteTextures(1, &texture);
+
+	void ShaderHotReload::track(ShaderProgram* program) {
+		// Programs built from in-memory code have nothing to watch.
+		for (const Shader& shader : program->shaders) {
+			if (shader.path.empty()) return;
+		}
+
+		std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+
+		if (std::find(ShaderHotReload::programs.begin(), ShaderHotReload::programs.end(), program) != ShaderHotReload::programs.end()) {
+			return;
+		}
+		ShaderHotReload::programs.push_back(program);
+
+		if (ShaderHotReload::enabled) {
+			for (const Shader& shader : program->shaders) {
+				for (const std::string& file : shader.files) ShaderHotReload::watchDirectory(file);
+			}
+		}
+	}
+	void ShaderHotReload::untrack(ShaderProgram* program) {
+		std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+
+		std::vector<ShaderProgram*>& programs = ShaderHotReload::programs;
+		programs.erase(std::remove(programs.begin(), programs.end(), program), programs.end());
+	}
+
+	void ShaderHotReload::update() {
+		std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+
+		for (Result& result : ShaderHotReload::results) {
+			std::vector<ShaderProgram*>& programs = ShaderHotReload::programs;
+
+			if (std::find(programs.begin(), programs.end(), result.program) == programs.end()) {
+				for (Shader& shader : result.shaders) shader.clear();
+				glDeleteProgram(result.id);
+				continue;
+			}
+
+			result.program->replace(result.id, result.shaders);
+			Logger::Log(Logger::INFO, "TT::ShaderHotReload::update: Reloaded program from \"", result.shaders[0].path, "\".");
+		}
+
+		ShaderHotReload::results.clear();
+	}
+
+	void ShaderHotReload::watchDirectory(const std::string& path) {
+#ifdef __linux__
+		if (!path.empty() && path.front() == '<') return;
+
+		std::string directory = std::filesystem::path(path).parent_path().string();
+		if (directory.empty()) directory = ".";
+
+		for (const auto& [id, watched] : ShaderHotReload::directories) {
+			if (watched == directory) return;
+		}
+
+		// Editors often save through a temporary file and a rename, so the
+		// directory is watched rather than the file itself.
+		int id = inotify_add_watch(ShaderHotReload::inotifyId, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (id < 0) {
+			Logger::Log(Logger::WARNING, "TT::ShaderHotReload::watchDirectory: Could not watch \"", directory, "\".");
+			return;
+		}
+
+		ShaderHotReload::directories[id] = directory;
+#endif
+	}
+
+	void ShaderHotReload::watch() {
+#ifdef __linux__
+		glfwMakeContextCurrent(ShaderHotReload::context);
+
+		alignas(inotify_event) char buffer[4096];
+		pollfd descriptor = { ShaderHotReload::inotifyId, POLLIN, 0 };
+
+		while (ShaderHotReload::enabled) {
+			if (poll(&descriptor, 1, 100) <= 0) continue;
+
+			// A single save produces a burst of events; let it settle.
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			std::vector<std::string> changed;
+			ssize_t length;
+
+			while ((length = read(ShaderHotReload::inotifyId, buffer, sizeof(buffer))) > 0) {
+				for (char* pointer = buffer; pointer < buffer + length;) {
+					const inotify_event* event = (const inotify_event*)pointer;
+					pointer += sizeof(inotify_event) + event->len;
+
+					if (event->len == 0) continue;
+
+					std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+
+					auto directory = ShaderHotReload::directories.find(event->wd);
+					if (directory != ShaderHotReload::directories.end()) {
+						changed.push_back(normalizeShaderPath(directory->second + "/" + event->name));
+					}
+				}
+			}
+
+			if (!changed.empty()) {
+				ShaderHotReload::rebuild(changed);
+			}
+		}
+
+		glfwMakeContextCurrent(NULL);
+#endif
+	}
+
+	void ShaderHotReload::rebuild(const std::vector<std::string>& changed) {
+		std::vector<std::pair<ShaderProgram*, std::vector<Shader>>> affected;
+
+		{
+			std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+
+			for (ShaderProgram* program : ShaderHotReload::programs) {
+				bool dirty = false;
+				for (const Shader& shader : program->shaders) {
+					for (const std::string& file : shader.files) {
+						dirty = dirty || std::find(changed.begin(), changed.end(), file) != changed.end();
+					}
+				}
+
+				if (dirty) {
+					affected.emplace_back(program, program->shaders);
+				}
+			}
+		}
+
+		for (const auto& [program, sources] : affected) {
+			GLuint id = glCreateProgram();
+			std::vector<Shader> shaders;
+
+			bool success = true;
+			for (const Shader& source : sources) {
+				shaders.push_back(Shader::loadFromFile(source.path, source.type));
+				if (shaders.back().id) glAttachShader(id, shaders.back().id);
+
+				success = success && shaders.back().isCompiled();
+			}
+
+			if (success) {
+				glLinkProgram(id);
+
+				GLint linked;
+				glGetProgramiv(id, GL_LINK_STATUS, &linked);
+
+				if (!linked) {
+					ShaderProgram::logProgramError(id, "Could not link reloaded program.");
+					success = false;
+				}
+			}
+
+			if (!success) {
+				for (Shader& shader : shaders) shader.clear();
+				glDeleteProgram(id);
+
+				Logger::Log(Logger::WARNING, "TT::ShaderHotReload::rebuild: Rebuild of \"", sources[0].path, "\" failed, keeping previous program.");
+				continue;
+			}
+
+			// The window context may only use the objects once they are complete.
+			glFinish();
+
+			std::lock_guard<std::mutex> lock(ShaderHotReload::mutex);
+			ShaderHotReload::results.push_back({ program, id, shaders });
+		}
+	}
+
+	// Texture part
+
+	TextureCreateInfo::TextureCreateInfo() {
+		this->filter = GL_LINEAR;
+
+		this->srgb = false;
+		this->mipmaps = true;
+		this->premultiplyAlpha = false;
+		this->linearize = false;
+
+		for (uint8_t c = 0; c < 4; ++c) this->swizzle[c] = c;
+	}
+	TextureCreateInfo::TextureCreateInfo(const GLint filter) : TextureCreateInfo() {
+		this->filter = filter;
+	}
+
+	void Texture::setParameters(const GLenum target, const GLint filter, const GLsizei levels) {
+		GLint minFilter = filter;
+		if (levels > 1 && minFilter == GL_NEAREST) minFilter = GL_NEAREST_MIPMAP_NEAREST;
+		if (levels > 1 && minFilter == GL_LINEAR) minFilter = GL_LINEAR_MIPMAP_LINEAR;
+
+		const GLint magFilter = (filter == GL_NEAREST || filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_NEAREST_MIPMAP_LINEAR) ? GL_NEAREST : GL_LINEAR;
+
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
+
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+
+	static bool isSwizzled(const TextureCreateInfo& createInfo) {
+		return createInfo.swizzle[0] != 0 || createInfo.swizzle[1] != 1 || createInfo.swizzle[2] != 2 || createInfo.swizzle[3] != 3;
+	}
+
+	int Texture::getDecodeChannels(const TextureCreateInfo& createInfo) {
+		return isSwizzled(createInfo) || (createInfo.linearize && !createInfo.srgb) ? 4 : 0;
+	}
+	void Texture::process(uint8_t* pixels, const int width, const int height, const int channels, const TextureCreateInfo& createInfo) {
+		if (channels != 4) {
+			if (Texture::getDecodeChannels(createInfo)) {
+				Logger::Log(Logger::WARNING, "TT::Texture::process: Swizzle and linearize need 4 channels, got ", channels, "; ignoring them.");
+			}
+			return;
+		}
+
+		const size_t pixelCount = (size_t)width * height;
+
+		if (isSwizzled(createInfo)) {
+			ImageProcessing::swizzle(pixels, pixelCount, createInfo.swizzle);
+		}
+		if (createInfo.linearize && !createInfo.srgb) {
+			ImageProcessing::srgbToLinear(pixels, pixelCount);
+		}
+		// Last, so alpha scales the colors the texture ends up with.
+		if (createInfo.premultiplyAlpha) {
+			ImageProcessing::premultiplyAlpha(pixels, pixelCount);
+		}
+	}
+
+	GLuint Texture::create(const int width, const int height, const int channels, const void* pixels, const TextureCreateInfo& createInfo) {
+		GLenum format, internalFormat;
+
+		switch (channels) {
+		case 1:
+			format = GL_RED;
+			internalFormat = GL_R8;
+			break;
+		case 2:
+			format = GL_RG;
+			internalFormat = GL_RG8;
+			break;
+		case 3:
+			format = GL_RGB;
+			internalFormat = createInfo.srgb ? GL_SRGB8 : GL_RGB8;
+			break;
+		case 4:
+			format = GL_RGBA;
+			internalFormat = createInfo.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+			break;
+		default:
+			Logger::Log(Logger::ERROR, "TT::Texture::create: ", channels, " channels format isn't supported.");
+			return 0;
+		}
+
+		GLsizei levels = 1;
+		if (createInfo.mipmaps) {
+			for (int size = std::max(width, height); size > 1; size /= 2) levels++;
+		}
+
+		GLuint textureId;
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+
+		Texture::setParameters(GL_TEXTURE_2D, createInfo.filter, levels);
+
+		// Grey and grey-alpha images are stored as R8/RG8, read them back as such.
+		if (channels <= 2 && Extensions::textureSwizzle) {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, channels == 2 ? GL_GREEN : GL_ONE);
+		}
+
+		// With an unpack buffer bound, pixels is an offset into it and may be null.
+		GLint unpackBuffer = 0;
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+
+		const bool upload = pixels || unpackBuffer;
+
+		// Rows of 1, 2 and 3 channel images are not 4 byte aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		if (Extensions::textureStorage) {
+			Extensions::texStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+
+			if (upload) {
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels);
+			}
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (levels > 1 && upload) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Estimated like TextureCache does.
+		size_t bytes = (size_t)width * height * (channels == 3 ? 4 : (size_t)channels);
+		if (levels > 1) bytes += bytes / 3;
+		Memory::trackTexture(textureId, bytes, Memory::TEXTURE);
+
+		return textureId;
+	}
+	GLuint Texture::loadFromFile(const std::string& path, const TextureCreateInfo& createInfo) {
+		if (std::filesystem::path(path).extension() == ".ctex") {
+			return Texture::loadCompressed(path, createInfo.filter);
+		}
+
+		const int decodeChannels = Texture::getDecodeChannels(createInfo);
+
+		int width, height, channels;
+		uint8_t* image = Assets::loadImage(path, &width, &height, &channels, decodeChannels);
+
+		if (!image) {
+			Logger::Log(Logger::ERROR, "TT::Texture::loadFromFile: Could not load \"", path, "\": ", stbi_failure_reason());
+			return 0;
+		}
+		if (decodeChannels) channels = decodeChannels;
+
+		Texture::process(image, width, height, channels, createInfo);
+
+		GLuint textureId = Texture::create(width, height, channels, image, createInfo);
+		stbi_image_free(image);
+
+		return textureId;
+	}
+	GLuint Texture::loadFromFile(const std::string& path, const GLint filter) {
+		return Texture::loadFromFile(path, TextureCreateInfo(filter));
+	}
+	std::vector<GLuint> Texture::loadFromFiles(const std::vector<std::string>& paths, const TextureCreateInfo& createInfo) {
+		std::vector<GLuint> textures(paths.size(), 0);
+
+		std::vector<std::string> imagePaths;
+		std::vector<size_t> imageIndices;
+
+		for (size_t i = 0; i < paths.size(); ++i) {
+			if (std::filesystem::path(paths[i]).extension() == ".ctex") {
+				textures[i] = Texture::loadCompressed(paths[i], createInfo.filter);
+				continue;
+			}
+
+			imagePaths.push_back(paths[i]);
+			imageIndices.push_back(i);
+		}
+
+		std::vector<DecodedImage> images = ImageBatch::load(imagePaths, Texture::getDecodeChannels(createInfo), createInfo);
+
+		// Uploads stay on this thread, it owns the GL context.
+		for (size_t i = 0; i < images.size(); ++i) {
+			if (!images[i].pixels) continue;
+
+			textures[imageIndices[i]] = Texture::create(images[i].width, images[i].height, images[i].channels, images[i].pixels, createInfo);
+		}
+
+		ImageBatch::free(images);
+		return textures;
+	}
+	GLuint Texture::loadCompressed(const std::string& path, const GLint filter) {
+		CompressedTexture texture;
+
+		if (!Assets::loadCompressed(path, texture)) {
+			Logger::Log(Logger::ERROR, "TT::Texture::loadCompressed: Could not load \"", path, "\".");
+			return 0;
+		}
+
+		return Texture::loadCompressed(texture, filter, 0);
+	}
+	Task<GLuint> Texture::loadAsync(std::string path, TextureCreateInfo createInfo) {
+		std::vector<std::byte> file;
+		std::span<const std::byte> data;
+
+		if (std::optional<std::span<const std::byte>> packed = Assets::find(path)) {
+			data = *packed;
+		}
+		else {
+			IO::Result result = co_await Async::read(path, IO::NORMAL);
+
+			if (result.error) {
+				Logger::Log(Logger::ERROR, "TT::Texture::loadAsync: Could not read \"", path, "\": ", std::strerror(result.error));
+				co_return 0;
+			}
+
+			file = std::move(result.data);
+			data = file;
+		}
+
+		const bool compressed = std::filesystem::path(path).extension() == ".ctex";
+
+		co_await Async::resumeOnJobs();
+
+		if (compressed) {
+			CompressedTexture texture;
+			const bool loaded = CompressedTexture::load(data, texture);
+
+			co_await Async::resumeOnFrame();
+
+			if (!loaded) {
+				Logger::Log(Logger::ERROR, "TT::Texture::loadAsync: Could not load \"", path, "\".");
+				co_return 0;
+			}
+
+			co_return Texture::loadCompressed(texture, createInfo.filter, 0);
+		}
+
+		const int decodeChannels = Texture::getDecodeChannels(createInfo);
+
+		int width, height, channels;
+		uint8_t* image = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data.data()), static_cast<int>(data.size()), &width, &height, &channels, decodeChannels);
+		if (image && decodeChannels) channels = decodeChannels;
+
+		// stb keeps the failure reason per thread, so take it before leaving.
+		const std::string reason = image ? "" : stbi_failure_reason();
+		if (image) Texture::process(image, width, height, channels, createInfo);
+
+		co_await Async::resumeOnFrame();
+
+		if (!image) {
+			Logger::Log(Logger::ERROR, "TT::Texture::loadAsync: Could not load \"", path, "\": ", reason);
+			co_return 0;
+		}
+
+		GLuint textureId = Texture::create(width, height, channels, image, createInfo);
+		stbi_image_free(image);
+
+		co_return textureId;
+	}
+	GLuint Texture::loadCompressed(const CompressedTexture& texture, const GLint filter, const uint32_t firstLevel) {
+		GLenum internalFormat;
+
+		switch (texture.format) {
+		case CompressedTexture::BC1:
+			internalFormat = texture.srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			break;
+		case CompressedTexture::BC3:
+			internalFormat = texture.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			break;
+		case CompressedTexture::BC4:
+			internalFormat = GL_COMPRESSED_RED_RGTC1;
+			break;
+		case CompressedTexture::BC5:
+			internalFormat = GL_COMPRESSED_RG_RGTC2;
+			break;
+		default:
+			Logger::Log(Logger::ERROR, "TT::Texture::loadCompressed: Unknown compressed format.");
+			return 0;
+		}
+
+		if ((texture.format == CompressedTexture::BC1 || texture.format == CompressedTexture::BC3) && !Extensions::textureCompressionS3TC) {
+			Logger::Log(Logger::ERROR, "TT::Texture::loadCompressed: S3TC isn't supported by the driver.");
+			return 0;
+		}
+
+		if (texture.levels.empty()) {
+			Logger::Log(Logger::ERROR, "TT::Texture::loadCompressed: Texture has no levels.");
+			return 0;
+		}
+
+		// Leaving out the largest levels is how the texture cache sheds memory.
+		const size_t first = std::min<size_t>(firstLevel, texture.levels.size() - 1);
+
+		GLuint textureId;
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+
+		Texture::setParameters(GL_TEXTURE_2D, filter, (GLsizei)(texture.levels.size() - first));
+
+		size_t bytes = 0;
+		for (size_t i = first; i < texture.levels.size(); ++i) {
+			const CompressedTextureLevel& level = texture.levels[i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)(i - first), internalFormat, level.width, level.height, 0, (GLsizei)level.size, &texture.data[level.offset]);
+
+			bytes += (size_t)level.size;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		Memory::trackTexture(textureId, bytes, Memory::TEXTURE);
+
+		return textureId;
+	}
+
+	void Texture::bind(const GLuint texture, const uint8_t bank) {
+		glActiveTexture(GL_TEXTURE0 + bank);
+		glBindTexture(GL_TEXTURE_2D, texture);
+	}
+	void Texture::unbind() {
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	void Texture::clear(GLuint texture) {
+		TextureTable::remove(texture);
+		Texture::unbind();
+		Memory::untrackTexture(texture);
+		glDeleteTextures(1, &texture);
+	}
+
+	// Image batch part
+
+	bool ImageBatch::decode(DecodedImage& image, const int desiredChannels) {
+		int channels;
+
+		// Archive entries are already mapped.
+		if (std::optional<std::span<const std::byte>> packed = Assets::find(image.path)) {
+			image.pixels = stbi_load_from_memory((const stbi_uc*)packed->data(), (int)packed->size(), &image.width, &image.height, &channels, desiredChannels);
+			image.channels = desiredChannels ? desiredChannels : channels;
+			return image.pixels != nullptr;
+		}
+
+#ifdef __linux__
+		const int file = open(image.path.c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size <= 0 || info.st_size > INT32_MAX) {
+			close(file);
+			return false;
+		}
+
+		const size_t size = (size_t)info.st_size;
+		void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file);
+
+		if (data == MAP_FAILED) return false;
+		madvise(data, size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+		image.pixels = stbi_load_from_memory((const stbi_uc*)data, (int)size, &image.width, &image.height, &channels, desiredChannels);
+		munmap(data, size);
+#else
+		std::ifstream stream(image.path, std::ios::binary | std::ios::ate);
+		if (!stream.is_open()) return false;
+
+		const std::streamsize size = stream.tellg();
+		if (size <= 0 || size > INT32_MAX) return false;
+
+		std::vector<stbi_uc> data((size_t)size);
+		stream.seekg(0);
+		if (!stream.read((char*)data.data(), size)) return false;
+
+		image.pixels = stbi_load_from_memory(data.data(), (int)size, &image.width, &image.height, &channels, desiredChannels);
+#endif
+
+		image.channels = desiredChannels ? desiredChannels : channels;
+		return image.pixels != nullptr;
+	}
+
+	std::vector<DecodedImage> ImageBatch::load(const std::vector<std::string>& paths, const int desiredChannels, const TextureCreateInfo& createInfo) {
+		std::vector<DecodedImage> images(paths.size());
+		for (size_t i = 0; i < paths.size(); ++i) {
+			images[i] = { paths[i], 0, 0, 0, nullptr };
+		}
+
+		// One image per job, so one large file does not hold up a slice of
+		// the list; the calling thread decodes while it waits.
+		Jobs::parallelForEach(0, images.size(), 1, [&images, desiredChannels, &createInfo](size_t i) {
+			DecodedImage& image = images[i];
+
+			if (!ImageBatch::decode(image, desiredChannels)) {
+				const char* reason = stbi_failure_reason();
+				Logger::Log(Logger::WARNING, "TT::ImageBatch::load: Could not load \"", image.path, "\"", reason ? ": " : "", reason ? reason : ".");
+				return;
+			}
+
+			Texture::process(image.pixels, image.width, image.height, image.channels, createInfo);
+		});
+
+		return images;
+	}
+	void ImageBatch::free(std::vector<DecodedImage>& images) {
+		for (DecodedImage& image : images) {
+			if (image.pixels) stbi_image_free(image.pixels);
+			image.pixels = nullptr;
+		}
+	}
+
+	// Texture atlas part
+
+	TextureAtlas::TextureAtlas() {
+		this->id = 0;
+		this->width = 0;
+		this->height = 0;
+	}
+
+	TextureAtlas TextureAtlas::build(const std::vector<std::string>& paths, const int maxSize, const int padding, const TextureCreateInfo& createInfo) {
+		struct Image {
+			const std::string* path;
+			int width, height;
+			uint8_t* pixels;
+			SkylinePacker::Rect rect;
+		};
+
+		std::vector<Image> images;
+		long long area = 0;
+
+		std::vector<DecodedImage> decoded = ImageBatch::load(paths, 4, createInfo);
+
+		for (size_t i = 0; i < paths.size(); ++i) {
+			Image image = { &paths[i], decoded[i].width, decoded[i].height, decoded[i].pixels, {} };
+
+			if (!image.pixels) {
+				Logger::Log(Logger::WARNING, "TT::TextureAtlas::build: Could not load \"", paths[i], "\", skipping.");
+				continue;
+			}
+
+			area += (long long)(image.width + padding * 2) * (image.height + padding * 2);
+			images.push_back(image);
+		}
+
+		// Tall images first keeps the skyline flat.
+		std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) {
+			return a.height != b.height ? a.height > b.height : a.width > b.width;
+		});
+
+		TextureAtlas atlas;
+		bool packed = false;
+
+		for (int size = 64; size <= maxSize && !packed; size *= 2) {
+			if ((long long)size * size < area) continue;
+
+			SkylinePacker packer(size, size);
+			packed = true;
+
+			for (Image& image : images) {
+				if (!packer.insert(image.width + padding * 2, image.height + padding * 2, image.rect)) {
+					packed = false;
+					break;
+				}
+			}
+
+			atlas.width = size;
+			atlas.height = size;
+		}
+
+		if (!packed) {
+			Logger::Log(Logger::ERROR, "TT::TextureAtlas::build: Images don't fit into ", maxSize, "x", maxSize, ".");
+
+			for (Image& image : images) stbi_image_free(image.pixels);
+			return TextureAtlas();
+		}
+
+		std::vector<uint8_t> pixels((size_t)atlas.width * atlas.height * 4, 0);
+
+		for (Image& image : images) {
+			// The padding repeats the image's edge texels, so filtering and
+			// mipmaps don't bleed neighbouring images in.
+			for (int y = 0; y < image.rect.height; ++y) {
+				const int sourceY = std::clamp(y - padding, 0, image.height - 1);
+
+				for (int x = 0; x < image.rect.width; ++x) {
+					const int sourceX = std::clamp(x - padding, 0, image.width - 1);
+
+					std::memcpy(&pixels[((size_t)(image.rect.y + y) * atlas.width + image.rect.x + x) * 4], &image.pixels[((size_t)sourceY * image.width + sourceX) * 4], 4);
+				}
+			}
+
+			TextureAtlasRegion region;
+			region.min = glm::vec2((float)(image.rect.x + padding) / atlas.width, (float)(image.rect.y + padding) / atlas.height);
+			region.max = region.min + glm::vec2((float)image.width / atlas.width, (float)image.height / atlas.height);
+
+			atlas.regions[*image.path] = region;
+			stbi_image_free(image.pixels);
+		}
+
+		atlas.id = Texture::create(atlas.width, atlas.height, 4, pixels.data(), createInfo);
+
+		Logger::Log(Logger::INFO, "TT::TextureAtlas::build: Packed ", images.size(), " images into ", atlas.width, "x", atlas.height, ".");
+		return atlas;
+	}
+
+	bool TextureAtlas::getRegion(const std::string& path, TextureAtlasRegion& region) const {
+		auto found = this->regions.find(path);
+		if (found == this->regions.end()) return false;
+
+		region = found->second;
+		return true;
+	}
+
+	void TextureAtlas::bind(const uint8_t bank) const {
+		Texture::bind(this->id, bank);
+	}
+	void TextureAtlas::clear() {
+		Texture::clear(this->id);
+
+		this->id = 0;
+		this->regions.clear();
+	}
+
+	GLuint TextureAtlas::getId() const {
+		return this->id;
+	}
+	glm::ivec2 TextureAtlas::getSize() const {
+		return glm::ivec2(this->width, this->height);
+	}
+
+	// Texture array part
+
+	TextureArray::TextureArray() {
+		this->id = 0;
+		this->width = 0;
+		this->height = 0;
+
+		this->layerCount = 0;
+		this->capacity = 0;
+		this->mipmaps = false;
+	}
+	TextureArray::TextureArray(const int width, const int height, const uint32_t capacity, const TextureCreateInfo& createInfo) {
+		this->width = width;
+		this->height = height;
+
+		this->layerCount = 0;
+		this->capacity = capacity;
+		this->mipmaps = createInfo.mipmaps;
+
+		GLsizei levels = 1;
+		if (createInfo.mipmaps) {
+			for (int size = std::max(width, height); size > 1; size /= 2) levels++;
+		}
+
+		const GLenum internalFormat = createInfo.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+		glGenTextures(1, &this->id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+
+		Texture::setParameters(GL_TEXTURE_2D_ARRAY, createInfo.filter, levels);
+
+		size_t bytes = 0;
+		for (GLsizei level = 0; level < levels; ++level) {
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, std::max(width >> level, 1), std::max(height >> level, 1), capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+			bytes += (size_t)std::max(width >> level, 1) * std::max(height >> level, 1) * capacity * 4;
+		}
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		Memory::trackTexture(this->id, bytes, Memory::TEXTURE);
+	}
+
+	uint32_t TextureArray::add(const uint8_t* rgba) {
+		if (this->layerCount >= this->capacity) {
+			Logger::Log(Logger::ERROR, "TT::TextureArray::add: All ", this->capacity, " layers are in use.");
+			return TextureArray::INVALID_LAYER;
+		}
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, this->layerCount, this->width, this->height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		return this->layerCount++;
+	}
+	uint32_t TextureArray::add(const std::string& path) {
+		int width, height, channels;
+		uint8_t* pixels = Assets::loadImage(path, &width, &height, &channels, 4);
+
+		if (!pixels) {
+			Logger::Log(Logger::ERROR, "TT::TextureArray::add: Could not load \"", path, "\".");
+			return TextureArray::INVALID_LAYER;
+		}
+		if (width != this->width || height != this->height) {
+			Logger::Log(Logger::ERROR, "TT::TextureArray::add: \"", path, "\" is not ", this->width, "x", this->height, ".");
+
+			stbi_image_free(pixels);
+			return TextureArray::INVALID_LAYER;
+		}
+
+		const uint32_t layer = this->add(pixels);
+		stbi_image_free(pixels);
+
+		return layer;
+	}
+	void TextureArray::generateMipmaps() const {
+		if (!this->mipmaps) return;
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	void TextureArray::bind(const uint8_t bank) const {
+		glActiveTexture(GL_TEXTURE0 + bank);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+	}
+	void TextureArray::clear() {
+		Memory::untrackTexture(this->id);
+		glDeleteTextures(1, &this->id);
+
+		this->id = 0;
+		this->layerCount = 0;
+	}
+
+	GLuint TextureArray::getId() const {
+		return this->id;
+	}
+	uint32_t TextureArray::getLayerCount() const {
+		return this->layerCount;
+	}
+
+	// Texture table part
+
+	bool TextureTable::bindless = false;
+	GLuint TextureTable::buffer = 0;
+	uint32_t TextureTable::capacity = 0;
+
+	std::vector<GLuint> TextureTable::textures = {};
+	std::vector<GLuint64> TextureTable::handles = {};
+	std::unordered_map<GLuint, uint32_t> TextureTable::indices = {};
+	std::vector<uint32_t> TextureTable::freeIndices = {};
+	bool TextureTable::dirty = false;
+	std::unordered_map<GLuint, TextureTable::Locations> TextureTable::programs = {};
+
+	void TextureTable::init(const uint32_t capacity) {
+		TextureTable::bindless = Extensions::bindlessTexture;
+		TextureTable::capacity = capacity;
+
+		std::string header;
+
+		if (TextureTable::bindless) {
+			// std140 pads array elements to 16 bytes, so two handles share a uvec4.
+			GLint maxBlockSize;
+			glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+			TextureTable::capacity = std::min<uint32_t>(capacity, (uint32_t)maxBlockSize / 8);
+
+			const uint32_t entries = (TextureTable::capacity + 1) / 2;
+
+			glGenBuffers(1, &TextureTable::buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, TextureTable::buffer);
+			glBufferData(GL_UNIFORM_BUFFER, entries * 16, NULL, GL_DYNAMIC_DRAW);
+			Memory::trackBuffer(TextureTable::buffer, entries * 16, Memory::TEXTURE);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+			header =
+				"#extension GL_ARB_bindless_texture : require\n"
+				"layout(std140) uniform EngineTextureTable { uvec4 engineTextureHandles[" + std::to_string(entries) + "]; };\n"
+				"uniform uint engineTextureIndex;\n"
+				"vec4 engineSampleTexture(uint index, vec2 uv) {\n"
+				"\tuvec4 pair = engineTextureHandles[index >> 1];\n"
+				"\treturn texture(sampler2D((index & 1u) == 0u ? pair.xy : pair.zw), uv);\n"
+				"}\n";
+		}
+		else {
+			header =
+				"uniform uint engineTextureIndex;\n"
+				"uniform sampler2D engineTexture;\n"
+				"vec4 engineSampleTexture(uint index, vec2 uv) {\n"
+				"\treturn index == engineTextureIndex ? texture(engineTexture, uv) : vec4(1.0, 0.0, 1.0, 1.0);\n"
+				"}\n";
+		}
+
+		Shader::setBuiltin("texture_table", header);
+
+		Logger::Log(Logger::INFO, "TT::TextureTable::init: ", (TextureTable::bindless ? "Using bindless handles." : "Bindless textures unavailable, binding slots."));
+	}
+	void TextureTable::shutdown() {
+		if (TextureTable::bindless) {
+			for (GLuint64 handle : TextureTable::handles) {
+				if (handle) Extensions::makeTextureHandleNonResident(handle);
+			}
+
+			Memory::untrackBuffer(TextureTable::buffer);
+			glDeleteBuffers(1, &TextureTable::buffer);
+			TextureTable::buffer = 0;
+		}
+
+		TextureTable::textures.clear();
+		TextureTable::handles.clear();
+		TextureTable::indices.clear();
+		TextureTable::freeIndices.clear();
+		TextureTable::programs.clear();
+	}
+
+	uint32_t TextureTable::add(const GLuint texture) {
+		// Making a handle resident twice is an error.
+		const auto existing = TextureTable::indices.find(texture);
+		if (existing != TextureTable::indices.end()) return existing->second;
+
+		uint32_t index;
+
+		if (!TextureTable::freeIndices.empty()) {
+			index = TextureTable::freeIndices.back();
+			TextureTable::freeIndices.pop_back();
+		}
+		else if (TextureTable::textures.size() < TextureTable::capacity) {
+			index = (uint32_t)TextureTable::textures.size();
+
+			TextureTable::textures.push_back(0);
+			if (TextureTable::bindless) TextureTable::handles.push_back(0);
+		}
+		else {
+			Logger::Log(Logger::ERROR, "TT::TextureTable::add: Table is full (", TextureTable::capacity, " textures).");
+			return TextureTable::INVALID_INDEX;
+		}
+
+		TextureTable::textures[index] = texture;
+		TextureTable::indices[texture] = index;
+
+		// A handle freezes the texture's state, so it is only taken once the
+		// texture is fully created.
+		if (TextureTable::bindless) {
+			const GLuint64 handle = Extensions::getTextureHandle(texture);
+			Extensions::makeTextureHandleResident(handle);
+
+			TextureTable::handles[index] = handle;
+			TextureTable::dirty = true;
+		}
+
+		return index;
+	}
+	void TextureTable::remove(const GLuint texture) {
+		const auto entry = TextureTable::indices.find(texture);
+		if (entry == TextureTable::indices.end()) return;
+
+		const uint32_t index = entry->second;
+		TextureTable::indices.erase(entry);
+
+		// Sampling a resident handle of a deleted texture is undefined.
+		if (TextureTable::bindless) {
+			Extensions::makeTextureHandleNonResident(TextureTable::handles[index]);
+
+			TextureTable::handles[index] = 0;
+			TextureTable::dirty = true;
+		}
+
+		TextureTable::textures[index] = 0;
+		TextureTable::freeIndices.push_back(index);
+	}
+
+	bool TextureTable::contains(const GLuint texture) {
+		return TextureTable::indices.count(texture) != 0;
+	}
+
+	void TextureTable::attach(const ShaderProgram& program) {
+		const GLuint id = program.getId();
+
+		if (TextureTable::bindless) {
+			const GLuint block = glGetUniformBlockIndex(id, "EngineTextureTable");
+			if (block != GL_INVALID_INDEX) {
+				glUniformBlockBinding(id, block, TextureTable::BLOCK_BINDING);
+			}
+		}
+
+		TextureTable::programs[id] = { glGetUniformLocation(id, "engineTextureIndex"), glGetUniformLocation(id, "engineTexture") };
+	}
+	void TextureTable::detach(const GLuint program) {
+		TextureTable::programs.erase(program);
+	}
+
+	void TextureTable::use(const ShaderProgram& program, const uint32_t index, const uint8_t bank) {
+		if (index >= TextureTable::textures.size() || !TextureTable::textures[index]) return;
+
+		auto locations = TextureTable::programs.find(program.getId());
+		if (locations == TextureTable::programs.end()) {
+			TextureTable::attach(program);
+			locations = TextureTable::programs.find(program.getId());
+		}
+
+		if (TextureTable::bindless) {
+			TextureTable::flush();
+			glBindBufferBase(GL_UNIFORM_BUFFER, TextureTable::BLOCK_BINDING, TextureTable::buffer);
+		}
+		else {
+			Texture::bind(TextureTable::textures[index], bank);
+			glUniform1i(locations->second.texture, bank);
+		}
+
+		glUniform1ui(locations->second.index, index);
+	}
+
+	void TextureTable::flush() {
+		if (!TextureTable::dirty) return;
+
+		glBindBuffer(GL_UNIFORM_BUFFER, TextureTable::buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, TextureTable::handles.size() * sizeof(GLuint64), TextureTable::handles.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		TextureTable::dirty = false;
+	}
+
+	bool TextureTable::isBindless() {
+		return TextureTable::bindless;
+	}
+
+	// Texture cache part
+
+	std::vector<TextureCache::Entry> TextureCache::entries = {};
+	std::unordered_map<std::string, TextureCache::Handle> TextureCache::lookup = {};
+
+	size_t TextureCache::budget = 256 * 1024 * 1024;
+	size_t TextureCache::residentBytes = 0;
+	uint64_t TextureCache::frame = 0;
+	bool TextureCache::overBudget = false;
+	TextureCacheStatistics TextureCache::statistics = {};
+
+	void TextureCache::setBudget(const size_t bytes) {
+		TextureCache::budget = bytes;
+		TextureCache::enforceBudget();
+	}
+
+	TextureCache::Handle TextureCache::acquire(const std::string& path, const TextureCreateInfo& createInfo) {
+		Handle handle;
+
+		auto found = TextureCache::lookup.find(path);
+		if (found != TextureCache::lookup.end()) {
+			handle = found->second;
+		}
+		else {
+			handle = (Handle)TextureCache::entries.size();
+
+			Entry entry = { path, createInfo, 0, {}, 0, 0, 0, 0, 0, 0 };
+			TextureCache::entries.push_back(entry);
+			TextureCache::lookup[path] = handle;
+		}
+
+		Entry& entry = TextureCache::entries[handle];
+		entry.references++;
+		entry.lastUsed = TextureCache::frame;
+
+		if (entry.texture) {
+			TextureCache::statistics.hits++;
+			return handle;
+		}
+
+		// The budget is enforced in update(), so a texture acquired this
+		// frame is never dropped or reloaded before it is first used.
+		TextureCache::statistics.misses++;
+		TextureCache::upload(entry);
+
+		return handle;
+	}
+	void TextureCache::release(const Handle handle) {
+		if (handle >= TextureCache::entries.size() || TextureCache::entries[handle].references == 0) {
+			Logger::Log(Logger::WARNING, "TT::TextureCache::release: Handle ", handle, " isn't acquired.");
+			return;
+		}
+
+		TextureCache::entries[handle].references--;
+	}
+	GLuint TextureCache::get(const Handle handle) {
+		if (handle >= TextureCache::entries.size()) return 0;
+
+		Entry& entry = TextureCache::entries[handle];
+		entry.lastUsed = TextureCache::frame;
+
+		return entry.texture;
+	}
+
+	void TextureCache::update() {
+		TextureCache::frame++;
+		TextureCache::enforceBudget();
+	}
+	void TextureCache::clear() {
+		for (Entry& entry : TextureCache::entries) TextureCache::unload(entry);
+
+		TextureCache::entries.clear();
+		TextureCache::lookup.clear();
+	}
+
+	bool TextureCache::upload(Entry& entry) {
+		if (std::filesystem::path(entry.path).extension() == ".ctex") {
+			CompressedTexture texture;
+
+			if (!Assets::loadCompressed(entry.path, texture) || texture.levels.empty()) {
+				Logger::Log(Logger::ERROR, "TT::TextureCache::upload: Could not load \"", entry.path, "\".");
+				return false;
+			}
+
+			entry.texture = Texture::loadCompressed(texture, entry.createInfo.filter, 0);
+			entry.width = (int)texture.levels[0].width;
+			entry.height = (int)texture.levels[0].height;
+
+			entry.levelBytes.clear();
+			for (const CompressedTextureLevel& level : texture.levels) entry.levelBytes.push_back((size_t)level.size);
+		}
+		else {
+			const int decodeChannels = Texture::getDecodeChannels(entry.createInfo);
+
+			int width, height, channels;
+			uint8_t* image = Assets::loadImage(entry.path, &width, &height, &channels, decodeChannels);
+
+			if (!image) {
+				Logger::Log(Logger::ERROR, "TT::TextureCache::upload: Could not load \"", entry.path, "\".");
+				return false;
+			}
+			if (decodeChannels) channels = decodeChannels;
+
+			Texture::process(image, width, height, channels, entry.createInfo);
+
+			entry.texture = Texture::create(width, height, channels, image, entry.createInfo);
+			entry.width = width;
+			entry.height = height;
+
+			stbi_image_free(image);
+
+			// Drivers pad RGB8 to four bytes per texel.
+			const size_t texelBytes = channels == 3 ? 4 : (size_t)channels;
+
+			entry.levelBytes.clear();
+			for (int level = 0; ; ++level) {
+				const int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+				entry.levelBytes.push_back((size_t)levelWidth * levelHeight * texelBytes);
+
+				if (!entry.createInfo.mipmaps || (levelWidth == 1 && levelHeight == 1)) break;
+			}
+		}
+
+		entry.skippedLevels = 0;
+		entry.bytes = 0;
+
+		if (!entry.texture) return false;
+
+		for (const size_t bytes : entry.levelBytes) entry.bytes += bytes;
+
+		TextureCache::residentBytes += entry.bytes;
+		TextureCache::statistics.peakBytes = std::max(TextureCache::statistics.peakBytes, TextureCache::residentBytes);
+
+		return true;
+	}
+	void TextureCache::unload(Entry& entry) {
+		if (!entry.texture) return;
+
+		Texture::clear(entry.texture);
+		entry.texture = 0;
+
+		TextureCache::residentBytes -= entry.bytes;
+		entry.bytes = 0;
+		entry.skippedLevels = 0;
+	}
+
+	bool TextureCache::canSkipLevel(const Entry& entry) {
+		if (!Extensions::copyImage || !Extensions::textureStorage) return false;
+		if (!entry.texture || entry.skippedLevels >= TextureCache::MAX_SKIPPED_LEVELS || entry.skippedLevels + 1 >= entry.levelBytes.size()) return false;
+		if (std::max(entry.width, entry.height) >> entry.skippedLevels <= 64) return false;
+
+		// The table refers to the texture by name, which dropping changes.
+		return !TextureTable::contains(entry.texture);
+	}
+	void TextureCache::dropLevel(Entry& entry) {
+		const GLuint source = entry.texture;
+		const uint32_t first = entry.skippedLevels + 1;
+		const GLsizei levels = (GLsizei)(entry.levelBytes.size() - first);
+
+		const GLenum SWIZZLES[4] = { GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A };
+
+		GLint internalFormat = 0;
+		GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+		glBindTexture(GL_TEXTURE_2D, source);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 1, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		if (Extensions::textureSwizzle) {
+			for (int c = 0; c < 4; ++c) glGetTexParameteriv(GL_TEXTURE_2D, SWIZZLES[c], &swizzle[c]);
+		}
+
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		Texture::setParameters(GL_TEXTURE_2D, entry.createInfo.filter, levels);
+		if (Extensions::textureSwizzle) {
+			for (int c = 0; c < 4; ++c) glTexParameteri(GL_TEXTURE_2D, SWIZZLES[c], swizzle[c]);
+		}
+		Extensions::texStorage2D(GL_TEXTURE_2D, levels, (GLenum)internalFormat, std::max(entry.width >> first, 1), std::max(entry.height >> first, 1));
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		for (GLsizei level = 0; level < levels; ++level) {
+			const GLsizei width = std::max(entry.width >> (first + level), 1), height = std::max(entry.height >> (first + level), 1);
+			Extensions::copyImageSubData(source, GL_TEXTURE_2D, level + 1, 0, 0, 0, texture, GL_TEXTURE_2D, level, 0, 0, 0, width, height, 1);
+		}
+
+		Texture::clear(source);
+		TextureCache::residentBytes -= entry.bytes;
+
+		entry.texture = texture;
+		entry.skippedLevels = first;
+		entry.bytes = 0;
+		for (size_t i = first; i < entry.levelBytes.size(); ++i) entry.bytes += entry.levelBytes[i];
+
+		TextureCache::residentBytes += entry.bytes;
+		Memory::trackTexture(texture, entry.bytes, Memory::TEXTURE);
+	}
+	// Loads the whole file again into a new texture; the old one stays
+	// until that worked. Returns false when it did not, and then forgets
+	// the dropped levels so it is not tried every frame.
+	bool TextureCache::restoreLevels(Entry& entry) {
+		Entry restored = entry;
+		restored.texture = 0;
+
+		if (!TextureCache::upload(restored)) {
+			entry.levelBytes.erase(entry.levelBytes.begin(), entry.levelBytes.begin() + entry.skippedLevels);
+			entry.width = std::max(entry.width >> entry.skippedLevels, 1);
+			entry.height = std::max(entry.height >> entry.skippedLevels, 1);
+			entry.skippedLevels = 0;
+
+			return false;
+		}
+
+		TextureCache::statistics.mipRestores += entry.skippedLevels;
+
+		TextureCache::unload(entry);
+		entry = std::move(restored);
+
+		return true;
+	}
+
+	void TextureCache::enforceBudget() {
+		std::pmr::vector<Handle> order(&FrameArena::get());
+		for (Handle i = 0; i < (Handle)TextureCache::entries.size(); ++i) {
+			if (TextureCache::entries[i].texture) order.push_back(i);
+		}
+
+		std::sort(order.begin(), order.end(), [](const Handle a, const Handle b) {
+			return TextureCache::entries[a].lastUsed < TextureCache::entries[b].lastUsed;
+		});
+
+		// Under budget: load one texture with dropped levels again, the most
+		// recently used whose whole chain fits, so restoring never pushes
+		// the cache over and costs at most one file load per frame.
+		if (TextureCache::residentBytes <= TextureCache::budget) {
+			TextureCache::overBudget = false;
+
+			for (auto handle = order.rbegin(); handle != order.rend(); ++handle) {
+				Entry& entry = TextureCache::entries[*handle];
+				if (entry.skippedLevels == 0) continue;
+
+				size_t fullBytes = 0;
+				for (const size_t bytes : entry.levelBytes) fullBytes += bytes;
+
+				if (TextureCache::residentBytes - entry.bytes + fullBytes > TextureCache::budget) continue;
+
+				TextureCache::restoreLevels(entry);
+				break;
+			}
+
+			return;
+		}
+
+		// Textures nobody holds go first, oldest first.
+		for (Handle handle : order) {
+			if (TextureCache::residentBytes <= TextureCache::budget) return;
+
+			Entry& entry = TextureCache::entries[handle];
+			if (entry.references > 0) continue;
+
+			TextureCache::unload(entry);
+			TextureCache::statistics.evictions++;
+		}
+
+		// Then textures in use lose their largest level, oldest first, one
+		// level per round so pressure is spread across them.
+		bool dropped = true;
+		while (TextureCache::residentBytes > TextureCache::budget && dropped) {
+			dropped = false;
+
+			for (Handle handle : order) {
+				if (TextureCache::residentBytes <= TextureCache::budget) return;
+
+				Entry& entry = TextureCache::entries[handle];
+				if (!TextureCache::canSkipLevel(entry)) continue;
+
+				TextureCache::dropLevel(entry);
+				TextureCache::statistics.mipDrops++;
+				dropped = true;
+			}
+		}
+
+		// Once per excursion, as this runs every frame.
+		if (TextureCache::residentBytes > TextureCache::budget && !TextureCache::overBudget) {
+			Logger::Log(Logger::WARNING, "TT::TextureCache::enforceBudget: ", TextureCache::residentBytes, " bytes resident, over the budget of ", TextureCache::budget, ".");
+		}
+		TextureCache::overBudget = TextureCache::residentBytes > TextureCache::budget;
+	}
+
+	TextureCacheStatistics TextureCache::getStatistics() {
+		TextureCacheStatistics statistics = TextureCache::statistics;
+
+		statistics.textureCount = TextureCache::entries.size();
+		statistics.residentCount = 0;
+		for (const Entry& entry : TextureCache::entries) {
+			if (entry.texture) statistics.residentCount++;
+		}
+
+		statistics.residentBytes = TextureCache::residentBytes;
+		statistics.budgetBytes = TextureCache::budget;
+
+		return statistics;
+	}
+	void TextureCache::logStatistics() {
+		const TextureCacheStatistics statistics = TextureCache::getStatistics();
+
+		std::ostringstream message;
+		message << std::fixed << std::setprecision(2);
+		message << "TT::TextureCache::logStatistics: " << statistics.residentCount << "/" << statistics.textureCount << " textures resident, "
+			<< statistics.residentBytes / 1048576.0 << "/" << statistics.budgetBytes / 1048576.0 << " MiB (peak " << statistics.peakBytes / 1048576.0 << " MiB), "
+			<< statistics.hits << " hits, " << statistics.misses << " misses, " << statistics.evictions << " evictions, " << statistics.mipDrops << " mip drops, " << statistics.mipRestores << " mip restores";
+
+		Logger::Log(Logger::INFO, message.str());
+	}
+
+	// Texture streaming part
+
+	bool TextureStreamer::running = false;
+	Jobs::Counter TextureStreamer::decoding;
+
+	std::mutex TextureStreamer::mutex;
+	std::deque<TextureStreamer::Image> TextureStreamer::images = {};
+
+	Pool<TextureStreamer::Slot, TextureStreamer> TextureStreamer::slots;
+	GLuint TextureStreamer::fallback = 0;
+
+	std::vector<TextureStreamer::Buffer> TextureStreamer::buffers = {};
+	size_t TextureStreamer::nextBuffer = 0;
+	size_t TextureStreamer::frameBudget = 0;
+
+	void TextureStreamer::init(const size_t bufferCount, const size_t frameBudget) {
+		if (TextureStreamer::running) {
+			Logger::Log(Logger::WARNING, "TT::TextureStreamer::init: Streamer already running!");
+			return;
+		}
+
+		TextureStreamer::running = true;
+		TextureStreamer::frameBudget = frameBudget;
+
+		TextureCreateInfo fallbackInfo(GL_NEAREST);
+		fallbackInfo.mipmaps = false;
+
+		const uint8_t grey[] = { 128, 128, 128, 255 };
+		TextureStreamer::fallback = Texture::create(1, 1, 4, grey, fallbackInfo);
+
+		TextureStreamer::buffers = std::vector<Buffer>(std::max<size_t>(bufferCount, 1));
+		for (Buffer& buffer : TextureStreamer::buffers) {
+			glGenBuffers(1, &buffer.id);
+			buffer.fence = NULL;
+		}
+		TextureStreamer::nextBuffer = 0;
+
+		Logger::Log(Logger::INFO, "TT::TextureStreamer::init: Decoding on ", Jobs::getThreadCount(), " job threads.");
+	}
+	void TextureStreamer::shutdown() {
+		if (!TextureStreamer::running) return;
+
+		// Jobs still decoding push their images; those are freed below.
+		TextureStreamer::running = false;
+		Jobs::wait(TextureStreamer::decoding);
+
+		for (Image& image : TextureStreamer::images) {
+			if (image.pixels) stbi_image_free(image.pixels);
+		}
+		TextureStreamer::images.clear();
+
+		for (Buffer& buffer : TextureStreamer::buffers) {
+			if (buffer.fence) glDeleteSync(buffer.fence);
+			Memory::untrackBuffer(buffer.id);
+			glDeleteBuffers(1, &buffer.id);
+		}
+		TextureStreamer::buffers.clear();
+
+		// Handles handed out before stay stale, so IO callbacks still to
+		// come find no slot.
+		TextureStreamer::slots.clear([](Slot& slot) {
+			if (!slot.texture) return;
+
+			TextureTable::remove(slot.texture);
+			Memory::untrackTexture(slot.texture);
+			glDeleteTextures(1, &slot.texture);
+		});
+
+		Texture::clear(TextureStreamer::fallback);
+		TextureStreamer::fallback = 0;
+	}
+
+	TextureStreamer::Handle TextureStreamer::request(const std::string& path, const TextureCreateInfo& createInfo) {
+		if (!TextureStreamer::running) {
+			TextureStreamer::init(4, 16 * 1024 * 1024);
+		}
+
+		const Handle handle = TextureStreamer::slots.create(Slot{ 0, LOADING });
+
+		// Archive entries are already in memory; loose files are read
+		// through IO so many reads are in flight while jobs decode.
+		if (Assets::find(path)) {
+			TextureStreamer::enqueue({ handle, path, createInfo, {} });
+			return handle;
+		}
+
+		IO::read(path, IO::NORMAL, [handle, createInfo](IO::Result& result) {
+			const Slot* slot = TextureStreamer::slots.get(handle);
+			if (!slot) return;
+
+			if (result.error) {
+				Logger::Log(Logger::WARNING, "TT::TextureStreamer::request: Could not read \"", result.path, "\": ", std::strerror(result.error), ", keeping fallback.");
+				TextureStreamer::finish(handle);
+				return;
+			}
+			if (slot->state == CANCELLED) {
+				TextureStreamer::finish(handle);
+				return;
+			}
+
+			TextureStreamer::enqueue({ handle, std::move(result.path), createInfo, std::move(result.data) });
+		});
+
+		return handle;
+	}
+	TextureStreamer::Handle TextureStreamer::request(const std::string& path, const GLint filter) {
+		return TextureStreamer::request(path, TextureCreateInfo(filter));
+	}
+	GLuint TextureStreamer::get(const Handle handle) {
+		const Slot* slot = TextureStreamer::slots.get(handle);
+		if (!slot || !slot->texture) {
+			return TextureStreamer::fallback;
+		}
+
+		return slot->texture;
+	}
+	bool TextureStreamer::isReady(const Handle handle) {
+		const Slot* slot = TextureStreamer::slots.get(handle);
+		return slot && slot->texture != 0;
+	}
+	void TextureStreamer::clear(const Handle handle) {
+		Slot* slot = TextureStreamer::slots.get(handle);
+		if (!slot || slot->state == CANCELLED) return;
+
+		// Still in flight: the slot is freed when its image arrives.
+		if (slot->state == LOADING) {
+			slot->state = CANCELLED;
+			return;
+		}
+
+		if (slot->texture) Texture::clear(slot->texture);
+		TextureStreamer::slots.destroy(handle);
+	}
+
+	void TextureStreamer::finish(const Handle handle) {
+		Slot* slot = TextureStreamer::slots.get(handle);
+		if (!slot) return;
+
+		if (slot->state == CANCELLED) {
+			TextureStreamer::slots.destroy(handle);
+		}
+		else {
+			slot->state = LOADED;
+		}
+	}
+
+	void TextureStreamer::update() {
+		if (!TextureStreamer::running) return;
+
+		size_t uploaded = 0;
+
+		while (true) {
+			Image image;
+
+			{
+				std::lock_guard<std::mutex> lock(TextureStreamer::mutex);
+				if (TextureStreamer::images.empty()) break;
+
+				image = TextureStreamer::images.front();
+
+				// One upload always goes through, so a texture larger than
+				// the budget cannot stall the queue forever.
+				const Slot* slot = TextureStreamer::slots.get(image.handle);
+				const size_t size = (size_t)image.width * (size_t)image.height * (size_t)image.channels;
+				if (image.pixels && slot && slot->state != CANCELLED && uploaded > 0 && uploaded + size > TextureStreamer::frameBudget) break;
+
+				TextureStreamer::images.pop_front();
+			}
+
+			const Slot* slot = TextureStreamer::slots.get(image.handle);
+
+			if (!image.pixels || !slot || slot->state == CANCELLED) {
+				if (image.pixels) stbi_image_free(image.pixels);
+				TextureStreamer::finish(image.handle);
+				continue;
+			}
+
+			if (!TextureStreamer::upload(image)) {
+				std::lock_guard<std::mutex> lock(TextureStreamer::mutex);
+				TextureStreamer::images.push_front(image);
+				break;
+			}
+
+			uploaded += (size_t)image.width * (size_t)image.height * (size_t)image.channels;
+		}
+	}
+
+	bool TextureStreamer::upload(const Image& image) {
+		Slot* slot = TextureStreamer::slots.get(image.handle);
+		Buffer& buffer = TextureStreamer::buffers[TextureStreamer::nextBuffer];
+
+		// The ring is full while the GPU still reads from the oldest buffer.
+		if (buffer.fence) {
+			if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+
+			glDeleteSync(buffer.fence);
+			buffer.fence = NULL;
+		}
+
+		const GLsizeiptr size = (GLsizeiptr)image.width * image.height * image.channels;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		Memory::trackBuffer(buffer.id, (size_t)size, Memory::TEXTURE);
+
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped) {
+			std::memcpy(mapped, image.pixels, (size_t)size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// With an unpack buffer bound the pixel pointer is an offset into it.
+			slot->texture = Texture::create(image.width, image.height, image.channels, (const void*)0, image.createInfo);
+			buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			slot->texture = Texture::create(image.width, image.height, image.channels, image.pixels, image.createInfo);
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		stbi_image_free(image.pixels);
+		slot->state = LOADED;
+
+		TextureStreamer::nextBuffer = (TextureStreamer::nextBuffer + 1) % TextureStreamer::buffers.size();
+		return true;
+	}
+
+	void TextureStreamer::enqueue(Request request) {
+		if (!TextureStreamer::running) return;
+
+		Jobs::run([request = std::move(request)]() {
+			TextureStreamer::decode(request);
+		}, &TextureStreamer::decoding);
+	}
+	void TextureStreamer::decode(const Request& request) {
+		Image image = { request.handle, request.createInfo, 0, 0, 0, nullptr };
+		const int decodeChannels = Texture::getDecodeChannels(request.createInfo);
+
+		if (!request.data.empty()) {
+			image.pixels = stbi_load_from_memory((const stbi_uc*)request.data.data(), (int)request.data.size(), &image.width, &image.height, &image.channels, decodeChannels);
+		}
+		else {
+			image.pixels = Assets::loadImage(request.path, &image.width, &image.height, &image.channels, decodeChannels);
+		}
+		if (decodeChannels) image.channels = decodeChannels;
+
+		if (!image.pixels) {
+			Logger::Log(Logger::WARNING, "TT::TextureStreamer::decode: Could not decode \"", request.path, "\", keeping fallback.");
+		}
+		else {
+			Texture::process(image.pixels, image.width, image.height, image.channels, image.createInfo);
+		}
+
+		std::lock_guard<std::mutex> lock(TextureStreamer::mutex);
+		TextureStreamer::images.push_back(image);
+	}
+
+	// Resource part
+
+	Pool<Mesh> Resources::meshes;
+	Pool<GLuint, Texture> Resources::textures;
+	Pool<ShaderProgram> Resources::programs;
+
+	Handle<Mesh> Resources::createMesh(const MeshBufferInfo& vertices, const std::vector<MeshBufferInfo>& additional, const GLint renderMode) {
+		return Resources::meshes.create(vertices, additional, renderMode);
+	}
+	Handle<Texture> Resources::addTexture(const GLuint texture) {
+		if (!texture) return {};
+
+		return Resources::textures.create(texture);
+	}
+	Handle<ShaderProgram> Resources::createProgram() {
+		return Resources::programs.create();
+	}
+
+	Mesh* Resources::get(const Handle<Mesh> handle) {
+		return Resources::meshes.get(handle);
+	}
+	GLuint Resources::get(const Handle<Texture> handle) {
+		const GLuint* texture = Resources::textures.get(handle);
+		return texture ? *texture : 0;
+	}
+	ShaderProgram* Resources::get(const Handle<ShaderProgram> handle) {
+		return Resources::programs.get(handle);
+	}
+
+	void Resources::destroy(const Handle<Mesh> handle) {
+		Resources::meshes.release(handle);
+	}
+	void Resources::destroy(const Handle<Texture> handle) {
+		Resources::textures.release(handle);
+	}
+	void Resources::destroy(const Handle<ShaderProgram> handle) {
+		Resources::programs.release(handle);
+	}
+
+	// Texture names are gathered so the frame's textures go in one
+	// glDeleteTextures call.
+	static void deleteTextures(const std::pmr::vector<GLuint>& textures) {
+		if (textures.empty()) return;
+
+		Texture::unbind();
+		for (const GLuint texture : textures) {
+			TextureTable::remove(texture);
+			Memory::untrackTexture(texture);
+		}
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	}
+
+	void Resources::update() {
+		std::pmr::vector<GLuint> textures(&FrameArena::get());
+
+		Resources::meshes.flush();
+		Resources::textures.flush([&](const GLuint texture) {
+			textures.push_back(texture);
+		});
+		Resources::programs.flush();
+
+		deleteTextures(textures);
+	}
+	void Resources::clear() {
+		std::pmr::vector<GLuint> textures(&FrameArena::get());
+
+		Resources::meshes.clear();
+		Resources::textures.clear([&](const GLuint texture) {
+			textures.push_back(texture);
+		});
+		Resources::programs.clear();
+
+		deleteTextures(textures);
 	}
 
 	// Timer part
@@ -8,6 +8,15 @@
 #include <vector>
 #include <sstream>
 
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <span>
+
 #include "../include/glm/glm.hpp"
 #include "../include/stb_image.h"
 
@@ -17,8 +26,87 @@
 #include "../include/glad/glad.h"
 
 #include "logger/logger.h"
+#include "arena/arena.h"
+#include "memory/memory.h"
+#include "pool/pool.h"
+#include "ctex/ctex.h"
+#include "atlas/atlas.h"
+#include "image/image.h"
+#include "archive/archive.h"
+#include "io/io.h"
+#include "jobs/jobs.h"
+#include "async/async.h"
+#include "ecs/ecs.h"
+#include "scheduler/scheduler.h"
+#include "transform/transform.h"
+#include "camera/camera.h"
+#include "bvh/bvh.h"
+#include "occlusion/occlusion.h"
+#include "lod/lod.h"
+
+#ifndef GL_TEXTURE_SWIZZLE_R
+#define GL_TEXTURE_SWIZZLE_R 0x8E42
+#define GL_TEXTURE_SWIZZLE_G 0x8E43
+#define GL_TEXTURE_SWIZZLE_B 0x8E44
+#define GL_TEXTURE_SWIZZLE_A 0x8E45
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
 
 namespace Engine {
+	// Extensions part
+
+	// glad is generated for GL 3.2 without extensions, so newer entry points
+	// are loaded here after the context is created, when the driver has them.
+	class Extensions {
+	public:
+		typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+		typedef GLuint64 (APIENTRYP GetTextureHandleProc)(GLuint texture);
+		typedef void (APIENTRYP MakeTextureHandleResidentProc)(GLuint64 handle);
+		typedef void (APIENTRYP MakeTextureHandleNonResidentProc)(GLuint64 handle);
+		typedef void (APIENTRYP CopyImageSubDataProc)(GLuint sourceName, GLenum sourceTarget, GLint sourceLevel, GLint sourceX, GLint sourceY, GLint sourceZ,
+			GLuint destinationName, GLenum destinationTarget, GLint destinationLevel, GLint destinationX, GLint destinationY, GLint destinationZ,
+			GLsizei width, GLsizei height, GLsizei depth);
+
+		static bool textureStorage;
+		static bool textureSwizzle;
+		static bool textureCompressionS3TC;
+		static bool bindlessTexture;
+		static bool copyImage;
+
+		static TexStorage2DProc texStorage2D;
+		static GetTextureHandleProc getTextureHandle;
+		static MakeTextureHandleResidentProc makeTextureHandleResident;
+		static MakeTextureHandleNonResidentProc makeTextureHandleNonResident;
+		static CopyImageSubDataProc copyImageSubData;
+
+		static void load();
+		static bool isSupported(const int major, const int minor, const char* extension);
+	};
+
+	// Assets part
+
+	// Archives mounted here are searched before the file system by shader
+	// and texture loads. The archive mounted last wins.
+	class Assets {
+	private:
+		static std::vector<std::unique_ptr<AssetArchive>> archives;
+	public:
+		static bool mount(const std::string& path);
+		static void unmountAll();
+
+		// Nothing when no mounted archive has the path.
+		static std::optional<std::span<const std::byte>> find(const std::string& path);
+		// stbi_load that reads from a mounted archive first.
+		static uint8_t* loadImage(const std::string& path, int* width, int* height, int* channels, const int desiredChannels);
+		static bool loadCompressed(const std::string& path, CompressedTexture& texture);
+	};
+
 	// Window part
 
 	struct WindowCreateInfo {
@@ -145,25 +233,93 @@ namespace Engine {
 		static void unload();
 	};
 
+	// Levels of detail of a GL_TRIANGLES mesh, finest first. generate()
+	// only touches CPU data, so it can run offline or on a job; the
+	// constructor uploads every level. LODSelector picks the level to
+	// render from getErrors().
+	struct MeshLODInfo {
+		MeshBufferInfo vertices;
+		std::vector<MeshBufferInfo> additional;
+		// Object space error, see LODLevel.
+		float error;
+	};
+	class MeshLOD {
+	private:
+		std::vector<std::unique_ptr<Mesh>> meshes;
+		std::vector<float> errors;
+	public:
+		MeshLOD();
+		MeshLOD(const std::vector<MeshLODInfo>& levels);
+
+		static std::vector<MeshLODInfo> generate(const MeshBufferInfo& vertices, const std::vector<MeshBufferInfo>& additional, const size_t maxLevels = 4, const float ratio = 0.5f);
+
+		// Loads and draws the level, clamped to the coarsest one.
+		void render(const size_t level) const;
+		void clear();
+
+		size_t getLevelCount() const;
+		const Mesh& getMesh(const size_t level) const;
+		const std::vector<float>& getErrors() const;
+	};
+
 	// Shader part
 
 	class Shader {
 	private:
 		GLuint id;
-		static GLuint loadFromSource(const std::string& code, const GLenum type);
+		GLenum type;
+		std::string path;
+
+		// Every file the source was assembled from, the root file first.
+		// Index i is the source string number given to "#line" for file i.
+		std::vector<std::string> files;
+		float compileMilliseconds;
+
+		// An invalid shader, id 0, for sources that could not be assembled.
+		Shader(const GLenum type, const std::vector<std::string>& files);
+		Shader(const std::string& code, const GLenum type, const std::vector<std::string>& files);
+
+		static std::unordered_map<std::string, std::string> builtins;
+
+		static GLuint loadFromSource(const std::string& code, const GLenum type, const std::vector<std::string>& files, float& milliseconds);
+		static bool preprocess(const std::string& path, std::vector<std::string>& files, std::string& code);
+		static std::string mapLog(const std::string& log, const std::vector<std::string>& files);
+
+		friend class ShaderHotReload;
 	public:
 		Shader(const std::string& code, const GLenum type);
 		static Shader loadFromFile(const std::string &path, const GLenum type);
 
+		// Makes "#include <name>" in shader files paste the given code.
+		static void setBuiltin(const std::string& name, const std::string& code);
+
 		void clear();
 		GLuint getId() const;
+		GLenum getType() const;
+		const std::string& getPath() const;
+		const std::vector<std::string>& getFiles() const;
+
+		bool isCompiled() const;
+		float getCompileMilliseconds() const;
+	};
+	struct ShaderProgramStatistics {
+		std::string name;
+
+		float compileMilliseconds;
+		float linkMilliseconds;
 	};
 	class ShaderProgram {
 	private:
 		GLuint id;
 		std::vector<Shader> shaders;
 
-		static void logProgramError(const GLuint id);
+		static std::vector<ShaderProgramStatistics> statistics;
+
+		static void logProgramError(const GLuint id, const std::string& message);
+
+		void replace(const GLuint id, const std::vector<Shader>& shaders);
+
+		friend class ShaderHotReload;
 	public:
 		ShaderProgram();
 		~ShaderProgram();
@@ -174,6 +330,8 @@ namespace Engine {
 		void load() const;
 		void clear();
 
+		GLuint getId() const;
+
 		void setBoolean(const char* name, const bool value) const;
 		void setInteger(const char* name, const int value) const;
 		void setFloat(const char* name, const float value) const;
@@ -184,19 +342,406 @@ namespace Engine {
 		void setMatrix3(const char* name, const glm::mat3 value) const;
 		void setMatrix4(const char* name, const glm::mat4 value) const;
 
+		bool isLinked() const;
+
 		static void unload();
+
+		static const std::vector<ShaderProgramStatistics>& getStatistics();
+		static void logStatistics();
+	};
+
+	// Shader hot reload part
+
+	// Watches the source files of every compiled ShaderProgram and rebuilds
+	// the program on a hidden shared context when one of them changes. The
+	// rebuilt program replaces the old one in update(), which Window calls
+	// at the frame boundary; a failed rebuild keeps the old program.
+	class ShaderHotReload {
+	private:
+		struct Result {
+			ShaderProgram* program;
+			GLuint id;
+			std::vector<Shader> shaders;
+		};
+
+		static GLFWwindow* context;
+		static std::thread watcher;
+		static std::atomic<bool> enabled;
+
+		static std::mutex mutex;
+		static std::vector<ShaderProgram*> programs;
+		static std::vector<Result> results;
+
+		static int inotifyId;
+		static std::unordered_map<int, std::string> directories;
+
+		static void watch();
+		static void watchDirectory(const std::string& path);
+		static void rebuild(const std::vector<std::string>& changed);
+	public:
+		static void enable();
+		static void disable();
+		static bool isEnabled();
+
+		static void track(ShaderProgram* program);
+		static void untrack(ShaderProgram* program);
+
+		static void update();
 	};
 
 	// Texture part
 
+	struct TextureCreateInfo {
+		GLint filter;
+
+		bool srgb;
+		bool mipmaps;
+		bool premultiplyAlpha;
+		// Decodes the sRGB curve on the CPU into a linear RGBA8 texture;
+		// ignored with srgb, where sampling decodes it.
+		bool linearize;
+		// Channel order, as ImageProcessing::swizzle takes it; { 0, 1, 2, 3 }
+		// keeps it. This and linearize decode every image as RGBA.
+		uint8_t swizzle[4];
+
+		TextureCreateInfo();
+		TextureCreateInfo(const GLint filter);
+	};
 	class Texture {
+	private:
+		static void setParameters(const GLenum target, const GLint filter, const GLsizei levels);
+		// Channels to decode with: 4 when process() has to swizzle or
+		// linearize, which work on RGBA, else 0 for the file's own.
+		static int getDecodeChannels(const TextureCreateInfo& createInfo);
+		static void process(uint8_t* pixels, const int width, const int height, const int channels, const TextureCreateInfo& createInfo);
+
+		friend class TextureArray;
+		friend class TextureCache;
+		friend class TextureStreamer;
+		friend class ImageBatch;
 	public:
+		static GLuint create(const int width, const int height, const int channels, const void* pixels, const TextureCreateInfo& createInfo);
+		static GLuint loadFromFile(const std::string& path, const TextureCreateInfo& createInfo);
 		static GLuint loadFromFile(const std::string& path, const GLint filter);
+		static std::vector<GLuint> loadFromFiles(const std::vector<std::string>& paths, const TextureCreateInfo& createInfo);
+		static GLuint loadCompressed(const std::string& path, const GLint filter);
+		static GLuint loadCompressed(const CompressedTexture& texture, const GLint filter, const uint32_t firstLevel);
+		// Reads through IO, decodes on a job and uploads at the next frame
+		// boundary. Resolves to 0 on failure, like loadFromFile.
+		static Task<GLuint> loadAsync(std::string path, TextureCreateInfo createInfo);
 
 		static void bind(const GLuint texture, const uint8_t bank);
 		static void unbind();
 		static void clear(GLuint texture);
 	};
+
+	// Image batch part
+
+	struct DecodedImage {
+		std::string path;
+
+		int width, height, channels;
+		uint8_t* pixels;
+	};
+	// Decodes many image files in one call. Files are memory mapped and
+	// decoded with stbi_load_from_memory as jobs, so large loads scale
+	// with the core count. Failed images have null pixels.
+	class ImageBatch {
+	private:
+		static bool decode(DecodedImage& image, const int desiredChannels);
+	public:
+		static std::vector<DecodedImage> load(const std::vector<std::string>& paths, const int desiredChannels, const TextureCreateInfo& createInfo);
+		static void free(std::vector<DecodedImage>& images);
+	};
+
+	// Texture atlas part
+
+	struct TextureAtlasRegion {
+		glm::vec2 min, max;
+	};
+	// Packs many small images into one texture so draws that used them can
+	// share a single bind. Regions are looked up by the path they came from.
+	class TextureAtlas {
+	private:
+		GLuint id;
+		int width, height;
+
+		std::unordered_map<std::string, TextureAtlasRegion> regions;
+	public:
+		TextureAtlas();
+
+		static TextureAtlas build(const std::vector<std::string>& paths, const int maxSize, const int padding, const TextureCreateInfo& createInfo);
+
+		bool getRegion(const std::string& path, TextureAtlasRegion& region) const;
+
+		void bind(const uint8_t bank) const;
+		void clear();
+
+		GLuint getId() const;
+		glm::ivec2 getSize() const;
+	};
+
+	// Texture array part
+
+	// GL_TEXTURE_2D_ARRAY of equally sized layers. add() returns the layer
+	// index that shaders pass as the third texture coordinate.
+	class TextureArray {
+	private:
+		GLuint id;
+		int width, height;
+
+		uint32_t layerCount, capacity;
+		bool mipmaps;
+	public:
+		TextureArray();
+		TextureArray(const int width, const int height, const uint32_t capacity, const TextureCreateInfo& createInfo);
+
+		uint32_t add(const uint8_t* rgba);
+		uint32_t add(const std::string& path);
+		void generateMipmaps() const;
+
+		void bind(const uint8_t bank) const;
+		void clear();
+
+		GLuint getId() const;
+		uint32_t getLayerCount() const;
+
+		static const uint32_t INVALID_LAYER = 0xFFFFFFFF;
+	};
+
+	// Texture table part
+
+	// Index-addressed textures for shaders that include <texture_table>.
+	// With ARB_bindless_texture the table is a uniform block of resident
+	// 64-bit handles and engineSampleTexture(index, uv) can pick any of them
+	// per draw or per instance. Without it use() binds the texture to a
+	// slot, so the index has to be engineTextureIndex, the one use() set
+	// for the draw; any other index samples magenta to show the misuse.
+	class TextureTable {
+	private:
+		struct Locations {
+			GLint index, texture;
+		};
+
+		static bool bindless;
+		static GLuint buffer;
+		static uint32_t capacity;
+
+		// Removed slots hold texture 0 until add() reuses them.
+		static std::vector<GLuint> textures;
+		static std::vector<GLuint64> handles;
+		static std::unordered_map<GLuint, uint32_t> indices;
+		static std::vector<uint32_t> freeIndices;
+		static bool dirty;
+		// Uniform locations by program, looked up once in attach().
+		static std::unordered_map<GLuint, Locations> programs;
+
+		static void flush();
+		static void detach(const GLuint program);
+
+		friend class ShaderProgram;
+	public:
+		static const GLuint BLOCK_BINDING = 0;
+		static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+		static void init(const uint32_t capacity);
+		static void shutdown();
+
+		// Adding a texture twice returns its existing index. INVALID_INDEX
+		// when the table is full.
+		static uint32_t add(const GLuint texture);
+		// Makes the texture's handle non-resident and frees its slot; must
+		// run before the texture is deleted, Texture::clear calls it.
+		static void remove(const GLuint texture);
+		static bool contains(const GLuint texture);
+		// use() attaches programs it has not seen, after linking or a hot
+		// reload.
+		static void attach(const ShaderProgram& program);
+		static void use(const ShaderProgram& program, const uint32_t index, const uint8_t bank);
+
+		static bool isBindless();
+	};
+
+	// Texture cache part
+
+	struct TextureCacheStatistics {
+		size_t textureCount, residentCount;
+		size_t residentBytes, peakBytes, budgetBytes;
+
+		size_t hits, misses;
+		size_t evictions, mipDrops, mipRestores;
+	};
+	// Shares textures by path and keeps their estimated memory under a
+	// budget, checked in update() at the frame boundary. Unreferenced
+	// textures stay cached until the budget is hit and are then evicted
+	// least recently used first; if that is not enough, referenced
+	// textures lose their largest mip level: the GPU copies the other
+	// levels into smaller storage and the old texture is deleted, so the
+	// memory is really freed. That needs GL_ARB_copy_image and immutable
+	// storage, and skips textures in the TextureTable, which refers to
+	// them by name. A texture whose levels were dropped is loaded again,
+	// one per frame, once all of it fits.
+	//
+	// Dropping and restoring levels changes the texture's GL name, so
+	// call get() where the texture is used rather than keeping the name.
+	class TextureCache {
+	public:
+		typedef uint32_t Handle;
+	private:
+		struct Entry {
+			std::string path;
+			TextureCreateInfo createInfo;
+
+			GLuint texture;
+			// Estimated size of every mip level of the file, and of the
+			// levels from skippedLevels on, which are the ones the texture
+			// holds.
+			std::vector<size_t> levelBytes;
+			size_t bytes;
+			uint32_t skippedLevels;
+
+			// Of level 0.
+			int width, height;
+			uint32_t references;
+			uint64_t lastUsed;
+		};
+
+		static std::vector<Entry> entries;
+		static std::unordered_map<std::string, Handle> lookup;
+
+		static size_t budget, residentBytes;
+		static uint64_t frame;
+		static bool overBudget;
+		static TextureCacheStatistics statistics;
+
+		static bool upload(Entry& entry);
+		static void unload(Entry& entry);
+		static bool canSkipLevel(const Entry& entry);
+		static void dropLevel(Entry& entry);
+		static bool restoreLevels(Entry& entry);
+		static void enforceBudget();
+	public:
+		static const uint32_t MAX_SKIPPED_LEVELS = 4;
+
+		static void setBudget(const size_t bytes);
+
+		static Handle acquire(const std::string& path, const TextureCreateInfo& createInfo);
+		static void release(const Handle handle);
+		static GLuint get(const Handle handle);
+
+		static void update();
+		static void clear();
+
+		static TextureCacheStatistics getStatistics();
+		static void logStatistics();
+	};
+
+	// Texture streaming part
+
+	// Reads files through IO, decodes them as jobs and uploads them
+	// through a ring of pixel buffer objects, at most frameBudget bytes
+	// per frame. Until its upload is done a handle resolves to a 1x1 grey
+	// fallback texture. Handles are pool slots, reused once cleared; a
+	// cleared handle resolves to the fallback too. Render thread only.
+	class TextureStreamer {
+	public:
+		typedef Engine::Handle<TextureStreamer> Handle;
+	private:
+		enum State : uint8_t {
+			LOADING,
+			LOADED,
+			// Cleared while loading; the slot is freed once its image arrives.
+			CANCELLED
+		};
+
+		struct Slot {
+			GLuint texture;
+			State state;
+		};
+		struct Request {
+			Handle handle;
+			std::string path;
+			TextureCreateInfo createInfo;
+
+			// File contents read through IO; empty for archive entries.
+			std::vector<std::byte> data;
+		};
+		struct Image {
+			Handle handle;
+			TextureCreateInfo createInfo;
+
+			int width, height, channels;
+			uint8_t* pixels;
+		};
+		struct Buffer {
+			GLuint id;
+			GLsync fence;
+		};
+
+		static bool running;
+		// Decode jobs that have not finished.
+		static Jobs::Counter decoding;
+
+		// Decoded images, pushed by jobs and taken by update().
+		static std::mutex mutex;
+		static std::deque<Image> images;
+
+		static Pool<Slot, TextureStreamer> slots;
+		static GLuint fallback;
+
+		static std::vector<Buffer> buffers;
+		static size_t nextBuffer;
+		static size_t frameBudget;
+
+		static void enqueue(Request request);
+		static void decode(const Request& request);
+		// Nothing more arrives for the handle: a cancelled slot is freed.
+		static void finish(const Handle handle);
+		static bool upload(const Image& image);
+	public:
+		static void init(const size_t bufferCount, const size_t frameBudget);
+		static void shutdown();
+
+		static Handle request(const std::string& path, const TextureCreateInfo& createInfo);
+		static Handle request(const std::string& path, const GLint filter);
+		static GLuint get(const Handle handle);
+		static bool isReady(const Handle handle);
+		static void clear(const Handle handle);
+
+		static void update();
+	};
+
+	// Resource part
+
+	// Owns meshes, textures and shader programs behind generational
+	// handles, so a handle kept after its resource is gone resolves to
+	// null (0 for textures) instead of to a deleted or reused GL name.
+	// destroy() makes the handle stale at once; the GL objects are deleted
+	// together in update(), which Window calls at the frame boundary.
+	// Render thread only.
+	class Resources {
+	private:
+		static Pool<Mesh> meshes;
+		static Pool<GLuint, Texture> textures;
+		static Pool<ShaderProgram> programs;
+	public:
+		static Handle<Mesh> createMesh(const MeshBufferInfo& vertices, const std::vector<MeshBufferInfo>& additional, const GLint renderMode);
+		// Takes ownership of a texture made by Texture; 0 gives a null handle.
+		static Handle<Texture> addTexture(const GLuint texture);
+		// Bind shaders and compile through get().
+		static Handle<ShaderProgram> createProgram();
+
+		static Mesh* get(const Handle<Mesh> handle);
+		static GLuint get(const Handle<Texture> handle);
+		static ShaderProgram* get(const Handle<ShaderProgram> handle);
+
+		static void destroy(const Handle<Mesh> handle);
+		static void destroy(const Handle<Texture> handle);
+		static void destroy(const Handle<ShaderProgram> handle);
+
+		static void update();
+		static void clear();
+	};
 	
 	// Timer part
 
@@ -0,0 +1,340 @@
+#include "image.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ENGINE_IMAGE_X86
+#include <immintrin.h>
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#define ENGINE_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+namespace Engine {
+	struct SrgbTable {
+		uint8_t bytes[256];
+		alignas(32) int words[256];
+
+		SrgbTable() {
+			for (int i = 0; i < 256; ++i) {
+				const double value = i / 255.0;
+				const double linear = value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+
+				this->bytes[i] = (uint8_t)std::lround(linear * 255.0);
+				this->words[i] = this->bytes[i];
+			}
+		}
+	};
+	static const SrgbTable& getSrgbTable() {
+		static const SrgbTable table;
+		return table;
+	}
+
+	static ImageProcessing::Backend detectBackend() {
+#ifdef ENGINE_IMAGE_X86
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? ImageProcessing::AVX2 : ImageProcessing::SSE2;
+#else
+		return ImageProcessing::SCALAR;
+#endif
+	}
+
+	ImageProcessing::Backend ImageProcessing::backend = detectBackend();
+
+#ifdef ENGINE_IMAGE_X86
+	// The SSE2 backend shuffles bytes with pshufb where the CPU has SSSE3,
+	// which is nearly every x86-64 CPU.
+	static bool detectSSSE3() {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("ssse3");
+	}
+	static const bool hasSSSE3 = detectSSSE3();
+#endif
+
+	ImageProcessing::Backend ImageProcessing::getBackend() {
+		return ImageProcessing::backend;
+	}
+	const char* ImageProcessing::getBackendName(const Backend backend) {
+		switch (backend) {
+		case SCALAR:
+			return "scalar";
+		case SSE2:
+			return "SSE2";
+		case AVX2:
+			return "AVX2";
+		}
+
+		return "unknown";
+	}
+	void ImageProcessing::setBackend(const Backend backend) {
+		ImageProcessing::backend = std::min(backend, detectBackend());
+	}
+
+	// Scalar code, also used for the tails the vector loops leave over.
+
+	static void premultiplyScalar(uint8_t* rgba, const size_t begin, const size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			uint8_t* pixel = rgba + i * 4;
+			const uint32_t alpha = pixel[3];
+
+			for (int c = 0; c < 3; ++c) {
+				const uint32_t product = pixel[c] * alpha + 128;
+				pixel[c] = (uint8_t)((product + (product >> 8)) >> 8);
+			}
+		}
+	}
+	static void srgbToLinearScalar(uint8_t* rgba, const size_t begin, const size_t end) {
+		const uint8_t* table = getSrgbTable().bytes;
+
+		for (size_t i = begin; i < end; ++i) {
+			uint8_t* pixel = rgba + i * 4;
+
+			pixel[0] = table[pixel[0]];
+			pixel[1] = table[pixel[1]];
+			pixel[2] = table[pixel[2]];
+		}
+	}
+	static void swizzleScalar(uint8_t* rgba, const size_t begin, const size_t end, const uint8_t order[4]) {
+		// Offsets in locals and every channel read before any is written,
+		// so the stores cannot alias the loads and nothing is reloaded.
+		const uint8_t red = order[0], green = order[1], blue = order[2], alpha = order[3];
+
+		for (size_t i = begin; i < end; ++i) {
+			uint8_t* pixel = rgba + i * 4;
+			const uint8_t r = pixel[red], g = pixel[green], b = pixel[blue], a = pixel[alpha];
+
+			pixel[0] = r;
+			pixel[1] = g;
+			pixel[2] = b;
+			pixel[3] = a;
+		}
+	}
+	static void downsampleScalar(const uint8_t* row0, const uint8_t* row1, const int width, const int begin, const int end, uint8_t* destination) {
+		for (int x = begin; x < end; ++x) {
+			const int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+
+			for (int c = 0; c < 4; ++c) {
+				const int sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+				destination[x * 4 + c] = (uint8_t)((sum + 2) >> 2);
+			}
+		}
+	}
+
+#ifdef ENGINE_IMAGE_X86
+	// SSE2 code, four pixels per register.
+
+	static __m128i premultiplyWords(const __m128i words, const __m128i alphaMask) {
+		// Broadcast each pixel's alpha over its four words and multiply the
+		// alpha word by 255 so that it survives the division below.
+		__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(words, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		alpha = _mm_or_si128(_mm_andnot_si128(alphaMask, alpha), _mm_and_si128(alphaMask, _mm_set1_epi16(255)));
+
+		const __m128i product = _mm_add_epi16(_mm_mullo_epi16(words, alpha), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+	}
+	static void premultiplySSE2(uint8_t* rgba, const size_t pixelCount) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4) {
+			const __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+
+			const __m128i low = premultiplyWords(_mm_unpacklo_epi8(pixels, zero), alphaMask);
+			const __m128i high = premultiplyWords(_mm_unpackhi_epi8(pixels, zero), alphaMask);
+
+			_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(low, high));
+		}
+
+		premultiplyScalar(rgba, i, pixelCount);
+	}
+
+	static __m128i swizzlePattern(const uint8_t order[4]) {
+		alignas(16) int8_t pattern[16];
+		for (int i = 0; i < 16; ++i) pattern[i] = (int8_t)((i & ~3) + order[i & 3]);
+
+		return _mm_load_si128((const __m128i*)pattern);
+	}
+	ENGINE_TARGET_SSSE3 static void swizzleSSSE3(uint8_t* rgba, const size_t pixelCount, const uint8_t order[4]) {
+		const __m128i shuffle = swizzlePattern(order);
+
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4) {
+			const __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+			_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+		}
+
+		swizzleScalar(rgba, i, pixelCount, order);
+	}
+
+	static void downsampleSSE2(const uint8_t* row0, const uint8_t* row1, const int width, const int targetWidth, uint8_t* destination) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+
+		// Four output pixels from eight input pixels of each row.
+		int x = 0;
+		for (; x + 4 <= targetWidth && (x + 4) * 2 <= width; x += 4) {
+			__m128i sums[4];
+
+			for (int half = 0; half < 2; ++half) {
+				const __m128i top = _mm_loadu_si128((const __m128i*)(row0 + (x * 2 + half * 4) * 4));
+				const __m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + (x * 2 + half * 4) * 4));
+
+				const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				sums[half * 2] = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+				sums[half * 2 + 1] = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+			}
+
+			const __m128i first = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[0], sums[1]), rounding), 2);
+			const __m128i second = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sums[2], sums[3]), rounding), 2);
+
+			_mm_storeu_si128((__m128i*)(destination + x * 4), _mm_packus_epi16(first, second));
+		}
+
+		downsampleScalar(row0, row1, width, x, targetWidth, destination);
+	}
+
+	// AVX2 code, eight pixels per register. Unpacking and packing work
+	// within 128-bit lanes, so the lane order is fixed up where needed.
+
+	ENGINE_TARGET_AVX2 static __m256i premultiplyWordsAVX2(const __m256i words, const __m256i alphaMask) {
+		__m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(words, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		alpha = _mm256_blendv_epi8(alpha, _mm256_set1_epi16(255), alphaMask);
+
+		const __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(words, alpha), _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+	}
+	ENGINE_TARGET_AVX2 static void premultiplyAVX2(uint8_t* rgba, const size_t pixelCount) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i alphaMask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+
+		size_t i = 0;
+		for (; i + 8 <= pixelCount; i += 8) {
+			const __m256i pixels = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+
+			const __m256i low = premultiplyWordsAVX2(_mm256_unpacklo_epi8(pixels, zero), alphaMask);
+			const __m256i high = premultiplyWordsAVX2(_mm256_unpackhi_epi8(pixels, zero), alphaMask);
+
+			_mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_packus_epi16(low, high));
+		}
+
+		premultiplyScalar(rgba, i, pixelCount);
+	}
+
+	ENGINE_TARGET_AVX2 static void srgbToLinearAVX2(uint8_t* rgba, const size_t pixelCount) {
+		const int* table = getSrgbTable().words;
+
+		const __m256i byteMask = _mm256_set1_epi32(0xFF);
+		const __m256i alphaMask = _mm256_set1_epi32((int)0xFF000000);
+
+		size_t i = 0;
+		for (; i + 8 <= pixelCount; i += 8) {
+			const __m256i pixels = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+
+			const __m256i red = _mm256_i32gather_epi32(table, _mm256_and_si256(pixels, byteMask), 4);
+			const __m256i green = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), 4);
+			const __m256i blue = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), 4);
+
+			__m256i result = _mm256_and_si256(pixels, alphaMask);
+			result = _mm256_or_si256(result, red);
+			result = _mm256_or_si256(result, _mm256_slli_epi32(green, 8));
+			result = _mm256_or_si256(result, _mm256_slli_epi32(blue, 16));
+
+			_mm256_storeu_si256((__m256i*)(rgba + i * 4), result);
+		}
+
+		srgbToLinearScalar(rgba, i, pixelCount);
+	}
+
+	ENGINE_TARGET_AVX2 static void swizzleAVX2(uint8_t* rgba, const size_t pixelCount, const uint8_t order[4]) {
+		const __m256i shuffle = _mm256_broadcastsi128_si256(swizzlePattern(order));
+
+		size_t i = 0;
+		for (; i + 8 <= pixelCount; i += 8) {
+			const __m256i pixels = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+			_mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+		}
+
+		swizzleScalar(rgba, i, pixelCount, order);
+	}
+
+	ENGINE_TARGET_AVX2 static __m256i downsampleQuadAVX2(const uint8_t* top, const uint8_t* bottom) {
+		const __m256i zero = _mm256_setzero_si256();
+
+		const __m256i upper = _mm256_loadu_si256((const __m256i*)top);
+		const __m256i lower = _mm256_loadu_si256((const __m256i*)bottom);
+
+		// Lanes hold input pixels [0 1 | 4 5] and [2 3 | 6 7].
+		const __m256i low = _mm256_add_epi16(_mm256_unpacklo_epi8(upper, zero), _mm256_unpacklo_epi8(lower, zero));
+		const __m256i high = _mm256_add_epi16(_mm256_unpackhi_epi8(upper, zero), _mm256_unpackhi_epi8(lower, zero));
+
+		const __m256i lowPairs = _mm256_add_epi16(low, _mm256_srli_si256(low, 8));
+		const __m256i highPairs = _mm256_add_epi16(high, _mm256_srli_si256(high, 8));
+
+		// Output pixels [0 1 | 2 3].
+		const __m256i sums = _mm256_unpacklo_epi64(lowPairs, highPairs);
+		return _mm256_srli_epi16(_mm256_add_epi16(sums, _mm256_set1_epi16(2)), 2);
+	}
+	ENGINE_TARGET_AVX2 static void downsampleAVX2(const uint8_t* row0, const uint8_t* row1, const int width, const int targetWidth, uint8_t* destination) {
+		int x = 0;
+		for (; x + 8 <= targetWidth && (x + 8) * 2 <= width; x += 8) {
+			const __m256i first = downsampleQuadAVX2(row0 + x * 8, row1 + x * 8);
+			const __m256i second = downsampleQuadAVX2(row0 + x * 8 + 32, row1 + x * 8 + 32);
+
+			// Packing gives [0 1 4 5 | 2 3 6 7]; reorder the 64-bit halves.
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)(destination + x * 4), packed);
+		}
+
+		downsampleSSE2(row0 + x * 8, row1 + x * 8, width - x * 2, targetWidth - x, destination + x * 4);
+	}
+#endif
+
+	void ImageProcessing::premultiplyAlpha(uint8_t* rgba, const size_t pixelCount) {
+#ifdef ENGINE_IMAGE_X86
+		if (ImageProcessing::backend == AVX2) return premultiplyAVX2(rgba, pixelCount);
+		if (ImageProcessing::backend == SSE2) return premultiplySSE2(rgba, pixelCount);
+#endif
+		premultiplyScalar(rgba, 0, pixelCount);
+	}
+
+	void ImageProcessing::srgbToLinear(uint8_t* rgba, const size_t pixelCount) {
+		// SSE2 has no gather; the table lookup is already its best option.
+#ifdef ENGINE_IMAGE_X86
+		if (ImageProcessing::backend == AVX2) return srgbToLinearAVX2(rgba, pixelCount);
+#endif
+		srgbToLinearScalar(rgba, 0, pixelCount);
+	}
+
+	void ImageProcessing::swizzle(uint8_t* rgba, const size_t pixelCount, const uint8_t order[4]) {
+#ifdef ENGINE_IMAGE_X86
+		if (ImageProcessing::backend == AVX2) return swizzleAVX2(rgba, pixelCount, order);
+		if (ImageProcessing::backend == SSE2 && hasSSSE3) return swizzleSSSE3(rgba, pixelCount, order);
+#endif
+		swizzleScalar(rgba, 0, pixelCount, order);
+	}
+
+	void ImageProcessing::downsample(const uint8_t* source, const int width, const int height, uint8_t* destination) {
+		const int targetWidth = std::max(width / 2, 1), targetHeight = std::max(height / 2, 1);
+
+		for (int y = 0; y < targetHeight; ++y) {
+			const uint8_t* row0 = source + (size_t)std::min(y * 2, height - 1) * width * 4;
+			const uint8_t* row1 = source + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+			uint8_t* target = destination + (size_t)y * targetWidth * 4;
+
+#ifdef ENGINE_IMAGE_X86
+			if (ImageProcessing::backend == AVX2) {
+				downsampleAVX2(row0, row1, width, targetWidth, target);
+				continue;
+			}
+			if (ImageProcessing::backend == SSE2) {
+				downsampleSSE2(row0, row1, width, targetWidth, target);
+				continue;
+			}
+#endif
+			downsampleScalar(row0, row1, width, 0, targetWidth, target);
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Engine {
+	// RGBA8 pixel work done between decode and upload. Every operation
+	// picks AVX2, SSE2 or plain C++ at runtime, and all three produce
+	// bit-identical results.
+	class ImageProcessing {
+	public:
+		enum Backend {
+			SCALAR = 0,
+			SSE2 = 1,
+			AVX2 = 2
+		};
+	private:
+		static Backend backend;
+	public:
+		static Backend getBackend();
+		static const char* getBackendName(const Backend backend);
+
+		// Lowers the backend, e.g. to compare against the scalar code.
+		// Requests above what the CPU supports are clamped.
+		static void setBackend(const Backend backend);
+
+		// color = round(color * alpha / 255), alpha unchanged.
+		static void premultiplyAlpha(uint8_t* rgba, const size_t pixelCount);
+		// Decodes the sRGB transfer curve of red, green and blue.
+		static void srgbToLinear(uint8_t* rgba, const size_t pixelCount);
+		// Output channel c takes input channel order[c] (0..3), e.g. {2, 1, 0, 3} for BGRA.
+		static void swizzle(uint8_t* rgba, const size_t pixelCount, const uint8_t order[4]);
+		// 2x2 box filter into a max(width / 2, 1) x max(height / 2, 1) image.
+		static void downsample(const uint8_t* source, const int width, const int height, uint8_t* destination);
+	};
+}
@@ -0,0 +1,583 @@
+#include "io.h"
+#include "../arena/arena.h"
+#include "../logger/logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define ENGINE_IO_URING
+#endif
+#endif
+
+namespace Engine {
+	std::atomic<bool> IO::running(false);
+	std::atomic<bool> IO::shuttingDown(false);
+	std::atomic<bool> IO::uring(false);
+	uint32_t IO::queueDepth = 0;
+	std::vector<std::thread> IO::threads;
+
+	std::mutex IO::mutex;
+	std::condition_variable IO::condition;
+	std::deque<IO::Pending> IO::queues[IO::PRIORITY_COUNT];
+	std::deque<IO::Completion> IO::completions;
+
+	std::unordered_set<IO::Request> IO::active;
+	std::unordered_set<IO::Request> IO::cancelled;
+	std::vector<IO::Request> IO::cancelRequests;
+
+	// 0 is never a request, the ring uses it to tag wakeups.
+	IO::Request IO::nextRequest = 1;
+
+#ifdef ENGINE_IO_URING
+	// io_uring through the raw system calls, liburing is not a dependency.
+	struct Ring {
+		int fd = -1;
+		int wakeFd = -1;
+		uint64_t wakeValue = 0;
+
+		void* sqMapping = nullptr;
+		size_t sqMappingSize = 0;
+		void* cqMapping = nullptr;
+		size_t cqMappingSize = 0;
+		io_uring_sqe* sqes = nullptr;
+		size_t sqesSize = 0;
+
+		unsigned* sqHead = nullptr;
+		unsigned* sqTail = nullptr;
+		unsigned* sqArray = nullptr;
+		unsigned sqMask = 0, sqEntries = 0;
+
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		io_uring_cqe* cqes = nullptr;
+		unsigned cqMask = 0;
+	};
+	static Ring ring;
+
+	static const uint64_t WAKE_TAG = 0;
+	static const uint64_t CANCEL_TAG = UINT64_MAX;
+	static const size_t MAX_READ_SIZE = (size_t)1 << 30;
+
+	static void destroyRing() {
+		if (ring.sqes) munmap(ring.sqes, ring.sqesSize);
+		if (ring.cqMapping && ring.cqMapping != ring.sqMapping) munmap(ring.cqMapping, ring.cqMappingSize);
+		if (ring.sqMapping) munmap(ring.sqMapping, ring.sqMappingSize);
+		if (ring.wakeFd >= 0) close(ring.wakeFd);
+		if (ring.fd >= 0) close(ring.fd);
+
+		ring = Ring();
+	}
+	static bool supportsOperations(const int fd) {
+		const unsigned count = 256;
+		std::vector<uint8_t> storage(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op));
+		io_uring_probe* probe = (io_uring_probe*)storage.data();
+
+		if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, count) < 0) return false;
+
+		for (const unsigned operation : { (unsigned)IORING_OP_READ, (unsigned)IORING_OP_ASYNC_CANCEL }) {
+			if (operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED)) return false;
+		}
+
+		return true;
+	}
+	static bool setupRing(const unsigned entries) {
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		// Containers often filter io_uring out; the thread pool covers that.
+		ring.fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (ring.fd < 0) {
+			ring.fd = -1;
+			return false;
+		}
+
+		if (!supportsOperations(ring.fd)) {
+			destroyRing();
+			return false;
+		}
+
+		ring.sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		ring.cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single) {
+			ring.sqMappingSize = ring.cqMappingSize = std::max(ring.sqMappingSize, ring.cqMappingSize);
+		}
+
+		ring.sqMapping = mmap(nullptr, ring.sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+		if (ring.sqMapping == MAP_FAILED) {
+			ring.sqMapping = nullptr;
+			destroyRing();
+			return false;
+		}
+
+		ring.cqMapping = single ? ring.sqMapping : mmap(nullptr, ring.cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+		if (ring.cqMapping == MAP_FAILED) {
+			ring.cqMapping = nullptr;
+			destroyRing();
+			return false;
+		}
+
+		ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		ring.sqes = (io_uring_sqe*)mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+		if (ring.sqes == MAP_FAILED) {
+			ring.sqes = nullptr;
+			destroyRing();
+			return false;
+		}
+
+		uint8_t* sq = (uint8_t*)ring.sqMapping;
+		ring.sqHead = (unsigned*)(sq + params.sq_off.head);
+		ring.sqTail = (unsigned*)(sq + params.sq_off.tail);
+		ring.sqArray = (unsigned*)(sq + params.sq_off.array);
+		ring.sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+		ring.sqEntries = params.sq_entries;
+
+		uint8_t* cq = (uint8_t*)ring.cqMapping;
+		ring.cqHead = (unsigned*)(cq + params.cq_off.head);
+		ring.cqTail = (unsigned*)(cq + params.cq_off.tail);
+		ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+		ring.cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+
+		ring.wakeFd = eventfd(0, EFD_CLOEXEC);
+		if (ring.wakeFd < 0) {
+			ring.wakeFd = -1;
+			destroyRing();
+			return false;
+		}
+
+		return true;
+	}
+	// The ring is sized so that every read in flight, its cancellation and
+	// the wakeup read fit at once, so this cannot run out of entries.
+	static io_uring_sqe* getSqe() {
+		const unsigned tail = *ring.sqTail;
+		const unsigned index = tail & ring.sqMask;
+
+		io_uring_sqe* sqe = &ring.sqes[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		ring.sqArray[index] = index;
+
+		__atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+		return sqe;
+	}
+	static int enterRing() {
+		const unsigned submit = *ring.sqTail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+		return (int)syscall(__NR_io_uring_enter, ring.fd, submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+	}
+#endif
+
+	void IO::init(const uint32_t queueDepth, const size_t threadCount) {
+		if (IO::running) return;
+
+		IO::queueDepth = std::max<uint32_t>(queueDepth, 1);
+		IO::running = true;
+
+#ifdef ENGINE_IO_URING
+		IO::uring = setupRing(IO::queueDepth * 2 + 2);
+#endif
+
+		if (IO::uring) {
+			IO::threads.emplace_back(IO::workUring);
+			return;
+		}
+
+		for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i) {
+			IO::threads.emplace_back(IO::work);
+		}
+	}
+	void IO::shutdown() {
+		if (!IO::running) return;
+
+		IO::shuttingDown = true;
+		IO::running = false;
+		IO::wake();
+
+		for (std::thread& thread : IO::threads) {
+			thread.join();
+		}
+		IO::threads.clear();
+
+#ifdef ENGINE_IO_URING
+		// Also after the ring failed and its thread moved on.
+		if (ring.fd >= 0) destroyRing();
+#endif
+		IO::uring = false;
+
+		// Finished reads are delivered as they are and queued ones are
+		// cancelled. Callbacks may read again, so this repeats until
+		// nothing is left.
+		while (true) {
+			std::vector<Completion> left;
+
+			{
+				std::lock_guard<std::mutex> lock(IO::mutex);
+
+				for (Completion& completion : IO::completions) left.push_back(std::move(completion));
+				IO::completions.clear();
+
+				for (std::deque<Pending>& queue : IO::queues) {
+					for (Pending& pending : queue) left.push_back({ { pending.request, std::move(pending.path), {}, ECANCELED }, std::move(pending.callback) });
+					queue.clear();
+				}
+			}
+
+			if (left.empty()) break;
+
+			for (Completion& completion : left) {
+				if (completion.callback) completion.callback(completion.result);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(IO::mutex);
+		IO::active.clear();
+		IO::cancelled.clear();
+		IO::cancelRequests.clear();
+
+		IO::shuttingDown = false;
+	}
+
+	IO::Request IO::read(const std::string& path, const Priority priority, Callback callback) {
+		return IO::read({ { path, priority, std::move(callback) } }).front();
+	}
+	std::vector<IO::Request> IO::read(const std::vector<ReadInfo>& reads) {
+		if (!IO::running && !IO::shuttingDown) {
+			IO::init(64, 2);
+		}
+
+		std::vector<Request> requests;
+		requests.reserve(reads.size());
+
+		{
+			std::lock_guard<std::mutex> lock(IO::mutex);
+
+			for (const ReadInfo& read : reads) {
+				const Request request = IO::nextRequest++;
+				const size_t priority = std::min<size_t>((size_t)read.priority, PRIORITY_COUNT - 1);
+
+				IO::queues[priority].push_back({ request, read.path, read.callback });
+				requests.push_back(request);
+			}
+		}
+
+		IO::wake();
+		return requests;
+	}
+
+	bool IO::cancel(const Request request) {
+		std::unique_lock<std::mutex> lock(IO::mutex);
+
+		for (std::deque<Pending>& queue : IO::queues) {
+			auto pending = std::find_if(queue.begin(), queue.end(), [request](const Pending& pending) {
+				return pending.request == request;
+			});
+
+			if (pending != queue.end()) {
+				IO::completions.push_back({ { request, pending->path, {}, ECANCELED }, std::move(pending->callback) });
+				queue.erase(pending);
+				return true;
+			}
+		}
+
+		if (IO::active.count(request)) {
+			if (IO::cancelled.insert(request).second) {
+				IO::cancelRequests.push_back(request);
+				lock.unlock();
+				IO::wake();
+			}
+
+			return true;
+		}
+
+		// Finished but not delivered yet.
+		for (Completion& completion : IO::completions) {
+			if (completion.result.request == request && completion.result.error != ECANCELED) {
+				completion.result.data.clear();
+				completion.result.error = ECANCELED;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void IO::update() {
+		// Moved out rather than swapped, so the queue keeps its storage and
+		// a frame without completions allocates nothing.
+		std::pmr::vector<Completion> ready(&FrameArena::get());
+
+		{
+			std::lock_guard<std::mutex> lock(IO::mutex);
+			ready.reserve(IO::completions.size());
+
+			for (Completion& completion : IO::completions) ready.push_back(std::move(completion));
+			IO::completions.clear();
+		}
+
+		for (Completion& completion : ready) {
+			if (completion.callback) completion.callback(completion.result);
+		}
+	}
+
+	size_t IO::getPendingCount() {
+		std::lock_guard<std::mutex> lock(IO::mutex);
+
+		size_t count = IO::active.size();
+		for (const std::deque<Pending>& queue : IO::queues) count += queue.size();
+
+		return count;
+	}
+	const char* IO::getBackendName() {
+		if (!IO::running) return "none";
+		return IO::uring ? "io_uring" : "thread pool";
+	}
+
+	// Expects IO::mutex to be held.
+	bool IO::takePending(Pending& pending) {
+		for (std::deque<Pending>& queue : IO::queues) {
+			if (queue.empty()) continue;
+
+			pending = std::move(queue.front());
+			queue.pop_front();
+
+			IO::active.insert(pending.request);
+			return true;
+		}
+
+		return false;
+	}
+	void IO::complete(Pending& pending, std::vector<std::byte> data, int error) {
+		std::lock_guard<std::mutex> lock(IO::mutex);
+
+		IO::active.erase(pending.request);
+		if (IO::cancelled.erase(pending.request)) {
+			data.clear();
+			error = ECANCELED;
+		}
+
+		IO::completions.push_back({ { pending.request, std::move(pending.path), std::move(data), error }, std::move(pending.callback) });
+	}
+	void IO::wake() {
+#ifdef ENGINE_IO_URING
+		if (IO::uring) {
+			const uint64_t one = 1;
+			if (write(ring.wakeFd, &one, sizeof(one)) < 0) {
+				// The counter only saturates, a wakeup is already pending then.
+			}
+			return;
+		}
+#endif
+
+		IO::condition.notify_all();
+	}
+
+	void IO::work() {
+		while (true) {
+			Pending pending;
+
+			{
+				std::unique_lock<std::mutex> lock(IO::mutex);
+				IO::condition.wait(lock, [] {
+					return !IO::running || std::any_of(std::begin(IO::queues), std::end(IO::queues), [](const std::deque<Pending>& queue) { return !queue.empty(); });
+				});
+
+				if (!IO::running) return;
+
+				IO::takePending(pending);
+			}
+
+			std::vector<std::byte> data;
+			int error = 0;
+
+			errno = 0;
+			std::ifstream stream(pending.path, std::ios::binary | std::ios::ate);
+
+			if (!stream.is_open()) {
+				error = errno ? errno : ENOENT;
+			}
+			else {
+				data = std::vector<std::byte>((size_t)stream.tellg());
+				stream.seekg(0);
+
+				if (!stream.read((char*)data.data(), (std::streamsize)data.size())) {
+					data.clear();
+					error = EIO;
+				}
+			}
+
+			IO::complete(pending, std::move(data), error);
+		}
+	}
+
+	void IO::workUring() {
+#ifdef ENGINE_IO_URING
+		struct Operation {
+			Pending pending;
+			int file;
+			std::vector<std::byte> data;
+			size_t done;
+		};
+
+		std::unordered_map<Request, Operation> operations;
+		bool wakeArmed = false, stopping = false;
+
+		auto submitRead = [](Operation& operation) {
+			io_uring_sqe* sqe = getSqe();
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = operation.file;
+			sqe->addr = (uint64_t)(uintptr_t)(operation.data.data() + operation.done);
+			sqe->len = (uint32_t)std::min(operation.data.size() - operation.done, MAX_READ_SIZE);
+			sqe->off = operation.done;
+			sqe->user_data = operation.pending.request;
+		};
+		auto submitCancel = [](const Request request) {
+			io_uring_sqe* sqe = getSqe();
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = request;
+			sqe->user_data = CANCEL_TAG;
+		};
+		auto finish = [&operations](Operation& operation, const int error) {
+			close(operation.file);
+
+			const Request request = operation.pending.request;
+			IO::complete(operation.pending, error ? std::vector<std::byte>() : std::move(operation.data), error);
+			operations.erase(request);
+		};
+
+		while (true) {
+			if (!IO::running && !stopping) {
+				// Buffers must outlive the kernel's use of them, so in-flight
+				// reads are cancelled and drained before the thread exits.
+				stopping = true;
+				for (const auto& operation : operations) submitCancel(operation.first);
+			}
+			if (stopping && operations.empty()) break;
+
+			if (!wakeArmed) {
+				io_uring_sqe* sqe = getSqe();
+				sqe->opcode = IORING_OP_READ;
+				sqe->fd = ring.wakeFd;
+				sqe->addr = (uint64_t)(uintptr_t)&ring.wakeValue;
+				sqe->len = sizeof(ring.wakeValue);
+				sqe->user_data = WAKE_TAG;
+				wakeArmed = true;
+			}
+
+			if (!stopping) {
+				std::vector<Pending> taken;
+				std::vector<Request> cancels;
+
+				{
+					std::lock_guard<std::mutex> lock(IO::mutex);
+
+					Pending pending;
+					while (operations.size() + taken.size() < IO::queueDepth && IO::takePending(pending)) {
+						taken.push_back(std::move(pending));
+					}
+
+					cancels.swap(IO::cancelRequests);
+				}
+
+				for (Pending& pending : taken) {
+					const int file = open(pending.path.c_str(), O_RDONLY | O_CLOEXEC);
+					if (file < 0) {
+						IO::complete(pending, {}, errno);
+						continue;
+					}
+
+					struct stat info;
+					if (fstat(file, &info) != 0) {
+						const int error = errno;
+						close(file);
+						IO::complete(pending, {}, error);
+						continue;
+					}
+					if (info.st_size == 0) {
+						close(file);
+						IO::complete(pending, {}, 0);
+						continue;
+					}
+
+					const Request request = pending.request;
+					Operation& operation = operations.emplace(request, Operation{ std::move(pending), file, std::vector<std::byte>((size_t)info.st_size), 0 }).first->second;
+					submitRead(operation);
+				}
+
+				for (const Request request : cancels) {
+					if (operations.count(request)) submitCancel(request);
+				}
+			}
+
+			if (enterRing() < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+
+			unsigned head = *ring.cqHead;
+			const unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+			for (; head != tail; ++head) {
+				const io_uring_cqe cqe = ring.cqes[head & ring.cqMask];
+
+				if (cqe.user_data == WAKE_TAG) {
+					wakeArmed = false;
+					continue;
+				}
+				if (cqe.user_data == CANCEL_TAG) continue;
+
+				auto found = operations.find(cqe.user_data);
+				if (found == operations.end()) continue;
+
+				Operation& operation = found->second;
+
+				if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+					submitRead(operation);
+				}
+				else if (cqe.res < 0) {
+					finish(operation, -cqe.res);
+				}
+				else if (cqe.res == 0) {
+					// The file shrank after fstat.
+					operation.data.resize(operation.done);
+					finish(operation, 0);
+				}
+				else {
+					operation.done += (size_t)cqe.res;
+
+					if (operation.done < operation.data.size()) submitRead(operation);
+					else finish(operation, 0);
+				}
+			}
+
+			__atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+		}
+
+		// Only left when the ring failed; the reads never finish.
+		for (auto& operation : operations) {
+			close(operation.second.file);
+			IO::complete(operation.second.pending, {}, ECANCELED);
+		}
+
+		if (!IO::running) return;
+
+		// Queued and later requests go to blocking reads on this thread.
+		// The ring stays mapped until shutdown, as wake() may still be
+		// writing to it.
+		Logger::Log(Logger::WARNING, "TT::IO::workUring: The ring failed, reading files with a blocking thread from now on.");
+
+		IO::uring = false;
+		IO::work();
+#endif
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Engine {
+	// Asynchronous whole-file reads. On Linux requests are handed to the
+	// kernel in batches through io_uring, so many reads are in flight at
+	// once; elsewhere, or when the kernel refuses a ring, a small pool of
+	// threads runs blocking reads instead. Should the ring fail later, its
+	// thread cancels the reads in flight and carries on with blocking
+	// reads.
+	//
+	// Every request's callback runs exactly once, inside update() on the
+	// thread that calls it (the render thread, from Window::swapBuffers),
+	// so callbacks may use GL. shutdown() runs the callbacks left over,
+	// with ECANCELED for requests that did not finish.
+	class IO {
+	public:
+		typedef uint64_t Request;
+
+		enum Priority {
+			HIGH = 0,
+			NORMAL = 1,
+			LOW = 2
+		};
+
+		struct Result {
+			Request request;
+			std::string path;
+
+			std::vector<std::byte> data;
+			// 0, an errno value, or ECANCELED after cancel().
+			int error;
+		};
+		typedef std::function<void(Result& result)> Callback;
+
+		struct ReadInfo {
+			std::string path;
+			Priority priority;
+			Callback callback;
+		};
+	private:
+		struct Pending {
+			Request request;
+			std::string path;
+			Callback callback;
+		};
+		struct Completion {
+			Result result;
+			Callback callback;
+		};
+
+		static const size_t PRIORITY_COUNT = 3;
+
+		static std::atomic<bool> running;
+		// Set while shutdown() runs the callbacks left over; reads made by
+		// those are cancelled as well instead of starting IO again.
+		static std::atomic<bool> shuttingDown;
+		static std::atomic<bool> uring;
+		static uint32_t queueDepth;
+		static std::vector<std::thread> threads;
+
+		static std::mutex mutex;
+		static std::condition_variable condition;
+		static std::deque<Pending> queues[PRIORITY_COUNT];
+		static std::deque<Completion> completions;
+
+		// Taken by a backend but not completed yet.
+		static std::unordered_set<Request> active;
+		static std::unordered_set<Request> cancelled;
+		static std::vector<Request> cancelRequests;
+
+		static Request nextRequest;
+
+		static bool takePending(Pending& pending);
+		static void complete(Pending& pending, std::vector<std::byte> data, int error);
+		static void wake();
+
+		static void work();
+		static void workUring();
+	public:
+		// queueDepth bounds reads in flight on the ring, threadCount sizes
+		// the fallback pool. read() calls init with defaults when needed.
+		static void init(const uint32_t queueDepth, const size_t threadCount);
+		static void shutdown();
+
+		static Request read(const std::string& path, const Priority priority, Callback callback);
+		// Queues all reads under one lock and wakes the backend once.
+		static std::vector<Request> read(const std::vector<ReadInfo>& reads);
+
+		// The callback still runs, with ECANCELED. False when the request
+		// already completed or does not exist.
+		static bool cancel(const Request request);
+
+		static void update();
+
+		static size_t getPendingCount();
+		static const char* getBackendName();
+	};
+}
@@ -0,0 +1,632 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ENGINE_JOBS_FIBERS
+#endif
+
+#if defined(_MSC_VER)
+#define JOBS_NOINLINE __declspec(noinline)
+#else
+#define JOBS_NOINLINE __attribute__((noinline))
+#endif
+
+#ifdef ENGINE_JOBS_FIBERS
+// Pushes the callee-saved registers and the SSE and x87 control words,
+// saves the stack pointer to *from and pops the same off the stack at
+// to. Everything else is caller-saved; unlike swapcontext, no signal
+// mask goes through the kernel.
+extern "C" void engineJobsSwitch(void** from, void* to);
+
+asm(R"(
+	.text
+	.globl engineJobsSwitch
+	.hidden engineJobsSwitch
+	.type engineJobsSwitch, @function
+engineJobsSwitch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size engineJobsSwitch, .-engineJobsSwitch
+)");
+#endif
+
+namespace Engine {
+	std::atomic<bool> Jobs::running(false);
+	std::vector<std::thread> Jobs::workers;
+	std::vector<std::unique_ptr<Jobs::Deque>> Jobs::deques;
+
+	std::mutex Jobs::queueMutex;
+	std::deque<Jobs::Job*> Jobs::queue;
+	std::atomic<size_t> Jobs::queueSize(0);
+
+	std::mutex Jobs::sleepMutex;
+	std::condition_variable Jobs::sleepCondition;
+	std::atomic<int64_t> Jobs::queued(0);
+	std::atomic<uint32_t> Jobs::sleeping(0);
+
+	thread_local int Jobs::threadIndex = -1;
+
+	std::mutex Jobs::readyMutex;
+	std::deque<Jobs::Fiber*> Jobs::ready;
+	std::atomic<size_t> Jobs::readyCount(0);
+
+	std::mutex Jobs::fiberMutex;
+	std::vector<Jobs::Fiber*> Jobs::fibers;
+	std::vector<Jobs::Fiber*> Jobs::fiberPool;
+	thread_local Jobs::Fiber* Jobs::thisFiber = nullptr;
+	thread_local Jobs::Fiber* Jobs::switchedFrom = nullptr;
+	thread_local Jobs::SwitchAction Jobs::switchAction = Jobs::NONE;
+
+	// Fiber part
+
+	struct Jobs::Fiber {
+#ifdef ENGINE_JOBS_FIBERS
+		// Stack pointer saved by the last switch away from the fiber.
+		void* context;
+
+		// One guard page below the stack turns an overflow into a fault.
+		void* mapping;
+		size_t mappingSize;
+#endif
+
+		// Set by wait() before the fiber parks.
+		Counter* waitCounter;
+
+		Fiber() {
+			this->waitCounter = nullptr;
+
+#ifdef ENGINE_JOBS_FIBERS
+			const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+			this->mappingSize = FIBER_STACK_SIZE + page;
+			this->mapping = mmap(nullptr, this->mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+			if (this->mapping == MAP_FAILED) throw std::bad_alloc();
+			mprotect(this->mapping, page, PROT_NONE);
+
+			// The frame engineJobsSwitch pops on the first switch: default
+			// control words, zeroed registers, then runFiber as the return
+			// address, entered with the stack aligned as after a call.
+			void** stack = (void**)((uint8_t*)this->mapping + this->mappingSize);
+			*--stack = nullptr;
+			*--stack = (void*)&Jobs::runFiber;
+			for (int i = 0; i < 6; ++i) *--stack = nullptr;
+
+			const uint32_t controlWords[2] = { 0x1F80, 0x037F };
+			--stack;
+			std::memcpy(stack, controlWords, sizeof(controlWords));
+
+			this->context = stack;
+#endif
+		}
+		~Fiber() {
+#ifdef ENGINE_JOBS_FIBERS
+			munmap(this->mapping, this->mappingSize);
+#endif
+		}
+	};
+
+#ifdef ENGINE_JOBS_FIBERS
+	// The native stack of each worker, returned to at shutdown.
+	static thread_local void* threadContext = nullptr;
+#endif
+
+	JOBS_NOINLINE int Jobs::currentThread() {
+		return Jobs::threadIndex;
+	}
+	JOBS_NOINLINE Jobs::Fiber* Jobs::currentFiber() {
+		return Jobs::thisFiber;
+	}
+
+	Jobs::Fiber* Jobs::acquireFiber() {
+		std::lock_guard<std::mutex> lock(Jobs::fiberMutex);
+
+		if (!Jobs::fiberPool.empty()) {
+			Fiber* fiber = Jobs::fiberPool.back();
+			Jobs::fiberPool.pop_back();
+			return fiber;
+		}
+
+		Jobs::fibers.push_back(new Fiber());
+		return Jobs::fibers.back();
+	}
+	void Jobs::releaseFiber(Fiber* fiber) {
+		std::lock_guard<std::mutex> lock(Jobs::fiberMutex);
+		Jobs::fiberPool.push_back(fiber);
+	}
+
+	// Switches this thread to fiber, or back to its own stack for null.
+	// The fiber left behind is handed to finishSwitch, which runs on the
+	// other side; until then it is still on its stack and nobody else may
+	// resume it.
+	JOBS_NOINLINE void Jobs::switchTo(Fiber* fiber, const SwitchAction action) {
+#ifdef ENGINE_JOBS_FIBERS
+		Fiber* current = Jobs::thisFiber;
+		Jobs::switchedFrom = current;
+		Jobs::switchAction = action;
+		Jobs::thisFiber = fiber;
+
+		engineJobsSwitch(current ? &current->context : &threadContext, fiber ? fiber->context : threadContext);
+		Jobs::finishSwitch();
+#else
+		(void)fiber;
+		(void)action;
+#endif
+	}
+	// Runs right after every switch, on whichever thread the code that
+	// switched back in is on now.
+	JOBS_NOINLINE void Jobs::finishSwitch() {
+		Fiber* fiber = Jobs::switchedFrom;
+		const SwitchAction action = Jobs::switchAction;
+		Jobs::switchedFrom = nullptr;
+		Jobs::switchAction = NONE;
+
+		if (action == RELEASE) {
+			Jobs::releaseFiber(fiber);
+			return;
+		}
+		if (action != PARK) return;
+
+		// The fiber parked itself in wait(). It is registered only now that
+		// it is off its stack, so no other thread can resume it too early.
+		Counter* counter = fiber->waitCounter;
+		fiber->waitCounter = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+
+			if (counter->value.load(std::memory_order_acquire) > 0) {
+				counter->fibers.push_back(fiber);
+				return;
+			}
+		}
+
+		Jobs::makeReady(fiber);
+	}
+	// Fresh fibers start here; pooled ones are resumed where they left it,
+	// so a fiber taken from the pool carries on as the worker's loop.
+	void Jobs::runFiber() {
+#ifdef ENGINE_JOBS_FIBERS
+		Jobs::finishSwitch();
+
+		while (true) {
+			Jobs::loop();
+			Jobs::switchTo(nullptr, RELEASE);
+		}
+#endif
+	}
+
+	// Counter part
+
+	Jobs::Counter::Counter() : value(0) {
+	}
+
+	bool Jobs::Counter::isDone() const {
+		return this->value.load(std::memory_order_acquire) == 0;
+	}
+
+	// Deque part
+
+	Jobs::Deque::Array::Array(const int64_t capacity) {
+		this->capacity = capacity;
+		this->jobs = std::make_unique<std::atomic<Job*>[]>((size_t)capacity);
+	}
+
+	Jobs::Job* Jobs::Deque::Array::get(const int64_t index) const {
+		return this->jobs[(size_t)(index & (this->capacity - 1))].load(std::memory_order_relaxed);
+	}
+	void Jobs::Deque::Array::put(const int64_t index, Job* job) {
+		this->jobs[(size_t)(index & (this->capacity - 1))].store(job, std::memory_order_relaxed);
+	}
+
+	Jobs::Deque::Deque() : top(0), bottom(0) {
+		this->arrays.push_back(std::make_unique<Array>(1024));
+		this->array.store(this->arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	// Owner only.
+	void Jobs::Deque::push(Job* job) {
+		const int64_t bottom = this->bottom.load(std::memory_order_relaxed);
+		const int64_t top = this->top.load(std::memory_order_acquire);
+		Array* array = this->array.load(std::memory_order_relaxed);
+
+		if (bottom - top > array->capacity - 1) {
+			std::unique_ptr<Array> grown = std::make_unique<Array>(array->capacity * 2);
+			for (int64_t i = top; i < bottom; ++i) grown->put(i, array->get(i));
+
+			array = grown.get();
+			this->arrays.push_back(std::move(grown));
+			this->array.store(array, std::memory_order_release);
+		}
+
+		array->put(bottom, job);
+		std::atomic_thread_fence(std::memory_order_release);
+		this->bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	// Owner only.
+	Jobs::Job* Jobs::Deque::pop() {
+		const int64_t bottom = this->bottom.load(std::memory_order_relaxed) - 1;
+		Array* array = this->array.load(std::memory_order_relaxed);
+
+		this->bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		int64_t top = this->top.load(std::memory_order_relaxed);
+
+		if (top > bottom) {
+			this->bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = array->get(bottom);
+
+		// The last job may be stolen at the same time; the top decides.
+		if (top == bottom) {
+			if (!this->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			this->bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		return job;
+	}
+	Jobs::Job* Jobs::Deque::steal() {
+		int64_t top = this->top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = this->bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom) return nullptr;
+
+		Array* array = this->array.load(std::memory_order_acquire);
+		Job* job = array->get(top);
+
+		if (!this->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+
+		return job;
+	}
+
+	int64_t Jobs::Deque::size() const {
+		return std::max<int64_t>(this->bottom.load(std::memory_order_relaxed) - this->top.load(std::memory_order_relaxed), 0);
+	}
+
+	// Scheduler part
+
+	void Jobs::init(const size_t workerCount) {
+		if (Jobs::running) return;
+
+		const size_t cores = std::thread::hardware_concurrency();
+		const size_t count = workerCount ? workerCount : std::max<size_t>(cores > 1 ? cores - 1 : 1, 1);
+
+		for (size_t i = 0; i <= count; ++i) {
+			Jobs::deques.push_back(std::make_unique<Deque>());
+		}
+
+		Jobs::threadIndex = 0;
+		Jobs::running = true;
+
+		for (size_t i = 1; i <= count; ++i) {
+			Jobs::workers.emplace_back(Jobs::work, (int)i);
+		}
+	}
+	void Jobs::shutdown() {
+		if (!Jobs::running) return;
+
+		{
+			std::lock_guard<std::mutex> lock(Jobs::sleepMutex);
+			Jobs::running = false;
+		}
+		Jobs::sleepCondition.notify_all();
+
+		for (std::thread& worker : Jobs::workers) {
+			worker.join();
+		}
+		Jobs::workers.clear();
+
+		// Jobs that never ran are dropped.
+		for (std::unique_ptr<Deque>& deque : Jobs::deques) {
+			while (Job* job = deque->steal()) delete job;
+		}
+		Jobs::deques.clear();
+
+		for (Job* job : Jobs::queue) delete job;
+		Jobs::queue.clear();
+		Jobs::queueSize = 0;
+
+		// Fibers still parked on a counter are dropped with their stacks.
+		Jobs::ready.clear();
+		Jobs::readyCount = 0;
+		Jobs::queued = 0;
+
+		for (Fiber* fiber : Jobs::fibers) delete fiber;
+		Jobs::fibers.clear();
+		Jobs::fiberPool.clear();
+
+		Jobs::threadIndex = -1;
+	}
+
+	void Jobs::run(Function function, Counter* counter) {
+		if (!Jobs::running) {
+			Jobs::init(0);
+		}
+
+		if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+		Jobs::schedule(new Job{ std::move(function), counter });
+	}
+	void Jobs::run(Function function, Counter* counter, Counter& dependency) {
+		if (!Jobs::running) {
+			Jobs::init(0);
+		}
+
+		if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+		Job* job = new Job{ std::move(function), counter };
+
+		{
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+
+			if (dependency.value.load(std::memory_order_acquire) > 0) {
+				dependency.dependents.push_back(job);
+				return;
+			}
+		}
+
+		Jobs::schedule(job);
+	}
+
+	void Jobs::wait(Counter& counter) {
+		Fiber* fiber = Jobs::currentFiber();
+
+		// The worker goes on with the loop on a fresh fiber, and this one
+		// returns from switchTo once the counter has reached zero.
+		if (fiber && counter.value.load(std::memory_order_acquire) > 0) {
+			fiber->waitCounter = &counter;
+			Jobs::switchTo(Jobs::acquireFiber(), PARK);
+		}
+
+		int idle = 0;
+
+		while (!fiber && counter.value.load(std::memory_order_acquire) > 0) {
+			if (Jobs::runNext()) {
+				idle = 0;
+				continue;
+			}
+
+			if (++idle > 64) std::this_thread::yield();
+		}
+
+		// The job that reached zero may still hold the counter's mutex;
+		// the counter must outlive that before the caller can destroy it.
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	void Jobs::parallelFor(const size_t begin, const size_t end, const size_t grain, const std::function<void(size_t, size_t)>& function) {
+		if (begin >= end) return;
+
+		if (!Jobs::running) {
+			Jobs::init(0);
+		}
+
+		// Up front the range is cut into a few chunks per thread; below that
+		// size it is only split while some worker is asleep and could take
+		// the other half.
+		const size_t minimum = std::max<size_t>(grain, 1);
+		const size_t chunk = std::max(minimum, (end - begin) / (Jobs::getThreadCount() * 4));
+
+		Counter counter;
+		Jobs::split(begin, end, minimum, chunk, function, counter);
+		Jobs::wait(counter);
+	}
+	void Jobs::split(size_t begin, size_t end, const size_t grain, const size_t chunk, const std::function<void(size_t, size_t)>& function, Counter& counter) {
+		while (end - begin > grain && (end - begin > chunk || Jobs::sleeping.load(std::memory_order_relaxed) > 0)) {
+			const size_t middle = begin + (end - begin) / 2;
+
+			Jobs::run([middle, end, grain, chunk, &function, &counter]() {
+				Jobs::split(middle, end, grain, chunk, function, counter);
+			}, &counter);
+
+			end = middle;
+		}
+
+		function(begin, end);
+	}
+
+	size_t Jobs::getThreadCount() {
+		return std::max<size_t>(Jobs::deques.size(), 1);
+	}
+	int Jobs::getThreadIndex() {
+		return Jobs::currentThread();
+	}
+	size_t Jobs::getFiberCount() {
+		std::lock_guard<std::mutex> lock(Jobs::fiberMutex);
+		return Jobs::fibers.size();
+	}
+
+	void Jobs::schedule(Job* job) {
+		Jobs::queued.fetch_add(1, std::memory_order_seq_cst);
+
+		const int index = Jobs::currentThread();
+		if (index >= 0) {
+			Jobs::deques[(size_t)index]->push(job);
+		}
+		else {
+			std::lock_guard<std::mutex> lock(Jobs::queueMutex);
+			Jobs::queue.push_back(job);
+			Jobs::queueSize.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Jobs::wake();
+	}
+	void Jobs::makeReady(Fiber* fiber) {
+		Jobs::queued.fetch_add(1, std::memory_order_seq_cst);
+
+		{
+			std::lock_guard<std::mutex> lock(Jobs::readyMutex);
+			Jobs::ready.push_back(fiber);
+			Jobs::readyCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Jobs::wake();
+	}
+	void Jobs::wake() {
+		if (Jobs::sleeping.load(std::memory_order_seq_cst) > 0) {
+			{
+				std::lock_guard<std::mutex> lock(Jobs::sleepMutex);
+			}
+			Jobs::sleepCondition.notify_one();
+		}
+	}
+	Jobs::Fiber* Jobs::findReady() {
+		if (Jobs::readyCount.load(std::memory_order_relaxed) == 0) return nullptr;
+
+		std::lock_guard<std::mutex> lock(Jobs::readyMutex);
+		if (Jobs::ready.empty()) return nullptr;
+
+		Fiber* fiber = Jobs::ready.front();
+		Jobs::ready.pop_front();
+		Jobs::readyCount.fetch_sub(1, std::memory_order_relaxed);
+		Jobs::queued.fetch_sub(1, std::memory_order_relaxed);
+
+		return fiber;
+	}
+	Jobs::Job* Jobs::find() {
+		Job* job = nullptr;
+		const int index = Jobs::currentThread();
+
+		if (index >= 0) {
+			job = Jobs::deques[(size_t)index]->pop();
+		}
+
+		if (!job && Jobs::queueSize.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(Jobs::queueMutex);
+
+			if (!Jobs::queue.empty()) {
+				job = Jobs::queue.front();
+				Jobs::queue.pop_front();
+				Jobs::queueSize.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		if (!job) {
+			// Victims start at a different deque per thread and call.
+			thread_local uint32_t seed = 2463534242u ^ (uint32_t)(index + 1) * 2654435761u;
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+
+			const size_t count = Jobs::deques.size();
+			for (size_t i = 0; i < count && !job; ++i) {
+				const size_t victim = (seed + i) % count;
+				if ((int)victim == index) continue;
+
+				job = Jobs::deques[victim]->steal();
+			}
+		}
+
+		if (job) Jobs::queued.fetch_sub(1, std::memory_order_relaxed);
+		return job;
+	}
+	void Jobs::execute(Job* job) {
+		job->function();
+
+		Counter* counter = job->counter;
+		delete job;
+
+		if (!counter) return;
+
+		std::vector<Job*> released;
+		std::vector<Fiber*> resumed;
+
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+
+			if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				released.swap(counter->dependents);
+				resumed.swap(counter->fibers);
+			}
+		}
+
+		for (Job* dependent : released) {
+			Jobs::schedule(dependent);
+		}
+		for (Fiber* fiber : resumed) {
+			Jobs::makeReady(fiber);
+		}
+	}
+	// Resumed fibers go first, they hold work that is already half done.
+	// Only workers, which are on a fiber themselves, resume them; the
+	// fiber left behind is idle in the loop and goes back to the pool.
+	bool Jobs::runNext() {
+		if (Jobs::currentFiber()) {
+			if (Fiber* fiber = Jobs::findReady()) {
+				Jobs::switchTo(fiber, RELEASE);
+				return true;
+			}
+		}
+
+		Job* job = Jobs::find();
+		if (!job) return false;
+
+		Jobs::execute(job);
+		return true;
+	}
+	void Jobs::work(const int index) {
+		Jobs::threadIndex = index;
+
+#ifdef ENGINE_JOBS_FIBERS
+		// Returns once a fiber of this thread has left the loop.
+		Jobs::switchTo(Jobs::acquireFiber(), NONE);
+#else
+		Jobs::loop();
+#endif
+	}
+	void Jobs::loop() {
+		int idle = 0;
+
+		while (Jobs::running) {
+			if (Jobs::runNext()) {
+				idle = 0;
+				continue;
+			}
+
+			if (++idle < 64) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(Jobs::sleepMutex);
+			Jobs::sleeping.fetch_add(1, std::memory_order_seq_cst);
+			Jobs::sleepCondition.wait(lock, [] {
+				return !Jobs::running || Jobs::queued.load(std::memory_order_seq_cst) > 0;
+			});
+			Jobs::sleeping.fetch_sub(1, std::memory_order_relaxed);
+
+			idle = 0;
+		}
+	}
+}
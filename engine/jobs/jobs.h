@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Engine {
+	// Work-stealing job scheduler. Every worker owns a Chase-Lev deque: it
+	// pushes and pops at the bottom, idle workers steal from the top. The
+	// thread that calls init() gets a deque too and runs jobs while it
+	// waits; other threads submit through a shared queue.
+	//
+	// On x86-64 Linux workers run their loop on fibers with pooled stacks
+	// and call jobs directly, so a job costs no switch. wait() inside a job
+	// on a worker parks the fiber and the worker carries on with another
+	// from the pool; when the counter reaches zero the parked fiber resumes
+	// on whichever worker gets to it first. Switches save the callee-saved
+	// registers only. Elsewhere, and on threads that are not workers,
+	// wait() runs other jobs in place.
+	class Jobs {
+	private:
+		struct Fiber;
+
+		// What the fiber switched away from needs once it is off its stack.
+		enum SwitchAction {
+			NONE,
+			RELEASE,
+			PARK
+		};
+	public:
+		typedef std::function<void()> Function;
+
+		struct Job;
+
+		// Counts jobs that have not finished. Jobs can wait on a counter
+		// instead of blocking a thread: they are scheduled when it hits zero.
+		class Counter {
+		private:
+			std::atomic<uint32_t> value;
+
+			std::mutex mutex;
+			std::vector<Job*> dependents;
+			std::vector<Fiber*> fibers;
+
+			friend class Jobs;
+		public:
+			Counter();
+
+			Counter(const Counter&) = delete;
+			Counter& operator=(const Counter&) = delete;
+
+			bool isDone() const;
+		};
+
+		struct Job {
+			Function function;
+			Counter* counter;
+		};
+	private:
+		// Ring buffer that grows by copying; old arrays stay alive until
+		// shutdown because a thief may still be reading one.
+		class Deque {
+		private:
+			struct Array {
+				int64_t capacity;
+				std::unique_ptr<std::atomic<Job*>[]> jobs;
+
+				Array(const int64_t capacity);
+
+				Job* get(const int64_t index) const;
+				void put(const int64_t index, Job* job);
+			};
+
+			alignas(64) std::atomic<int64_t> top;
+			alignas(64) std::atomic<int64_t> bottom;
+			std::atomic<Array*> array;
+
+			std::vector<std::unique_ptr<Array>> arrays;
+		public:
+			Deque();
+
+			void push(Job* job);
+			Job* pop();
+			Job* steal();
+
+			int64_t size() const;
+		};
+
+		static std::atomic<bool> running;
+		static std::vector<std::thread> workers;
+		static std::vector<std::unique_ptr<Deque>> deques;
+
+		static std::mutex queueMutex;
+		static std::deque<Job*> queue;
+		static std::atomic<size_t> queueSize;
+
+		static std::mutex sleepMutex;
+		static std::condition_variable sleepCondition;
+		static std::atomic<int64_t> queued;
+		static std::atomic<uint32_t> sleeping;
+
+		static thread_local int threadIndex;
+
+		// Fibers parked by wait() whose counter reached zero.
+		static std::mutex readyMutex;
+		static std::deque<Fiber*> ready;
+		static std::atomic<size_t> readyCount;
+
+		static std::mutex fiberMutex;
+		static std::vector<Fiber*> fibers;
+		static std::vector<Fiber*> fiberPool;
+		static thread_local Fiber* thisFiber;
+		// Left by switchTo for finishSwitch, on the same thread.
+		static thread_local Fiber* switchedFrom;
+		static thread_local SwitchAction switchAction;
+
+		static void schedule(Job* job);
+		static Job* find();
+		static Fiber* findReady();
+		static void makeReady(Fiber* fiber);
+		static void wake();
+		static void execute(Job* job);
+		static bool runNext();
+		static void loop();
+		static void work(const int index);
+
+		static Fiber* acquireFiber();
+		static void releaseFiber(Fiber* fiber);
+		static void switchTo(Fiber* fiber, const SwitchAction action);
+		static void finishSwitch();
+		static void runFiber();
+
+		// Fibers move between threads, so thread locals are read through
+		// calls the compiler cannot cache across a switch.
+		static int currentThread();
+		static Fiber* currentFiber();
+
+		static void split(size_t begin, size_t end, const size_t grain, const size_t chunk, const std::function<void(size_t, size_t)>& function, Counter& counter);
+	public:
+		static const size_t FIBER_STACK_SIZE = 256 * 1024;
+
+		// workerCount 0 uses one worker per core besides the calling thread.
+		// run() calls init(0) when needed.
+		static void init(const size_t workerCount);
+		static void shutdown();
+
+		static void run(Function function, Counter* counter);
+		// Scheduled once dependency reaches zero; counter counts it from now.
+		static void run(Function function, Counter* counter, Counter& dependency);
+
+		// Inside a job this suspends the job's fiber; on other threads it
+		// runs jobs until the counter reaches zero.
+		static void wait(Counter& counter);
+
+		// Calls function(begin, end) on disjoint sub-ranges of at least
+		// grain elements, splitting further only while other workers could
+		// steal the halves. Returns when the whole range is done.
+		static void parallelFor(const size_t begin, const size_t end, const size_t grain, const std::function<void(size_t, size_t)>& function);
+		template<typename Function>
+		static void parallelForEach(const size_t begin, const size_t end, const size_t grain, const Function& function) {
+			Jobs::parallelFor(begin, end, grain, [&function](size_t rangeBegin, size_t rangeEnd) {
+				for (size_t i = rangeBegin; i < rangeEnd; ++i) function(i);
+			});
+		}
+
+		// Threads that run jobs, including the one that called init().
+		static size_t getThreadCount();
+		// 0 for the init() thread, 1..n for workers, -1 elsewhere.
+		static int getThreadIndex();
+		// Fibers created so far; they are pooled, not freed, until shutdown.
+		static size_t getFiberCount();
+	};
+}
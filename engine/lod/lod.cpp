@@ -0,0 +1,463 @@
+#include "lod.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace Engine {
+	// Indexed mesh part
+
+	size_t IndexedMesh::getVertexCount() const {
+		return this->streams.empty() ? 0 : this->streams[0].size() / this->dimensions[0];
+	}
+	glm::vec3 IndexedMesh::getPosition(const uint32_t vertex) const {
+		const float* position = this->streams[0].data() + (size_t)vertex * this->dimensions[0];
+		return glm::vec3(position[0], position[1], this->dimensions[0] >= 3 ? position[2] : 0.0f);
+	}
+
+	static uint64_t hashFloats(uint64_t hash, const float* values, const int count) {
+		for (int i = 0; i < count; ++i) {
+			uint32_t bits;
+			std::memcpy(&bits, values + i, sizeof(bits));
+
+			hash ^= bits;
+			hash *= 0x100000001B3ull;
+		}
+
+		return hash;
+	}
+
+	// For every vertex, the first vertex equal to it.
+	template<typename Hash, typename Equal>
+	static std::vector<uint32_t> findDuplicates(const size_t count, const Hash& hash, const Equal& equal) {
+		size_t capacity = 16;
+		while (capacity < count * 2) capacity *= 2;
+
+		std::vector<uint32_t> table(capacity, UINT32_MAX);
+		std::vector<uint32_t> first(count);
+
+		for (uint32_t vertex = 0; vertex < count; ++vertex) {
+			size_t slot = hash(vertex) & (capacity - 1);
+			while (table[slot] != UINT32_MAX && !equal(table[slot], vertex)) slot = (slot + 1) & (capacity - 1);
+
+			if (table[slot] == UINT32_MAX) table[slot] = vertex;
+			first[vertex] = table[slot];
+		}
+
+		return first;
+	}
+
+	IndexedMesh MeshSimplifier::weld(const std::vector<std::vector<float>>& streams, const std::vector<int>& dimensions) {
+		IndexedMesh mesh;
+		mesh.dimensions = dimensions;
+		mesh.streams.resize(streams.size());
+
+		const size_t count = streams.empty() ? 0 : streams[0].size() / dimensions[0] / 3 * 3;
+
+		const std::vector<uint32_t> first = findDuplicates(count, [&](const uint32_t vertex) {
+			uint64_t hash = 0xCBF29CE484222325ull;
+			for (size_t s = 0; s < streams.size(); ++s) hash = hashFloats(hash, streams[s].data() + (size_t)vertex * dimensions[s], dimensions[s]);
+			return hash;
+		}, [&](const uint32_t a, const uint32_t b) {
+			for (size_t s = 0; s < streams.size(); ++s) {
+				if (std::memcmp(streams[s].data() + (size_t)a * dimensions[s], streams[s].data() + (size_t)b * dimensions[s], dimensions[s] * sizeof(float))) return false;
+			}
+			return true;
+		});
+
+		std::vector<uint32_t> remap(count);
+		uint32_t unique = 0;
+
+		mesh.indices.resize(count);
+		for (uint32_t vertex = 0; vertex < count; ++vertex) {
+			if (first[vertex] == vertex) {
+				remap[vertex] = unique++;
+
+				for (size_t s = 0; s < streams.size(); ++s) {
+					const float* source = streams[s].data() + (size_t)vertex * dimensions[s];
+					mesh.streams[s].insert(mesh.streams[s].end(), source, source + dimensions[s]);
+				}
+			}
+
+			mesh.indices[vertex] = remap[first[vertex]];
+		}
+
+		return mesh;
+	}
+	std::vector<std::vector<float>> MeshSimplifier::unweld(const IndexedMesh& mesh, const std::vector<uint32_t>& indices) {
+		std::vector<std::vector<float>> streams(mesh.streams.size());
+
+		for (size_t s = 0; s < mesh.streams.size(); ++s) {
+			const int dimensions = mesh.dimensions[s];
+			streams[s].reserve(indices.size() * dimensions);
+
+			for (const uint32_t index : indices) {
+				const float* source = mesh.streams[s].data() + (size_t)index * dimensions;
+				streams[s].insert(streams[s].end(), source, source + dimensions);
+			}
+		}
+
+		return streams;
+	}
+
+	// Simplification part
+
+	// Sum of squared distances to weighted planes, kept as the symmetric
+	// matrix A, vector b and constant c of p^T A p + 2 b^T p + c.
+	struct Quadric {
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void addPlane(const glm::dvec3& normal, const double distance, const double weight) {
+			this->a00 += weight * normal.x * normal.x;
+			this->a11 += weight * normal.y * normal.y;
+			this->a22 += weight * normal.z * normal.z;
+			this->a01 += weight * normal.x * normal.y;
+			this->a02 += weight * normal.x * normal.z;
+			this->a12 += weight * normal.y * normal.z;
+			this->b0 += weight * normal.x * distance;
+			this->b1 += weight * normal.y * distance;
+			this->b2 += weight * normal.z * distance;
+			this->c += weight * distance * distance;
+			this->weight += weight;
+		}
+		void add(const Quadric& other) {
+			this->a00 += other.a00;
+			this->a11 += other.a11;
+			this->a22 += other.a22;
+			this->a01 += other.a01;
+			this->a02 += other.a02;
+			this->a12 += other.a12;
+			this->b0 += other.b0;
+			this->b1 += other.b1;
+			this->b2 += other.b2;
+			this->c += other.c;
+			this->weight += other.weight;
+		}
+
+		// Mean squared distance of p to the planes.
+		double evaluate(const glm::vec3& p) const {
+			const double x = p.x, y = p.y, z = p.z;
+			const double result = this->a00 * x * x + this->a11 * y * y + this->a22 * z * z
+				+ 2.0 * (this->a01 * x * y + this->a02 * x * z + this->a12 * y * z)
+				+ 2.0 * (this->b0 * x + this->b1 * y + this->b2 * z) + this->c;
+
+			return this->weight > 0.0 ? std::max(result, 0.0) / this->weight : 0.0;
+		}
+	};
+
+	enum VertexKind : uint8_t {
+		INTERIOR,
+		// On an open edge; moves only along it.
+		BORDER,
+		// On an attribute seam or where edges are not manifold.
+		LOCKED
+	};
+
+	// Borders count more than faces so outlines keep their shape.
+	static const double BORDER_WEIGHT = 10.0;
+
+	static uint64_t edgeKey(const uint32_t a, const uint32_t b) {
+		return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+	}
+
+	std::vector<uint32_t> MeshSimplifier::simplify(const IndexedMesh& mesh, const size_t targetIndexCount, const float targetError, float& error) {
+		const size_t vertexCount = mesh.getVertexCount();
+
+		std::vector<glm::vec3> positions(vertexCount);
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) positions[vertex] = mesh.getPosition(vertex);
+
+		// Vertices sharing a position but not attributes are one point of
+		// the surface: quadrics and topology work on the first of them.
+		const std::vector<uint32_t> point = findDuplicates(vertexCount, [&](const uint32_t vertex) {
+			return hashFloats(0xCBF29CE484222325ull, &positions[vertex].x, 3);
+		}, [&](const uint32_t a, const uint32_t b) {
+			return positions[a] == positions[b];
+		});
+
+		std::vector<uint32_t> indices;
+		indices.reserve(mesh.indices.size());
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+			if (point[a] == point[b] || point[b] == point[c] || point[c] == point[a]) continue;
+
+			indices.insert(indices.end(), { a, b, c });
+		}
+
+		std::vector<VertexKind> kinds(vertexCount, INTERIOR);
+		std::vector<uint32_t> copies(vertexCount, 0);
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) ++copies[point[vertex]];
+
+		std::unordered_map<uint64_t, uint32_t> edges;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) ++edges[edgeKey(point[indices[i + e]], point[indices[i + (e + 1) % 3]])];
+		}
+
+		std::vector<uint32_t> borderEdges(vertexCount, 0);
+		for (const auto& [key, count] : edges) {
+			const uint32_t a = (uint32_t)(key >> 32), b = (uint32_t)key;
+
+			if (count == 1) {
+				++borderEdges[a];
+				++borderEdges[b];
+			}
+			else if (count > 2) {
+				kinds[a] = kinds[b] = LOCKED;
+			}
+		}
+
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+			const uint32_t p = point[vertex];
+
+			if (copies[p] > 1 || kinds[p] == LOCKED) kinds[vertex] = LOCKED;
+			else if (borderEdges[p] == 2) kinds[vertex] = BORDER;
+			else if (borderEdges[p]) kinds[vertex] = LOCKED;
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			const glm::dvec3 a = positions[indices[i]], b = positions[indices[i + 1]], c = positions[indices[i + 2]];
+			const glm::dvec3 cross = glm::cross(b - a, c - a);
+			const double length = glm::length(cross);
+			if (length <= 0.0) continue;
+
+			const glm::dvec3 normal = cross / length;
+			const double distance = -glm::dot(normal, a);
+
+			for (int corner = 0; corner < 3; ++corner) quadrics[point[indices[i + corner]]].addPlane(normal, distance, length * 0.5);
+
+			// Planes through open edges, perpendicular to the face.
+			for (int e = 0; e < 3; ++e) {
+				const uint32_t from = point[indices[i + e]], to = point[indices[i + (e + 1) % 3]];
+				if (edges[edgeKey(from, to)] != 1) continue;
+
+				const glm::dvec3 edge = glm::dvec3(positions[to]) - glm::dvec3(positions[from]);
+				const double edgeLength = glm::length(edge);
+				if (edgeLength <= 0.0) continue;
+
+				const glm::dvec3 side = glm::normalize(glm::cross(edge, normal));
+				const double sideDistance = -glm::dot(side, glm::dvec3(positions[from]));
+
+				quadrics[from].addPlane(side, sideDistance, edgeLength * edgeLength * BORDER_WEIGHT);
+				quadrics[to].addPlane(side, sideDistance, edgeLength * edgeLength * BORDER_WEIGHT);
+			}
+		}
+
+		struct Collapse {
+			uint32_t from, to;
+			double cost;
+		};
+
+		const double limit = (double)targetError * (double)targetError;
+		double worst = 0.0;
+
+		std::vector<uint32_t> offsets(vertexCount + 1), adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> fromNeighbors, toNeighbors;
+
+		const auto canCollapse = [&](const uint32_t from, const uint32_t to) {
+			if (kinds[from] == LOCKED) return false;
+			if (kinds[from] == BORDER) {
+				const auto edge = edges.find(edgeKey(point[from], point[to]));
+				return kinds[to] != INTERIOR && edge != edges.end() && edge->second == 1;
+			}
+			return true;
+		};
+
+		// Passes collapse edges cheapest first, each vertex and its ring at
+		// most once, so the adjacency built at the start stays valid.
+		while (indices.size() > targetIndexCount) {
+			std::fill(offsets.begin(), offsets.end(), 0);
+			for (const uint32_t index : indices) ++offsets[index + 1];
+			for (size_t vertex = 0; vertex < vertexCount; ++vertex) offsets[vertex + 1] += offsets[vertex];
+
+			adjacency.resize(indices.size());
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i) adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+			collapses.clear();
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (int e = 0; e < 3; ++e) {
+					const uint32_t a = indices[i + e], b = indices[i + (e + 1) % 3];
+
+					for (const auto& [from, to] : { std::pair(a, b), std::pair(b, a) }) {
+						if (!canCollapse(from, to)) continue;
+
+						Quadric quadric = quadrics[point[from]];
+						quadric.add(quadrics[point[to]]);
+						collapses.push_back({ from, to, quadric.evaluate(positions[to]) });
+					}
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.cost < b.cost;
+			});
+
+			std::fill(touched.begin(), touched.end(), false);
+
+			const size_t needed = (indices.size() - targetIndexCount + 2) / 3;
+			size_t removed = 0, applied = 0;
+
+			for (const Collapse& collapse : collapses) {
+				if (collapse.cost > limit || removed >= needed) break;
+
+				const uint32_t from = collapse.from, to = collapse.to;
+				if (touched[from] || touched[to]) continue;
+
+				// Link condition: the two ends may only share the vertices
+				// opposite the edge, or the surface pinches.
+				fromNeighbors.clear();
+				toNeighbors.clear();
+				size_t shared = 0;
+
+				for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a) {
+					const uint32_t* triangle = indices.data() + adjacency[a] * 3;
+					if (triangle[0] == to || triangle[1] == to || triangle[2] == to) ++shared;
+					for (int corner = 0; corner < 3; ++corner) fromNeighbors.push_back(point[triangle[corner]]);
+				}
+				for (uint32_t a = offsets[to]; a < offsets[to + 1]; ++a) {
+					const uint32_t* triangle = indices.data() + adjacency[a] * 3;
+					for (int corner = 0; corner < 3; ++corner) toNeighbors.push_back(point[triangle[corner]]);
+				}
+
+				std::sort(fromNeighbors.begin(), fromNeighbors.end());
+				fromNeighbors.erase(std::unique(fromNeighbors.begin(), fromNeighbors.end()), fromNeighbors.end());
+				std::sort(toNeighbors.begin(), toNeighbors.end());
+				toNeighbors.erase(std::unique(toNeighbors.begin(), toNeighbors.end()), toNeighbors.end());
+
+				size_t common = 0;
+				for (const uint32_t neighbor : fromNeighbors) {
+					if (neighbor != point[from] && neighbor != point[to] && std::binary_search(toNeighbors.begin(), toNeighbors.end(), neighbor)) ++common;
+				}
+				if (shared == 0 || common > shared) continue;
+
+				// Remaining faces must not flip or fold over.
+				bool folds = false;
+				for (uint32_t a = offsets[from]; a < offsets[from + 1] && !folds; ++a) {
+					const uint32_t* triangle = indices.data() + adjacency[a] * 3;
+					if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+					glm::vec3 corners[3], moved[3];
+					for (int corner = 0; corner < 3; ++corner) {
+						corners[corner] = positions[triangle[corner]];
+						moved[corner] = triangle[corner] == from ? positions[to] : corners[corner];
+					}
+
+					const glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+					const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+					folds = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+				}
+				if (folds) continue;
+
+				for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a) {
+					uint32_t* triangle = indices.data() + adjacency[a] * 3;
+
+					if (triangle[0] == to || triangle[1] == to || triangle[2] == to) ++removed;
+					for (int corner = 0; corner < 3; ++corner) {
+						touched[triangle[corner]] = true;
+						if (triangle[corner] == from) triangle[corner] = to;
+					}
+				}
+
+				// Edges of from now end at to; where both existed, the
+				// collapsed triangle that held them is gone.
+				for (const uint32_t neighbor : fromNeighbors) {
+					if (neighbor == point[from] || neighbor == point[to]) continue;
+
+					const auto moved = edges.find(edgeKey(point[from], neighbor));
+					const uint32_t count = moved->second;
+					edges.erase(moved);
+
+					const auto existing = edges.find(edgeKey(point[to], neighbor));
+					if (existing != edges.end()) existing->second = existing->second + count - 2;
+					else edges[edgeKey(point[to], neighbor)] = count;
+				}
+				edges.erase(edgeKey(point[from], point[to]));
+
+				quadrics[point[to]].add(quadrics[point[from]]);
+				worst = std::max(worst, collapse.cost);
+				++applied;
+			}
+
+			if (applied == 0) break;
+
+			size_t kept = 0;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+				if (a == b || b == c || c == a) continue;
+
+				indices[kept++] = a;
+				indices[kept++] = b;
+				indices[kept++] = c;
+			}
+			indices.resize(kept);
+		}
+
+		error = (float)std::sqrt(worst);
+		return indices;
+	}
+
+	std::vector<LODLevel> MeshSimplifier::generate(const IndexedMesh& mesh, const size_t maxLevels, const float ratio) {
+		std::vector<LODLevel> levels;
+		levels.push_back({ mesh.indices, 0.0f });
+
+		while (levels.size() < maxLevels) {
+			const size_t previous = levels.back().indices.size();
+			const size_t target = (size_t)(previous / 3 * ratio) * 3;
+			if (target < 3) break;
+
+			float error;
+			std::vector<uint32_t> indices = MeshSimplifier::simplify(mesh, target, FLT_MAX, error);
+			if (indices.size() * 10 > previous * 9) break;
+
+			levels.push_back({ std::move(indices), std::max(error, levels.back().error) });
+		}
+
+		return levels;
+	}
+
+	// Selection part
+
+	LODSelector::LODSelector(const float threshold, const float hysteresis) : threshold(threshold), hysteresis(hysteresis), position(0.0f), scale(1.0f), orthographic(false) {
+	}
+
+	void LODSelector::setCamera(const Camera& camera, const float viewportHeight) {
+		const glm::mat4& projection = camera.getProjection();
+
+		this->position = camera.getPosition();
+		// projection[1][1] is 1 / tan(fov / 2) for perspective cameras and
+		// 2 / (top - bottom) for orthographic ones.
+		this->scale = projection[1][1] * viewportHeight * 0.5f;
+		this->orthographic = projection[3][3] == 1.0f;
+	}
+	void LODSelector::setThreshold(const float threshold) {
+		this->threshold = threshold;
+	}
+	void LODSelector::setHysteresis(const float hysteresis) {
+		this->hysteresis = hysteresis;
+	}
+
+	float LODSelector::getScreenError(const float error, const glm::vec3& center, const float radius, const float scale) const {
+		if (this->orthographic) return error * scale * this->scale;
+
+		const float distance = glm::length(center - this->position) - radius;
+		if (distance <= 0.0f) return FLT_MAX;
+
+		return error * scale * this->scale / distance;
+	}
+	size_t LODSelector::select(const std::vector<float>& errors, const glm::vec3& center, const float radius, const size_t current, const float scale) const {
+		for (size_t level = errors.size(); level-- > 1;) {
+			const float limit = level > current ? this->threshold * (1.0f - this->hysteresis) : this->threshold;
+			if (this->getScreenError(errors[level], center, radius, scale) <= limit) return level;
+		}
+
+		return 0;
+	}
+}
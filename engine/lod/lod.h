@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../include/glm/glm.hpp"
+#include "../camera/camera.h"
+
+namespace Engine {
+	// Vertex streams as a Mesh takes them, one float array per attribute
+	// with stream 0 holding positions, shared through an index list.
+	struct IndexedMesh {
+		std::vector<std::vector<float>> streams;
+		std::vector<int> dimensions;
+		std::vector<uint32_t> indices;
+
+		size_t getVertexCount() const;
+		glm::vec3 getPosition(const uint32_t vertex) const;
+	};
+
+	struct LODLevel {
+		std::vector<uint32_t> indices;
+		// Object space distance the surface may have moved, 0 for the
+		// original.
+		float error;
+	};
+
+	// Quadric error metric simplification (Garland and Heckbert): every
+	// vertex accumulates the planes of its triangles, and edges collapse
+	// cheapest first onto one of their vertices, so vertex data never has
+	// to be interpolated. Vertices on attribute seams or non-manifold
+	// edges stay, open borders only collapse along themselves.
+	//
+	// Works on CPU data only, so it can run offline or on a job.
+	class MeshSimplifier {
+	public:
+		// Merges vertices equal in every stream. Every three vertices of
+		// the input form a triangle.
+		static IndexedMesh weld(const std::vector<std::vector<float>>& streams, const std::vector<int>& dimensions);
+		// Expands indices back to a vertex per corner.
+		static std::vector<std::vector<float>> unweld(const IndexedMesh& mesh, const std::vector<uint32_t>& indices);
+
+		// Collapses edges until at most targetIndexCount indices are left or
+		// the next collapse would move the surface further than
+		// targetError; error receives the largest distance reached.
+		static std::vector<uint32_t> simplify(const IndexedMesh& mesh, const size_t targetIndexCount, const float targetError, float& error);
+
+		// Level 0 is the mesh itself; every further level targets ratio of
+		// the previous level's triangles, simplified from the original.
+		// Stops early once a level removes less than a tenth.
+		static std::vector<LODLevel> generate(const IndexedMesh& mesh, const size_t maxLevels, const float ratio = 0.5f);
+	};
+
+	// Picks the coarsest level whose error projects to at most threshold
+	// pixels. A coarser level than the current one must fit within
+	// threshold * (1 - hysteresis), so objects near a switching distance
+	// do not flicker between levels.
+	class LODSelector {
+	private:
+		float threshold, hysteresis;
+
+		glm::vec3 position;
+		// Pixels per object space unit at distance 1, or at any distance
+		// for orthographic cameras.
+		float scale;
+		bool orthographic;
+	public:
+		LODSelector(const float threshold = 1.0f, const float hysteresis = 0.25f);
+
+		void setCamera(const Camera& camera, const float viewportHeight);
+		void setThreshold(const float threshold);
+		void setHysteresis(const float hysteresis);
+
+		// Pixels covered by error on an object bounded by the sphere;
+		// scale multiplies error for scaled instances.
+		float getScreenError(const float error, const glm::vec3& center, const float radius, const float scale = 1.0f) const;
+		// errors ascending, one per level, as from MeshSimplifier::generate.
+		size_t select(const std::vector<float>& errors, const glm::vec3& center, const float radius, const size_t current, const float scale = 1.0f) const;
+	};
+}
@@ -1,6 +1,9 @@
 #include "logger.h"
+#include "../arena/arena.h"
+#include "../memory/memory.h"
 #include <fstream>
 #include <ctime>
+#include <mutex>
 
 #ifdef __linux__
 // Code for linux
@@ -11,26 +14,64 @@ const std::string FILENAME = ".log";
 const std::string PREFIXs[] = {"[Log] ", "[Warning] ", "[Error] "};
 const std::string COLORS[] = { "\x1B[37m", "\x1B[33m", "\x1B[31m" };
 
-void Logger::Log(const std::int8_t type, const std::string& message) {
+// Kept open, so a log line costs no file buffer allocation.
+static std::mutex fileMutex;
+static std::ofstream& getFile() {
+    static std::ofstream file(FILENAME, std::ios::app);
+    return file;
+}
+
+// The heap, with lines charged to Memory::LOGGER.
+class LoggerResource : public std::pmr::memory_resource {
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        Engine::MemoryScope scope(Engine::Memory::LOGGER);
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+static LoggerResource heapResource;
+
+std::pmr::memory_resource* Logger::getResource() {
+    // Other threads than the render thread may not use the frame arena.
+    if (Engine::FrameArena::isAvailable()) return &Engine::FrameArena::get();
+    return &heapResource;
+}
+std::string_view Logger::getPrefix(const std::int8_t type) {
+    return PREFIXs[type];
+}
+
+void Logger::Write(const std::int8_t type, const std::string_view line) {
+    Engine::MemoryScope scope(Engine::Memory::LOGGER);
+
 #if GAME_DEBUG
-    std::cout << COLORS[type] << PREFIXs[type] << message << COLORS[0] << std::endl;
+    std::cout << COLORS[type] << line << COLORS[0] << std::endl;
 #endif
-    SaveToFile(PREFIXs[type] + message);
+    SaveToFile(line);
 }
 
 
-void Logger::SaveToFile(const std::string& message) {
-    std::ofstream outputFile(FILENAME, std::ios::app);
+void Logger::SaveToFile(const std::string_view message) {
+    std::lock_guard<std::mutex> lock(fileMutex);
+
+    std::ofstream& outputFile = getFile();
     if (outputFile.is_open()) {
         std::time_t currentTime = std::time(nullptr);
         char date[80];
         std::strftime(date, 80, "%Y-%m-%d %H:%M:%S", std::localtime(&currentTime));
         outputFile << date << " " << message << std::endl;
-
-        outputFile.close();
     }
 }
 
 void Logger::ClearFromFile() {
-    std::ofstream outputFile(FILENAME, std::ios::trunc);
+    std::lock_guard<std::mutex> lock(fileMutex);
+
+    std::ofstream& outputFile = getFile();
+    outputFile.close();
+    outputFile.open(FILENAME, std::ios::trunc);
 }
\ No newline at end of file
@@ -1,9 +1,37 @@
 #pragma once
 
+#include <charconv>
+#include <cstdint>
 #include <iostream>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 class Logger {
+private:
+    // The frame arena on the render thread, the heap elsewhere.
+    static std::pmr::memory_resource* getResource();
+    static std::string_view getPrefix(const std::int8_t type);
+    static void Write(const std::int8_t type, const std::string_view line);
+
+    template<typename Part>
+    static void Append(std::pmr::string& line, const Part& part) {
+        if constexpr (std::is_same_v<Part, char>) {
+            line += part;
+        }
+        else if constexpr (std::is_same_v<Part, bool>) {
+            line += part ? "true" : "false";
+        }
+        else if constexpr (std::is_arithmetic_v<Part>) {
+            char digits[32];
+            const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), part);
+            line.append(digits, result.ptr);
+        }
+        else {
+            line += std::string_view(part);
+        }
+    }
 public:
     enum LogType {
         INFO = 0,
@@ -11,7 +39,17 @@ public:
         ERROR = 2
     };
 
-    static void Log(const std::int8_t type, const std::string& message);
-    static void SaveToFile(const std::string& message);
+    // Joins strings and numbers into one line, so call sites pass the
+    // parts instead of concatenating std::strings on the heap; a frame
+    // that logs from the render thread allocates nothing.
+    template<typename... Parts>
+    static void Log(const std::int8_t type, const Parts&... parts) {
+        std::pmr::string line(Logger::getResource());
+        line += Logger::getPrefix(type);
+        (Logger::Append(line, parts), ...);
+
+        Logger::Write(type, line);
+    }
+    static void SaveToFile(const std::string_view message);
     static void ClearFromFile();
-};
\ No newline at end of file
+};
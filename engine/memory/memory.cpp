@@ -0,0 +1,284 @@
+#include "memory.h"
+#include "../logger/logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#define MEMORY_NOINLINE __declspec(noinline)
+#else
+#define MEMORY_NOINLINE __attribute__((noinline))
+#endif
+
+namespace Engine {
+	// Heap part
+
+	// In front of every block, padded so the block keeps the alignment
+	// malloc gives.
+	struct BlockHeader {
+		size_t size;
+		Memory::Tag tag;
+	};
+	static const size_t HEADER_SIZE = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+	static_assert(sizeof(BlockHeader) <= HEADER_SIZE);
+
+	// One cache line each, so threads charging different tags do not
+	// contend. Constant initialized, so allocations made while other
+	// statics are constructed are counted too; the last one is the total.
+	struct alignas(64) HeapCounter {
+		std::atomic<size_t> bytes, peak;
+		std::atomic<uint64_t> allocations;
+	};
+	static HeapCounter heapCounters[Memory::TAG_COUNT + 1];
+
+	static thread_local Memory::Tag currentTag = Memory::GENERAL;
+
+	static void raise(std::atomic<size_t>& peak, const size_t value) {
+		size_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+	static void charge(HeapCounter& counter, const size_t size) {
+		counter.allocations.fetch_add(1, std::memory_order_relaxed);
+		raise(counter.peak, counter.bytes.fetch_add(size, std::memory_order_relaxed) + size);
+	}
+	static void discharge(HeapCounter& counter, const size_t size) {
+		counter.bytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	// Not inlined into operator new and delete: GCC would then see the
+	// header math and std::free on pointers it believes came from new,
+	// and warn about both in every caller.
+	static MEMORY_NOINLINE void* allocateBlock(const size_t size, const Memory::Tag tag) {
+		if (size > SIZE_MAX - HEADER_SIZE) return nullptr;
+
+		std::byte* block = static_cast<std::byte*>(std::malloc(size + HEADER_SIZE));
+		if (!block) return nullptr;
+
+		new (block) BlockHeader{ size, tag };
+		charge(heapCounters[tag], size);
+		charge(heapCounters[Memory::TAG_COUNT], size);
+
+		return block + HEADER_SIZE;
+	}
+	static MEMORY_NOINLINE void freeBlock(void* pointer) {
+		if (!pointer) return;
+
+		std::byte* block = static_cast<std::byte*>(pointer) - HEADER_SIZE;
+		const BlockHeader* header = reinterpret_cast<const BlockHeader*>(block);
+
+		discharge(heapCounters[header->tag], header->size);
+		discharge(heapCounters[Memory::TAG_COUNT], header->size);
+
+		std::free(block);
+	}
+
+	void* Memory::allocate(const size_t size, const Tag tag) {
+		return allocateBlock(size, tag);
+	}
+	void* Memory::reallocate(void* pointer, const size_t size, const Tag tag) {
+		if (!pointer) return allocateBlock(size, tag);
+
+		const BlockHeader* header = reinterpret_cast<const BlockHeader*>(static_cast<std::byte*>(pointer) - HEADER_SIZE);
+
+		void* resized = allocateBlock(size, header->tag);
+		if (!resized) return nullptr;
+
+		std::memcpy(resized, pointer, std::min(size, header->size));
+		freeBlock(pointer);
+
+		return resized;
+	}
+	void Memory::free(void* pointer) {
+		freeBlock(pointer);
+	}
+
+	Memory::Tag Memory::getTag() {
+		return currentTag;
+	}
+	uint64_t Memory::getAllocationCount() {
+		return heapCounters[Memory::TAG_COUNT].allocations.load(std::memory_order_relaxed);
+	}
+
+	MemoryScope::MemoryScope(const Memory::Tag tag) : previous(currentTag) {
+		currentTag = tag;
+	}
+	MemoryScope::~MemoryScope() {
+		currentTag = this->previous;
+	}
+
+	// GL part
+
+	struct TrackedObject {
+		size_t bytes;
+		Memory::Tag tag;
+	};
+
+	// Guards everything below, and the report.
+	static std::mutex memoryMutex;
+
+	static std::unordered_map<uint32_t, TrackedObject> trackedBuffers, trackedTextures;
+	static size_t bufferBytes = 0, textureBytes = 0;
+	static size_t gpuBytes[Memory::TAG_COUNT + 1] = {}, gpuPeaks[Memory::TAG_COUNT + 1] = {};
+
+	static size_t budgets[Memory::TAG_COUNT] = {};
+
+	static void untrack(std::unordered_map<uint32_t, TrackedObject>& objects, size_t& total, const uint32_t id) {
+		const auto object = objects.find(id);
+		if (object == objects.end()) return;
+
+		total -= object->second.bytes;
+		gpuBytes[object->second.tag] -= object->second.bytes;
+		gpuBytes[Memory::TAG_COUNT] -= object->second.bytes;
+
+		objects.erase(object);
+	}
+	static void track(std::unordered_map<uint32_t, TrackedObject>& objects, size_t& total, const uint32_t id, const size_t bytes, const Memory::Tag tag) {
+		if (!id) return;
+
+		untrack(objects, total, id);
+		objects[id] = { bytes, tag };
+
+		total += bytes;
+		for (const size_t index : { (size_t)tag, (size_t)Memory::TAG_COUNT }) {
+			gpuBytes[index] += bytes;
+			gpuPeaks[index] = std::max(gpuPeaks[index], gpuBytes[index]);
+		}
+	}
+
+	void Memory::trackBuffer(const uint32_t id, const size_t bytes, const Tag tag) {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		track(trackedBuffers, bufferBytes, id, bytes, tag);
+	}
+	void Memory::untrackBuffer(const uint32_t id) {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		untrack(trackedBuffers, bufferBytes, id);
+	}
+	void Memory::trackTexture(const uint32_t id, const size_t bytes, const Tag tag) {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		track(trackedTextures, textureBytes, id, bytes, tag);
+	}
+	void Memory::untrackTexture(const uint32_t id) {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		untrack(trackedTextures, textureBytes, id);
+	}
+
+	// Report part
+
+	static MemoryReport report = {};
+	static uint64_t allocationMarks[Memory::TAG_COUNT + 1] = {};
+
+	static const char* TAG_NAMES[Memory::TAG_COUNT] = { "general", "logger", "mesh", "texture", "shader", "frame" };
+
+	static void fill(MemoryCounters& counters, const size_t index) {
+		const HeapCounter& heap = heapCounters[index];
+
+		counters.bytes = heap.bytes.load(std::memory_order_relaxed);
+		counters.peak = heap.peak.load(std::memory_order_relaxed);
+		counters.allocations = heap.allocations.load(std::memory_order_relaxed);
+		counters.frameAllocations = counters.allocations - allocationMarks[index];
+		allocationMarks[index] = counters.allocations;
+
+		counters.gpuBytes = gpuBytes[index];
+		counters.gpuPeak = gpuPeaks[index];
+		counters.budget = index < Memory::TAG_COUNT ? budgets[index] : 0;
+	}
+
+	static std::string formatBytes(const size_t bytes) {
+		char text[32];
+
+		if (bytes >= 1024 * 1024) std::snprintf(text, sizeof(text), "%.2f MiB", bytes / (1024.0 * 1024.0));
+		else if (bytes >= 1024) std::snprintf(text, sizeof(text), "%.2f KiB", bytes / 1024.0);
+		else std::snprintf(text, sizeof(text), "%zu B", bytes);
+
+		return text;
+	}
+
+	bool MemoryReport::isOverBudget(const Memory::Tag tag) const {
+		const MemoryCounters& counters = this->tags[tag];
+		return counters.budget && counters.bytes + counters.gpuBytes > counters.budget;
+	}
+	bool MemoryReport::isOverBudget() const {
+		for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) {
+			if (this->isOverBudget((Memory::Tag)tag)) return true;
+		}
+
+		return false;
+	}
+
+	void Memory::setBudget(const Tag tag, const size_t bytes) {
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		budgets[tag] = bytes;
+	}
+
+	void Memory::endFrame() {
+		bool crossed[Memory::TAG_COUNT] = {};
+
+		{
+			std::lock_guard<std::mutex> lock(memoryMutex);
+
+			bool wasOver[Memory::TAG_COUNT];
+			for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) wasOver[tag] = report.isOverBudget((Tag)tag);
+
+			++report.frame;
+			for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) fill(report.tags[tag], tag);
+			fill(report.total, Memory::TAG_COUNT);
+
+			report.bufferBytes = bufferBytes;
+			report.textureBytes = textureBytes;
+
+			for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) crossed[tag] = !wasOver[tag] && report.isOverBudget((Tag)tag);
+		}
+
+		// Once per crossing, or an over budget tag would flood the log.
+		for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) {
+			if (!crossed[tag]) continue;
+
+			const MemoryCounters& counters = report.tags[tag];
+			Logger::Log(Logger::WARNING, "TT::Memory::endFrame: ", TAG_NAMES[tag], " uses ", formatBytes(counters.bytes + counters.gpuBytes), " of its ", formatBytes(counters.budget), " budget.");
+		}
+	}
+	const MemoryReport& Memory::getReport() {
+		return report;
+	}
+	void Memory::log() {
+		const auto line = [](const char* name, const MemoryCounters& counters) {
+			std::string text = std::string("TT::Memory::log: ") + name + ": heap " + formatBytes(counters.bytes) + " (peak " + formatBytes(counters.peak) + "), "
+				+ std::to_string(counters.frameAllocations) + " allocations last frame, GL " + formatBytes(counters.gpuBytes) + " (peak " + formatBytes(counters.gpuPeak) + ")";
+			if (counters.budget) text += ", budget " + formatBytes(counters.budget);
+
+			Logger::Log(Logger::INFO, text, ".");
+		};
+
+		Logger::Log(Logger::INFO, "TT::Memory::log: Frame ", report.frame, ", GL buffers ", formatBytes(report.bufferBytes), ", GL textures ", formatBytes(report.textureBytes), ".");
+
+		for (size_t tag = 0; tag < Memory::TAG_COUNT; ++tag) line(TAG_NAMES[tag], report.tags[tag]);
+		line("total", report.total);
+	}
+
+	const char* Memory::getTagName(const Tag tag) {
+		return tag < Memory::TAG_COUNT ? TAG_NAMES[tag] : "unknown";
+	}
+}
+
+// Global operator new part
+
+// new[], the nothrow forms and sized delete all forward to these.
+// Over-aligned allocations keep the standard library's own operators
+// and are not counted.
+void* operator new(std::size_t size) {
+	if (void* pointer = Engine::allocateBlock(size ? size : 1, Engine::currentTag)) return pointer;
+	throw std::bad_alloc();
+}
+void operator delete(void* pointer) noexcept {
+	Engine::freeBlock(pointer);
+}
+void operator delete(void* pointer, std::size_t) noexcept {
+	Engine::freeBlock(pointer);
+}
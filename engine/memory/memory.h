@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace Engine {
+	struct MemoryCounters {
+		// Live heap bytes and the most there ever were.
+		size_t bytes, peak;
+		// Heap allocations since the program started, and during the
+		// frame the last endFrame() ended.
+		uint64_t allocations, frameAllocations;
+
+		// Bytes of GL buffers and textures, as given to track*().
+		size_t gpuBytes, gpuPeak;
+
+		// 0 when the tag has no budget.
+		size_t budget;
+	};
+	struct MemoryReport;
+
+	// Charges memory to the subsystems using it. The engine's global
+	// operator new keeps the size and tag in front of every block, so
+	// heap memory is charged to the tag of the MemoryScope active on the
+	// allocating thread and given back to the same tag when freed, on any
+	// thread. GL memory is not visible to the heap; whoever creates a
+	// buffer or texture reports its size with trackBuffer or trackTexture.
+	//
+	// Window::swapBuffers calls endFrame(), which takes the report and
+	// warns once when a tag goes over its budget; soak tests can check
+	// getReport() every frame instead.
+	class Memory {
+	public:
+		enum Tag : uint8_t {
+			GENERAL,
+			LOGGER,
+			MESH,
+			TEXTURE,
+			SHADER,
+			FRAME,
+			TAG_COUNT
+		};
+
+		// For C libraries, stb_image among them: blocks are counted like
+		// those from operator new. reallocate keeps the block's tag and
+		// takes the given one for a null pointer.
+		static void* allocate(const size_t size, const Tag tag);
+		static void* reallocate(void* pointer, const size_t size, const Tag tag);
+		static void free(void* pointer);
+
+		// Tracking a name again replaces its size, as glBufferData does.
+		// Untracking a name that is not tracked does nothing.
+		static void trackBuffer(const uint32_t id, const size_t bytes, const Tag tag);
+		static void untrackBuffer(const uint32_t id);
+		static void trackTexture(const uint32_t id, const size_t bytes, const Tag tag);
+		static void untrackTexture(const uint32_t id);
+
+		static void setBudget(const Tag tag, const size_t bytes);
+
+		static void endFrame();
+		// As of the last endFrame().
+		static const MemoryReport& getReport();
+		static void log();
+
+		static Tag getTag();
+		static const char* getTagName(const Tag tag);
+		// operator new calls since the program started.
+		static uint64_t getAllocationCount();
+	};
+
+	struct MemoryReport {
+		uint64_t frame;
+
+		std::array<MemoryCounters, Memory::TAG_COUNT> tags;
+		MemoryCounters total;
+
+		size_t bufferBytes, textureBytes;
+
+		// Heap and GL bytes together are held against the budget.
+		bool isOverBudget(const Memory::Tag tag) const;
+		bool isOverBudget() const;
+	};
+
+	// Charges this thread's allocations to a tag until destroyed; scopes
+	// nest.
+	class MemoryScope {
+	private:
+		Memory::Tag previous;
+	public:
+		MemoryScope(const Memory::Tag tag);
+		~MemoryScope();
+
+		MemoryScope(const MemoryScope&) = delete;
+		MemoryScope& operator=(const MemoryScope&) = delete;
+	};
+}
@@ -0,0 +1,476 @@
+#include "occlusion.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ENGINE_OCCLUSION_X86
+#include <immintrin.h>
+#define ENGINE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Engine {
+	// Backend part
+
+	static OcclusionBuffer::Backend detectBackend() {
+#ifdef ENGINE_OCCLUSION_X86
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? OcclusionBuffer::AVX2 : OcclusionBuffer::SSE2;
+#else
+		return OcclusionBuffer::SCALAR;
+#endif
+	}
+
+	OcclusionBuffer::Backend OcclusionBuffer::backend = detectBackend();
+
+	OcclusionBuffer::Backend OcclusionBuffer::getBackend() {
+		return OcclusionBuffer::backend;
+	}
+	const char* OcclusionBuffer::getBackendName(const Backend backend) {
+		switch (backend) {
+		case SCALAR:
+			return "scalar";
+		case SSE2:
+			return "SSE2";
+		case AVX2:
+			return "AVX2";
+		}
+
+		return "unknown";
+	}
+	void OcclusionBuffer::setBackend(const Backend backend) {
+		OcclusionBuffer::backend = std::min(backend, detectBackend());
+	}
+
+	// Rasterization part
+
+	// Edge functions and depth as planes over pixel centers:
+	// value = x * px + y * py + c. Inside the triangle all three edges
+	// are >= 0.
+	struct TriangleSetup {
+		float edgeX[3], edgeY[3], edgeC[3];
+		float depthX, depthY, depthC;
+		// Columns cover whole blocks of 8 so every backend touches the same
+		// pixels; the padded pitch keeps that inside the row.
+		int minX, maxX, minY, maxY;
+	};
+
+	// Every backend evaluates a pixel with the same operations in the same
+	// order, and products are separate statements so compilers cannot
+	// fuse them into FMAs, so the depth buffers match exactly.
+
+	static void rasterizeScalar(const TriangleSetup& setup, OcclusionBuffer::Level& level) {
+		for (int y = setup.minY; y <= setup.maxY; ++y) {
+			const float py = (float)y + 0.5f;
+			float rows[3];
+			for (int e = 0; e < 3; ++e) {
+				const float row = setup.edgeY[e] * py;
+				rows[e] = row + setup.edgeC[e];
+			}
+			const float depthRow = setup.depthY * py;
+			const float rowDepth = depthRow + setup.depthC;
+
+			float* depth = level.depth.data() + (size_t)y * level.stride;
+
+			for (int x = setup.minX; x <= setup.maxX; ++x) {
+				const float px = (float)x + 0.5f;
+				const float x0 = setup.edgeX[0] * px;
+				const float x1 = setup.edgeX[1] * px;
+				const float x2 = setup.edgeX[2] * px;
+				const float xDepth = setup.depthX * px;
+				const float z = xDepth + rowDepth;
+
+				if (x0 + rows[0] >= 0.0f && x1 + rows[1] >= 0.0f && x2 + rows[2] >= 0.0f && z < depth[x]) depth[x] = z;
+			}
+		}
+	}
+
+#ifdef ENGINE_OCCLUSION_X86
+	static void rasterizeSSE2(const TriangleSetup& setup, OcclusionBuffer::Level& level) {
+		const __m128 edgeX0 = _mm_set1_ps(setup.edgeX[0]);
+		const __m128 edgeX1 = _mm_set1_ps(setup.edgeX[1]);
+		const __m128 edgeX2 = _mm_set1_ps(setup.edgeX[2]);
+		const __m128 depthX = _mm_set1_ps(setup.depthX);
+		const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (int y = setup.minY; y <= setup.maxY; ++y) {
+			const float py = (float)y + 0.5f;
+			float rows[3];
+			for (int e = 0; e < 3; ++e) {
+				const float row = setup.edgeY[e] * py;
+				rows[e] = row + setup.edgeC[e];
+			}
+			const float depthRow = setup.depthY * py;
+
+			const __m128 row0 = _mm_set1_ps(rows[0]);
+			const __m128 row1 = _mm_set1_ps(rows[1]);
+			const __m128 row2 = _mm_set1_ps(rows[2]);
+			const __m128 rowDepth = _mm_set1_ps(depthRow + setup.depthC);
+
+			float* depth = level.depth.data() + (size_t)y * level.stride;
+
+			for (int x = setup.minX; x <= setup.maxX; x += 4) {
+				const __m128 px = _mm_add_ps(_mm_set1_ps((float)x + 0.5f), offsets);
+				const __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeX0, px), row0);
+				const __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeX1, px), row1);
+				const __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeX2, px), row2);
+				const __m128 z = _mm_add_ps(_mm_mul_ps(depthX, px), rowDepth);
+
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				const __m128 old = _mm_loadu_ps(depth + x);
+				const __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+
+				_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(nearer, z), _mm_andnot_ps(nearer, old)));
+			}
+		}
+	}
+
+	ENGINE_TARGET_AVX2 static void rasterizeAVX2(const TriangleSetup& setup, OcclusionBuffer::Level& level) {
+		const __m256 edgeX0 = _mm256_set1_ps(setup.edgeX[0]);
+		const __m256 edgeX1 = _mm256_set1_ps(setup.edgeX[1]);
+		const __m256 edgeX2 = _mm256_set1_ps(setup.edgeX[2]);
+		const __m256 depthX = _mm256_set1_ps(setup.depthX);
+		const __m256 offsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (int y = setup.minY; y <= setup.maxY; ++y) {
+			const float py = (float)y + 0.5f;
+			float rows[3];
+			for (int e = 0; e < 3; ++e) {
+				const float row = setup.edgeY[e] * py;
+				rows[e] = row + setup.edgeC[e];
+			}
+			const float depthRow = setup.depthY * py;
+
+			const __m256 row0 = _mm256_set1_ps(rows[0]);
+			const __m256 row1 = _mm256_set1_ps(rows[1]);
+			const __m256 row2 = _mm256_set1_ps(rows[2]);
+			const __m256 rowDepth = _mm256_set1_ps(depthRow + setup.depthC);
+
+			float* depth = level.depth.data() + (size_t)y * level.stride;
+
+			for (int x = setup.minX; x <= setup.maxX; x += 8) {
+				const __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x + 0.5f), offsets);
+				const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(edgeX0, px), row0);
+				const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(edgeX1, px), row1);
+				const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(edgeX2, px), row2);
+				const __m256 z = _mm256_add_ps(_mm256_mul_ps(depthX, px), rowDepth);
+
+				const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+				const __m256 old = _mm256_loadu_ps(depth + x);
+				const __m256 nearer = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+
+				_mm256_storeu_ps(depth + x, _mm256_blendv_ps(old, z, nearer));
+			}
+		}
+	}
+#endif
+
+	void OcclusionBuffer::rasterize(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+		Level& level = this->levels[0];
+		const float width = (float)level.width;
+		const float height = (float)level.height;
+
+		glm::vec3 screen[3];
+		const glm::vec4* clip[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; ++i) {
+			const float inverse = 1.0f / clip[i]->w;
+			screen[i] = glm::vec3((clip[i]->x * inverse * 0.5f + 0.5f) * width, (clip[i]->y * inverse * 0.5f + 0.5f) * height, clip[i]->z * inverse * 0.5f + 0.5f);
+		}
+
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (!(std::fabs(area) > 1e-6f)) return;
+		if (area < 0.0f) {
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		// Entirely beyond the far plane: nothing to write.
+		if (std::min(screen[0].z, std::min(screen[1].z, screen[2].z)) >= 1.0f) return;
+
+		TriangleSetup setup;
+
+		// Pixels whose centers can be inside.
+		const float minX = std::min(screen[0].x, std::min(screen[1].x, screen[2].x));
+		const float maxX = std::max(screen[0].x, std::max(screen[1].x, screen[2].x));
+		const float minY = std::min(screen[0].y, std::min(screen[1].y, screen[2].y));
+		const float maxY = std::max(screen[0].y, std::max(screen[1].y, screen[2].y));
+
+		if (maxX < 0.5f || maxY < 0.5f || minX > width - 0.5f || minY > height - 0.5f) return;
+
+		setup.minX = std::max(0, (int)std::ceil(minX - 0.5f)) & ~7;
+		setup.maxX = std::min((int)level.width - 1, (int)std::floor(maxX - 0.5f)) | 7;
+		setup.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+		setup.maxY = std::min((int)level.height - 1, (int)std::floor(maxY - 0.5f));
+
+		if (setup.minY > setup.maxY) return;
+
+		for (int e = 0; e < 3; ++e) {
+			const glm::vec3& from = screen[e];
+			const glm::vec3& to = screen[(e + 1) % 3];
+
+			setup.edgeX[e] = from.y - to.y;
+			setup.edgeY[e] = to.x - from.x;
+			setup.edgeC[e] = -(setup.edgeX[e] * from.x + setup.edgeY[e] * from.y);
+		}
+
+		const glm::vec3 edge1 = screen[1] - screen[0];
+		const glm::vec3 edge2 = screen[2] - screen[0];
+		setup.depthX = (edge1.z * edge2.y - edge2.z * edge1.y) / area;
+		setup.depthY = (edge1.x * edge2.z - edge2.x * edge1.z) / area;
+		setup.depthC = screen[0].z - setup.depthX * screen[0].x - setup.depthY * screen[0].y;
+
+#ifdef ENGINE_OCCLUSION_X86
+		if (OcclusionBuffer::backend == AVX2) return rasterizeAVX2(setup, level);
+		if (OcclusionBuffer::backend == SSE2) return rasterizeSSE2(setup, level);
+#endif
+		rasterizeScalar(setup, level);
+	}
+	void OcclusionBuffer::clipAndRasterize(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+		// Only the near plane needs clipping: it keeps w positive, and the
+		// bounding rectangle is clamped to the screen anyway.
+		const glm::vec4 input[3] = { a, b, c };
+		const float distances[3] = { a.z + a.w, b.z + b.w, c.z + c.w };
+
+		if (distances[0] >= 0.0f && distances[1] >= 0.0f && distances[2] >= 0.0f) return this->rasterize(a, b, c);
+
+		glm::vec4 output[4];
+		int count = 0;
+
+		for (int i = 0; i < 3; ++i) {
+			const int next = (i + 1) % 3;
+
+			if (distances[i] >= 0.0f) output[count++] = input[i];
+			if ((distances[i] >= 0.0f) != (distances[next] >= 0.0f)) {
+				const float t = distances[i] / (distances[i] - distances[next]);
+				output[count++] = input[i] + (input[next] - input[i]) * t;
+			}
+		}
+
+		if (count >= 3) this->rasterize(output[0], output[1], output[2]);
+		if (count == 4) this->rasterize(output[0], output[2], output[3]);
+	}
+
+	// Buffer part
+
+	OcclusionBuffer::OcclusionBuffer(const uint32_t width, const uint32_t height) : viewProjection(1.0f) {
+		this->resize(width, height);
+	}
+
+	void OcclusionBuffer::resize(uint32_t width, uint32_t height) {
+		width = std::max(width, 1u);
+		height = std::max(height, 1u);
+
+		this->levels.clear();
+
+		const uint32_t stride = (width + 7) & ~7u;
+		this->levels.push_back({ width, height, stride, std::vector<float>((size_t)stride * height, 1.0f) });
+
+		while (width > 1 || height > 1) {
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+			this->levels.push_back({ width, height, width, std::vector<float>((size_t)width * height, 1.0f) });
+		}
+	}
+
+	void OcclusionBuffer::begin(const glm::mat4& viewProjection) {
+		this->viewProjection = viewProjection;
+		std::fill(this->levels[0].depth.begin(), this->levels[0].depth.end(), 1.0f);
+	}
+	void OcclusionBuffer::addOccluder(const std::vector<float>& vertices, const int dimensions, const glm::mat4& model) {
+		const glm::mat4 transform = this->viewProjection * model;
+		const size_t triangleCount = vertices.size() / dimensions / 3;
+
+		for (size_t triangle = 0; triangle < triangleCount; ++triangle) {
+			glm::vec4 clip[3];
+
+			for (int i = 0; i < 3; ++i) {
+				const float* vertex = vertices.data() + (triangle * 3 + i) * dimensions;
+				clip[i] = transform * glm::vec4(vertex[0], vertex[1], dimensions >= 3 ? vertex[2] : 0.0f, 1.0f);
+			}
+
+			this->clipAndRasterize(clip[0], clip[1], clip[2]);
+		}
+	}
+	void OcclusionBuffer::addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& model) {
+		const glm::mat4 transform = this->viewProjection * model;
+
+		// Shared vertices are transformed once.
+		std::vector<glm::vec4> clip(positions.size());
+		for (size_t i = 0; i < positions.size(); ++i) clip[i] = transform * glm::vec4(positions[i], 1.0f);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			this->clipAndRasterize(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]);
+		}
+	}
+	void OcclusionBuffer::end() {
+		for (size_t l = 1; l < this->levels.size(); ++l) {
+			const Level& source = this->levels[l - 1];
+			Level& target = this->levels[l];
+
+			for (uint32_t y = 0; y < target.height; ++y) {
+				const float* row0 = source.depth.data() + (size_t)(2 * y) * source.stride;
+				const float* row1 = source.depth.data() + (size_t)std::min(2 * y + 1, source.height - 1) * source.stride;
+				float* depth = target.depth.data() + (size_t)y * target.stride;
+
+				for (uint32_t x = 0; x < target.width; ++x) {
+					const uint32_t x0 = 2 * x;
+					const uint32_t x1 = std::min(x0 + 1, source.width - 1);
+
+					depth[x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+				}
+			}
+		}
+	}
+
+	// Testing part
+
+	// Screen space bounds of a box's corners; false when the box crosses
+	// the near plane. Corners are the clip position of min plus the clip
+	// space steps along each axis, added in the same order everywhere.
+
+	static bool projectScalar(const glm::mat4& viewProjection, const glm::vec3& min, const glm::vec3& max, glm::vec3& low, glm::vec3& high) {
+		const glm::vec4 base = viewProjection[0] * min.x + viewProjection[1] * min.y + viewProjection[2] * min.z + viewProjection[3];
+		const glm::vec4 stepX = viewProjection[0] * (max.x - min.x);
+		const glm::vec4 stepY = viewProjection[1] * (max.y - min.y);
+		const glm::vec4 stepZ = viewProjection[2] * (max.z - min.z);
+
+		low = glm::vec3(1e30f);
+		high = glm::vec3(-1e30f);
+
+		for (int corner = 0; corner < 8; ++corner) {
+			glm::vec4 clip = base;
+			if (corner & 1) clip += stepX;
+			if (corner & 2) clip += stepY;
+			if (corner & 4) clip += stepZ;
+
+			if (clip.z < -clip.w) return false;
+
+			const float inverse = 1.0f / clip.w;
+			const glm::vec3 ndc(clip.x * inverse, clip.y * inverse, clip.z * inverse);
+			low = glm::min(low, ndc);
+			high = glm::max(high, ndc);
+		}
+
+		return true;
+	}
+
+#ifdef ENGINE_OCCLUSION_X86
+	// The 8 corners one component at a time, 4 corners per register.
+	static bool projectSSE2(const glm::mat4& viewProjection, const glm::vec3& min, const glm::vec3& max, glm::vec3& low, glm::vec3& high) {
+		const glm::vec4 base = viewProjection[0] * min.x + viewProjection[1] * min.y + viewProjection[2] * min.z + viewProjection[3];
+		const glm::vec4 stepX = viewProjection[0] * (max.x - min.x);
+		const glm::vec4 stepY = viewProjection[1] * (max.y - min.y);
+		const glm::vec4 stepZ = viewProjection[2] * (max.z - min.z);
+
+		const __m128 selectX = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1));
+		const __m128 selectY = _mm_castsi128_ps(_mm_setr_epi32(0, 0, -1, -1));
+
+		__m128 lower[4], upper[4];
+		for (int c = 0; c < 4; ++c) {
+			const __m128 x = _mm_add_ps(_mm_set1_ps(base[c]), _mm_and_ps(_mm_set1_ps(stepX[c]), selectX));
+			lower[c] = _mm_add_ps(x, _mm_and_ps(_mm_set1_ps(stepY[c]), selectY));
+			upper[c] = _mm_add_ps(lower[c], _mm_set1_ps(stepZ[c]));
+		}
+
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 behind = _mm_or_ps(_mm_cmplt_ps(lower[2], _mm_xor_ps(lower[3], sign)), _mm_cmplt_ps(upper[2], _mm_xor_ps(upper[3], sign)));
+		if (_mm_movemask_ps(behind)) return false;
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 lowerInverse = _mm_div_ps(one, lower[3]);
+		const __m128 upperInverse = _mm_div_ps(one, upper[3]);
+
+		for (int c = 0; c < 3; ++c) {
+			const __m128 a = _mm_mul_ps(lower[c], lowerInverse);
+			const __m128 b = _mm_mul_ps(upper[c], upperInverse);
+
+			__m128 minimum = _mm_min_ps(a, b), maximum = _mm_max_ps(a, b);
+			minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(1, 0, 3, 2)));
+			maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(1, 0, 3, 2)));
+			minimum = _mm_min_ps(minimum, _mm_shuffle_ps(minimum, minimum, _MM_SHUFFLE(2, 3, 0, 1)));
+			maximum = _mm_max_ps(maximum, _mm_shuffle_ps(maximum, maximum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			low[c] = _mm_cvtss_f32(minimum);
+			high[c] = _mm_cvtss_f32(maximum);
+		}
+
+		return true;
+	}
+#endif
+
+	bool OcclusionBuffer::isVisible(const glm::vec3& min, const glm::vec3& max) const {
+		glm::vec3 low, high;
+
+#ifdef ENGINE_OCCLUSION_X86
+		if (OcclusionBuffer::backend != SCALAR) {
+			if (!projectSSE2(this->viewProjection, min, max, low, high)) return true;
+		}
+		else
+#endif
+		if (!projectScalar(this->viewProjection, min, max, low, high)) return true;
+
+		const float width = (float)this->levels[0].width;
+		const float height = (float)this->levels[0].height;
+
+		const float left = (low.x * 0.5f + 0.5f) * width;
+		const float right = (high.x * 0.5f + 0.5f) * width;
+		const float bottom = (low.y * 0.5f + 0.5f) * height;
+		const float top = (high.y * 0.5f + 0.5f) * height;
+
+		if (right < 0.0f || top < 0.0f || left > width || bottom > height) return false;
+
+		const int x0 = (int)std::floor(std::max(left, 0.0f));
+		const int x1 = (int)std::floor(std::min(right, width - 1.0f));
+		const int y0 = (int)std::floor(std::max(bottom, 0.0f));
+		const int y1 = (int)std::floor(std::min(top, height - 1.0f));
+		const float depth = low.z * 0.5f + 0.5f;
+
+		// The level where the rectangle spans at most 4 texels per axis.
+		const int extent = std::max(x1 - x0, y1 - y0);
+		size_t l = 0;
+		while ((extent >> l) > 2 && l + 1 < this->levels.size()) ++l;
+
+		const Level& level = this->levels[l];
+
+		for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+			const float* row = level.depth.data() + (size_t)y * level.stride;
+
+			for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+				if (depth <= row[x]) return true;
+			}
+		}
+
+		return false;
+	}
+	size_t OcclusionBuffer::test(const BoundingBoxes& boxes, const uint32_t* candidates, const size_t count, uint32_t* visible) const {
+		size_t result = 0;
+
+		for (size_t i = 0; i < count; ++i) {
+			const uint32_t index = candidates[i];
+			const glm::vec3 center(boxes.x[index], boxes.y[index], boxes.z[index]);
+			const glm::vec3 extent(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]);
+
+			if (this->isVisible(center - extent, center + extent)) visible[result++] = index;
+		}
+
+		return result;
+	}
+	void OcclusionBuffer::test(const BoundingBoxes& boxes, std::vector<uint32_t>& visible) const {
+		visible.resize(this->test(boxes, visible.data(), visible.size(), visible.data()));
+	}
+
+	uint32_t OcclusionBuffer::getWidth() const {
+		return this->levels[0].width;
+	}
+	uint32_t OcclusionBuffer::getHeight() const {
+		return this->levels[0].height;
+	}
+	size_t OcclusionBuffer::getLevelCount() const {
+		return this->levels.size();
+	}
+	const OcclusionBuffer::Level& OcclusionBuffer::getLevel(const size_t level) const {
+		return this->levels[level];
+	}
+}
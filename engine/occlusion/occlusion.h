@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../include/glm/glm.hpp"
+#include "../camera/camera.h"
+
+namespace Engine {
+	// Software depth buffer for occlusion culling. Occluder triangles are
+	// rasterized at low resolution, then a pyramid keeping the farthest
+	// depth of every 2x2 block lets a box be tested against a handful of
+	// texels whatever its size on screen.
+	//
+	// Per frame:
+	//   begin(viewProjection), addOccluder() for every occluder, end(),
+	//   then isVisible() or test() for the objects to draw.
+	//
+	// Depths are OpenGL window depths, 0 at the near plane and 1 at the
+	// far plane. Pixels are sampled at their centers, so gaps between
+	// occluders narrower than a pixel may hide what is behind them.
+	class OcclusionBuffer {
+	public:
+		// Rasterizes 8 (AVX2), 4 (SSE2) or 1 pixel per step; all give the
+		// same depth buffer and test results.
+		enum Backend {
+			SCALAR = 0,
+			SSE2 = 1,
+			AVX2 = 2
+		};
+
+		struct Level {
+			uint32_t width, height;
+			// Row pitch in floats; level 0 is padded to a multiple of 8.
+			uint32_t stride;
+			std::vector<float> depth;
+		};
+	private:
+		static Backend backend;
+
+		std::vector<Level> levels;
+		glm::mat4 viewProjection;
+
+		void rasterize(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+		void clipAndRasterize(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+	public:
+		static Backend getBackend();
+		static const char* getBackendName(const Backend backend);
+		// Requests above what the CPU supports are clamped.
+		static void setBackend(const Backend backend);
+
+		OcclusionBuffer(const uint32_t width = 256, const uint32_t height = 128);
+
+		void resize(const uint32_t width, const uint32_t height);
+
+		// Clears depth to the far plane.
+		void begin(const glm::mat4& viewProjection);
+		// Every three vertices form a triangle, as for a GL_TRIANGLES mesh;
+		// dimensions is 2 or 3, 2 meaning z = 0. Both windings are drawn.
+		void addOccluder(const std::vector<float>& vertices, const int dimensions, const glm::mat4& model);
+		void addOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& model);
+		// Builds the pyramid; call before testing.
+		void end();
+
+		// False only when the box is entirely behind occluders or off
+		// screen. Boxes crossing the near plane are always visible.
+		bool isVisible(const glm::vec3& min, const glm::vec3& max) const;
+		// Writes the candidates that are visible to visible, in order, and
+		// returns how many there are. visible may be candidates, so the
+		// result of FrustumCulling::cull can be filtered in place.
+		size_t test(const BoundingBoxes& boxes, const uint32_t* candidates, const size_t count, uint32_t* visible) const;
+		void test(const BoundingBoxes& boxes, std::vector<uint32_t>& visible) const;
+
+		uint32_t getWidth() const;
+		uint32_t getHeight() const;
+		size_t getLevelCount() const;
+		const Level& getLevel(const size_t level) const;
+	};
+}
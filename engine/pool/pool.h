@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+	// Names a slot of a Pool. A slot's generation changes every time its
+	// object is released, so a handle kept past that no longer resolves
+	// instead of reaching whatever took the slot next. Generation 0 is
+	// never handed out, so a default constructed handle is null.
+	template<typename T>
+	struct Handle {
+		uint32_t index = 0;
+		uint32_t generation = 0;
+
+		bool isNull() const {
+			return this->generation == 0;
+		}
+
+		bool operator==(const Handle& other) const = default;
+	};
+
+	// Fixed-size slots for objects of type T, handed out as Handle<Tag>.
+	// Objects live in chunks of CHUNK_SIZE that are never moved or freed
+	// before the pool is, so pointers from get() stay valid for as long as
+	// the handle does and T needs neither copy nor move. Generations and
+	// states are kept apart from the objects in contiguous arrays, so
+	// checking a handle touches one small array.
+	//
+	// release() invalidates the handle at once but only destroys the object
+	// in the next flush(), so a frame's worth of destruction happens in one
+	// place. A pool is not synchronized; use it from one thread.
+	template<typename T, typename Tag = T>
+	class Pool {
+	public:
+		static const uint32_t CHUNK_SIZE = 64;
+	private:
+		enum State : uint8_t {
+			FREE,
+			ALIVE,
+			RELEASED,
+		};
+
+		struct Chunk {
+			alignas(T) std::byte storage[sizeof(T) * CHUNK_SIZE];
+		};
+
+		std::vector<std::unique_ptr<Chunk>> chunks;
+		std::vector<uint32_t> generations;
+		std::vector<State> states;
+
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> releasedSlots;
+		size_t count;
+
+		T* slot(const uint32_t index) const {
+			return std::launder(reinterpret_cast<T*>(this->chunks[index / CHUNK_SIZE]->storage) + index % CHUNK_SIZE);
+		}
+		void free(const uint32_t index) {
+			this->slot(index)->~T();
+			this->states[index] = FREE;
+			this->freeSlots.push_back(index);
+		}
+		void advance(const uint32_t index) {
+			if (++this->generations[index] == 0) this->generations[index] = 1;
+		}
+	public:
+		Pool() : count(0) {
+		}
+		~Pool() {
+			this->clear();
+		}
+
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		template<typename... Arguments>
+		Handle<Tag> create(Arguments&&... arguments) {
+			uint32_t index;
+
+			if (this->freeSlots.empty()) {
+				index = (uint32_t)this->generations.size();
+				if (index % CHUNK_SIZE == 0) this->chunks.push_back(std::make_unique<Chunk>());
+
+				this->generations.push_back(1);
+				this->states.push_back(FREE);
+			}
+			else {
+				index = this->freeSlots.back();
+				this->freeSlots.pop_back();
+			}
+
+			try {
+				new (this->slot(index)) T(std::forward<Arguments>(arguments)...);
+			} catch (...) {
+				this->freeSlots.push_back(index);
+				throw;
+			}
+
+			this->states[index] = ALIVE;
+			++this->count;
+
+			return { index, this->generations[index] };
+		}
+
+		// Null when the handle is null, stale or released.
+		T* get(const Handle<Tag> handle) const {
+			return this->isAlive(handle) ? this->slot(handle.index) : nullptr;
+		}
+		bool isAlive(const Handle<Tag> handle) const {
+			return handle.index < this->generations.size() && this->generations[handle.index] == handle.generation && this->states[handle.index] == ALIVE;
+		}
+
+		// Destroys the object now. Returns false for a handle that is not
+		// alive, so destroying twice is harmless.
+		bool destroy(const Handle<Tag> handle) {
+			if (!this->isAlive(handle)) return false;
+
+			this->advance(handle.index);
+			this->free(handle.index);
+			--this->count;
+
+			return true;
+		}
+		// Invalidates the handle now and destroys the object in flush().
+		bool release(const Handle<Tag> handle) {
+			if (!this->isAlive(handle)) return false;
+
+			this->advance(handle.index);
+			this->states[handle.index] = RELEASED;
+			this->releasedSlots.push_back(handle.index);
+			--this->count;
+
+			return true;
+		}
+		// Destroys every released object; returns how many there were.
+		// The overload taking a function calls it with each object first,
+		// so owners can gather the objects' resources into one batch.
+		size_t flush() {
+			return this->flush([](T&) {});
+		}
+		template<typename Function>
+		size_t flush(Function&& function) {
+			const size_t released = this->releasedSlots.size();
+
+			for (const uint32_t index : this->releasedSlots) {
+				function(*this->slot(index));
+				this->free(index);
+			}
+			this->releasedSlots.clear();
+
+			return released;
+		}
+		// Destroys every object, released or not. Handles handed out
+		// before stay stale.
+		void clear() {
+			this->clear([](T&) {});
+		}
+		template<typename Function>
+		void clear(Function&& function) {
+			for (uint32_t index = 0; index < this->generations.size(); ++index) {
+				if (this->states[index] == FREE) continue;
+				if (this->states[index] == ALIVE) this->advance(index);
+
+				function(*this->slot(index));
+				this->free(index);
+			}
+
+			this->releasedSlots.clear();
+			this->count = 0;
+		}
+
+		// Calls function(handle, object) for every live object in slot order.
+		template<typename Function>
+		void each(Function&& function) {
+			for (uint32_t index = 0; index < this->generations.size(); ++index) {
+				if (this->states[index] == ALIVE) function(Handle<Tag>{ index, this->generations[index] }, *this->slot(index));
+			}
+		}
+
+		size_t getCount() const {
+			return this->count;
+		}
+		size_t getReleasedCount() const {
+			return this->releasedSlots.size();
+		}
+		size_t getCapacity() const {
+			return this->chunks.size() * CHUNK_SIZE;
+		}
+	};
+}
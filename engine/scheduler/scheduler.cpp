@@ -0,0 +1,112 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace Engine {
+	Scheduler::Scheduler(World& world) : world(world), dirty(false) {
+	}
+
+	void Scheduler::add(const std::string& name, const World::Mask& reads, const World::Mask& writes, Function function) {
+		std::unique_ptr<System> system = std::make_unique<System>();
+		system->name = name;
+		system->reads = reads & ~writes;
+		system->writes = writes;
+		system->function = std::move(function);
+		system->dependencyCount = 0;
+		system->remaining = 0;
+		system->time = 0.0;
+
+		this->systems.push_back(std::move(system));
+		this->dirty = true;
+	}
+
+	void Scheduler::build() {
+		for (std::unique_ptr<System>& system : this->systems) {
+			system->dependents.clear();
+			system->dependencyCount = 0;
+		}
+
+		// An earlier system that writes what a later one touches, or reads
+		// what it writes, has to finish first.
+		for (size_t later = 0; later < this->systems.size(); ++later) {
+			System& system = *this->systems[later];
+
+			for (size_t earlier = 0; earlier < later; ++earlier) {
+				System& other = *this->systems[earlier];
+
+				if ((other.writes & (system.reads | system.writes)).any() || (other.reads & system.writes).any()) {
+					other.dependents.push_back(later);
+					++system.dependencyCount;
+				}
+			}
+		}
+
+		this->dirty = false;
+	}
+	void Scheduler::launch(const size_t index, Jobs::Counter& counter) {
+		Jobs::run([this, index, &counter]() {
+			System& system = *this->systems[index];
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			system.function(this->world);
+			system.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			// Successors are queued before this job ends, so the counter
+			// cannot reach zero while systems are still pending.
+			for (size_t dependent : system.dependents) {
+				if (this->systems[dependent]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					this->launch(dependent, counter);
+				}
+			}
+		}, &counter);
+	}
+
+	void Scheduler::run() {
+		if (this->systems.empty()) return;
+		if (this->dirty) this->build();
+
+		Jobs::init(0);
+		if (this->commandBuffers.size() != Jobs::getThreadCount() + 1) {
+			this->commandBuffers.resize(Jobs::getThreadCount() + 1);
+		}
+
+		for (std::unique_ptr<System>& system : this->systems) {
+			system->remaining.store(system->dependencyCount, std::memory_order_relaxed);
+		}
+
+		Jobs::Counter counter;
+
+		for (size_t i = 0; i < this->systems.size(); ++i) {
+			if (this->systems[i]->dependencyCount == 0) this->launch(i, counter);
+		}
+
+		Jobs::wait(counter);
+
+		for (CommandBuffer& commands : this->commandBuffers) commands.apply(this->world);
+	}
+
+	CommandBuffer& Scheduler::getCommands() {
+		return this->commandBuffers[Jobs::getThreadIndex() + 1];
+	}
+
+	size_t Scheduler::getSystemCount() const {
+		return this->systems.size();
+	}
+	const std::string& Scheduler::getSystemName(const size_t index) const {
+		return this->systems[index]->name;
+	}
+	std::vector<size_t> Scheduler::getDependencies(const size_t index) const {
+		std::vector<size_t> dependencies;
+
+		for (size_t i = 0; i < this->systems.size(); ++i) {
+			const std::vector<size_t>& dependents = this->systems[i]->dependents;
+			if (std::find(dependents.begin(), dependents.end(), index) != dependents.end()) dependencies.push_back(i);
+		}
+
+		return dependencies;
+	}
+	double Scheduler::getSystemTime(const size_t index) const {
+		return this->systems[index]->time;
+	}
+}
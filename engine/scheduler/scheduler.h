@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../ecs/ecs.h"
+#include "../jobs/jobs.h"
+
+namespace Engine {
+	// Runs World systems on the job workers. Every system declares the
+	// components it reads and writes; a system waits only for earlier
+	// systems it conflicts with (one writes what the other touches), so
+	// independent systems overlap and query systems also split their chunks
+	// across workers. Registration order decides which of two conflicting
+	// systems goes first.
+	class Scheduler {
+	public:
+		typedef std::function<void(World&)> Function;
+	private:
+		struct System {
+			std::string name;
+			World::Mask reads;
+			World::Mask writes;
+			Function function;
+
+			std::vector<size_t> dependents;
+			size_t dependencyCount;
+			std::atomic<size_t> remaining;
+			double time;
+		};
+
+		World& world;
+
+		std::vector<std::unique_ptr<System>> systems;
+		bool dirty;
+
+		std::vector<CommandBuffer> commandBuffers;
+
+		void build();
+		void launch(const size_t index, Jobs::Counter& counter);
+	public:
+		Scheduler(World& world);
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		// Runs function once per frame with the given access. It may read
+		// and write the listed components anywhere in the world, but must
+		// not change the world's structure; use getCommands() for that.
+		void add(const std::string& name, const World::Mask& reads, const World::Mask& writes, Function function);
+
+		// Runs function(components&...) or function(entity, components&...)
+		// for every entity matching T..., over chunk ranges on several
+		// workers at once. const T is read, T is written.
+		template<typename... T, typename Each>
+		void add(const std::string& name, Each function) {
+			World::Mask reads, writes;
+			((std::is_const_v<T> ? reads : writes).set(World::getComponentId<T>()), ...);
+
+			std::shared_ptr<World::Query<T...>> query = std::make_shared<World::Query<T...>>(this->world.query<T...>());
+
+			this->add(name, reads, writes, [query, function](World&) {
+				Jobs::parallelFor(0, query->getChunkCount(), 1, [&query, &function](size_t begin, size_t end) {
+					query->each(begin, end, function);
+				});
+			});
+		}
+
+		// Runs every system, then applies the command buffers in thread
+		// order. Returns once the frame's systems are done.
+		void run();
+
+		// Command buffer of the calling thread, for use inside systems. Fetch
+		// it where it is used; a job that waits may continue on another thread.
+		CommandBuffer& getCommands();
+
+		size_t getSystemCount() const;
+		const std::string& getSystemName(const size_t index) const;
+		// Systems the given one waits for, by index.
+		std::vector<size_t> getDependencies(const size_t index) const;
+		// Wall time of the system's last run in milliseconds.
+		double getSystemTime(const size_t index) const;
+	};
+}
@@ -0,0 +1,308 @@
+#include "transform.h"
+
+#include "../jobs/jobs.h"
+
+namespace Engine {
+	// Below this many nodes the update stays on the calling thread.
+	static const size_t PARALLEL_NODES = 4096;
+	static const size_t ROOT_GRAIN = 16;
+
+	TransformHierarchy::TransformHierarchy() : ordered(true) {
+	}
+
+	TransformHierarchy::Node TransformHierarchy::create(const Node parent) {
+		Node node;
+
+		if (!this->freeNodes.empty()) {
+			node = this->freeNodes.back();
+			this->freeNodes.pop_back();
+		}
+		else {
+			node = (Node)this->slots.size();
+			this->slots.push_back(NONE);
+		}
+
+		const uint32_t slot = (uint32_t)this->nodes.size();
+		const uint32_t parentSlot = this->isValid(parent) ? this->slots[parent] : NONE;
+
+		this->parents.push_back(parentSlot);
+		this->subtreeSizes.push_back(1);
+		this->positions.push_back(glm::vec3(0.0f));
+		this->rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		this->scales.push_back(glm::vec3(1.0f));
+		this->flags.push_back(DIRTY);
+		this->worldMatrices.push_back(glm::aligned_mat4(1.0f));
+		this->nodes.push_back(node);
+
+		this->slots[node] = slot;
+
+		// A new root at the end keeps the order intact; a child needs to
+		// move next to its parent.
+		if (parentSlot == NONE && this->ordered) {
+			this->roots.push_back(slot);
+		}
+		else {
+			this->ordered = false;
+		}
+
+		return node;
+	}
+	void TransformHierarchy::destroy(const Node node) {
+		if (!this->isValid(node)) return;
+
+		this->flags[this->slots[node]] |= DESTROYED;
+		this->ordered = false;
+	}
+	bool TransformHierarchy::isValid(const Node node) const {
+		return node < this->slots.size() && this->slots[node] != NONE && !(this->flags[this->slots[node]] & DESTROYED);
+	}
+
+	bool TransformHierarchy::setParent(const Node node, const Node parent) {
+		if (!this->isValid(node)) return false;
+
+		const uint32_t slot = this->slots[node];
+		const uint32_t parentSlot = this->isValid(parent) ? this->slots[parent] : NONE;
+
+		// Refuse to hang a node below itself.
+		for (uint32_t ancestor = parentSlot; ancestor != NONE; ancestor = this->parents[ancestor]) {
+			if (ancestor == slot) return false;
+		}
+
+		this->parents[slot] = parentSlot;
+		this->flags[slot] |= DIRTY;
+		this->ordered = false;
+
+		return true;
+	}
+	TransformHierarchy::Node TransformHierarchy::getParent(const Node node) const {
+		const uint32_t parentSlot = this->parents[this->slots[node]];
+		return parentSlot == NONE ? NONE : this->nodes[parentSlot];
+	}
+
+	void TransformHierarchy::setPosition(const Node node, const glm::vec3& position) {
+		const uint32_t slot = this->slots[node];
+
+		this->positions[slot] = position;
+		this->flags[slot] |= DIRTY;
+	}
+	void TransformHierarchy::setRotation(const Node node, const glm::quat& rotation) {
+		const uint32_t slot = this->slots[node];
+
+		this->rotations[slot] = rotation;
+		this->flags[slot] |= DIRTY;
+	}
+	void TransformHierarchy::setScale(const Node node, const glm::vec3& scale) {
+		const uint32_t slot = this->slots[node];
+
+		this->scales[slot] = scale;
+		this->flags[slot] |= DIRTY;
+	}
+	void TransformHierarchy::setLocal(const Node node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		const uint32_t slot = this->slots[node];
+
+		this->positions[slot] = position;
+		this->rotations[slot] = rotation;
+		this->scales[slot] = scale;
+		this->flags[slot] |= DIRTY;
+	}
+
+	const glm::vec3& TransformHierarchy::getPosition(const Node node) const {
+		return this->positions[this->slots[node]];
+	}
+	const glm::quat& TransformHierarchy::getRotation(const Node node) const {
+		return this->rotations[this->slots[node]];
+	}
+	const glm::vec3& TransformHierarchy::getScale(const Node node) const {
+		return this->scales[this->slots[node]];
+	}
+
+	const glm::aligned_mat4& TransformHierarchy::getWorldMatrix(const Node node) const {
+		return this->worldMatrices[this->slots[node]];
+	}
+	glm::vec3 TransformHierarchy::getWorldPosition(const Node node) const {
+		return glm::vec3(this->worldMatrices[this->slots[node]][3]);
+	}
+
+	void TransformHierarchy::reorder() {
+		const uint32_t count = (uint32_t)this->nodes.size();
+
+		// A node survives if neither it nor an ancestor was destroyed.
+		// Parents may sit after their children here, so resolve each chain
+		// once and remember the answer.
+		enum State : uint8_t { UNKNOWN, ALIVE, DEAD };
+		std::vector<State> states(count, UNKNOWN);
+		std::vector<uint32_t> chain;
+
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			uint32_t current = slot;
+			while (current != NONE && states[current] == UNKNOWN && !(this->flags[current] & DESTROYED)) {
+				chain.push_back(current);
+				current = this->parents[current];
+			}
+
+			const State state = current == NONE ? ALIVE : (states[current] == UNKNOWN ? DEAD : states[current]);
+			if (current != NONE && states[current] == UNKNOWN) states[current] = DEAD;
+
+			for (uint32_t link : chain) states[link] = state;
+			chain.clear();
+		}
+
+		// Children of every slot, in slot order, for a depth-first walk.
+		std::vector<uint32_t> childStarts(count + 1, 0);
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			if (states[slot] == ALIVE && this->parents[slot] != NONE) ++childStarts[this->parents[slot] + 1];
+		}
+		for (uint32_t slot = 0; slot < count; ++slot) childStarts[slot + 1] += childStarts[slot];
+
+		std::vector<uint32_t> children(childStarts[count]);
+		std::vector<uint32_t> filled(childStarts.begin(), childStarts.end() - 1);
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			if (states[slot] == ALIVE && this->parents[slot] != NONE) children[filled[this->parents[slot]]++] = slot;
+		}
+
+		std::vector<uint32_t> order;
+		order.reserve(count);
+
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			if (states[slot] != ALIVE || this->parents[slot] != NONE) continue;
+
+			chain.push_back(slot);
+			while (!chain.empty()) {
+				const uint32_t current = chain.back();
+				chain.pop_back();
+				order.push_back(current);
+
+				for (uint32_t child = childStarts[current + 1]; child > childStarts[current]; --child) chain.push_back(children[child - 1]);
+			}
+		}
+
+		// Move everything to its new slot.
+		std::vector<uint32_t> newSlots(count, NONE);
+		for (uint32_t slot = 0; slot < (uint32_t)order.size(); ++slot) newSlots[order[slot]] = slot;
+
+		for (uint32_t slot = 0; slot < count; ++slot) {
+			if (states[slot] != ALIVE) {
+				this->slots[this->nodes[slot]] = NONE;
+				this->freeNodes.push_back(this->nodes[slot]);
+			}
+		}
+
+		std::vector<uint32_t> parents(order.size());
+		std::vector<glm::vec3> positions(order.size());
+		std::vector<glm::quat> rotations(order.size());
+		std::vector<glm::vec3> scales(order.size());
+		std::vector<uint8_t> flags(order.size());
+		std::vector<glm::aligned_mat4> worldMatrices(order.size());
+		std::vector<Node> nodes(order.size());
+
+		for (uint32_t slot = 0; slot < (uint32_t)order.size(); ++slot) {
+			const uint32_t previous = order[slot];
+			const uint32_t parent = this->parents[previous];
+
+			parents[slot] = parent == NONE ? NONE : newSlots[parent];
+			positions[slot] = this->positions[previous];
+			rotations[slot] = this->rotations[previous];
+			scales[slot] = this->scales[previous];
+			flags[slot] = this->flags[previous];
+			worldMatrices[slot] = this->worldMatrices[previous];
+			nodes[slot] = this->nodes[previous];
+
+			this->slots[nodes[slot]] = slot;
+		}
+
+		this->parents.swap(parents);
+		this->positions.swap(positions);
+		this->rotations.swap(rotations);
+		this->scales.swap(scales);
+		this->flags.swap(flags);
+		this->worldMatrices.swap(worldMatrices);
+		this->nodes.swap(nodes);
+
+		// Children come after their parents, so one backward pass sums
+		// subtree sizes.
+		this->subtreeSizes.assign(order.size(), 1);
+		this->roots.clear();
+
+		for (uint32_t slot = (uint32_t)order.size(); slot-- > 0;) {
+			if (this->parents[slot] != NONE) this->subtreeSizes[this->parents[slot]] += this->subtreeSizes[slot];
+		}
+		for (uint32_t slot = 0; slot < (uint32_t)order.size(); ++slot) {
+			if (this->parents[slot] == NONE) this->roots.push_back(slot);
+		}
+
+		this->ordered = true;
+	}
+
+	void TransformHierarchy::compute(const uint32_t slot) {
+		const glm::quat& rotation = this->rotations[slot];
+		const glm::vec3& scale = this->scales[slot];
+		const glm::vec3& position = this->positions[slot];
+
+		const float xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+		const float xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+		const float wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+
+		// Local basis: rotation columns times scale; w is 0 for all three.
+		const glm::vec3 x = glm::vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy)) * scale.x;
+		const glm::vec3 y = glm::vec3(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx)) * scale.y;
+		const glm::vec3 z = glm::vec3(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)) * scale.z;
+
+		glm::aligned_mat4& world = this->worldMatrices[slot];
+		const uint32_t parent = this->parents[slot];
+
+		if (parent == NONE) {
+			world[0] = glm::aligned_vec4(x, 0.0f);
+			world[1] = glm::aligned_vec4(y, 0.0f);
+			world[2] = glm::aligned_vec4(z, 0.0f);
+			world[3] = glm::aligned_vec4(position, 1.0f);
+			return;
+		}
+
+		// parent * local, skipping the terms the local matrix's last row
+		// (0, 0, 0, 1) zeroes out.
+		const glm::aligned_mat4& parentWorld = this->worldMatrices[parent];
+
+		world[0] = parentWorld[0] * x.x + parentWorld[1] * x.y + parentWorld[2] * x.z;
+		world[1] = parentWorld[0] * y.x + parentWorld[1] * y.y + parentWorld[2] * y.z;
+		world[2] = parentWorld[0] * z.x + parentWorld[1] * z.y + parentWorld[2] * z.z;
+		world[3] = parentWorld[0] * position.x + parentWorld[1] * position.y + parentWorld[2] * position.z + parentWorld[3];
+	}
+	void TransformHierarchy::updateRange(const uint32_t begin, const uint32_t end) {
+		uint32_t slot = begin;
+
+		while (slot < end) {
+			if (!(this->flags[slot] & DIRTY)) {
+				++slot;
+				continue;
+			}
+
+			// Everything below a changed node moves with it.
+			const uint32_t subtreeEnd = slot + this->subtreeSizes[slot];
+
+			for (; slot < subtreeEnd; ++slot) {
+				this->compute(slot);
+				this->flags[slot] &= ~DIRTY;
+			}
+		}
+	}
+
+	void TransformHierarchy::update() {
+		if (!this->ordered) this->reorder();
+		if (this->roots.empty()) return;
+
+		if (this->nodes.size() < PARALLEL_NODES || this->roots.size() == 1) {
+			this->updateRange(0, (uint32_t)this->nodes.size());
+			return;
+		}
+
+		// Consecutive roots own consecutive slot ranges.
+		Jobs::parallelFor(0, this->roots.size(), ROOT_GRAIN, [this](size_t begin, size_t end) {
+			const uint32_t last = this->roots[end - 1];
+			this->updateRange(this->roots[begin], last + this->subtreeSizes[last]);
+		});
+	}
+
+	size_t TransformHierarchy::getNodeCount() const {
+		return this->nodes.size();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../include/glm/glm.hpp"
+#include "../../include/glm/gtc/quaternion.hpp"
+#include "../../include/glm/gtc/type_aligned.hpp"
+
+namespace Engine {
+	// Parent-relative transforms in flat arrays. Nodes are kept in
+	// hierarchy order: every node comes before its descendants and each
+	// subtree is one contiguous range, so world matrices are computed in
+	// one forward pass. update() recomputes only subtrees below nodes
+	// changed since the last call, and handles root subtrees in parallel
+	// on the job workers.
+	//
+	// World matrices are glm::aligned_mat4; with GLM_FORCE_INTRINSICS
+	// (set by build.zig) their column arithmetic compiles to SIMD.
+	class TransformHierarchy {
+	public:
+		typedef uint32_t Node;
+
+		static constexpr Node NONE = UINT32_MAX;
+	private:
+		enum Flags : uint8_t {
+			DIRTY = 1,
+			DESTROYED = 2
+		};
+
+		// Indexed by slot, in hierarchy order once ordered is true.
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> subtreeSizes;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<uint8_t> flags;
+		std::vector<glm::aligned_mat4> worldMatrices;
+		std::vector<Node> nodes;
+
+		// Slot of every node, NONE for free handles.
+		std::vector<uint32_t> slots;
+		std::vector<Node> freeNodes;
+		// First slot of every root subtree.
+		std::vector<uint32_t> roots;
+
+		// False after create, setParent or destroy until the next reorder.
+		bool ordered;
+
+		void reorder();
+		void updateRange(const uint32_t begin, const uint32_t end);
+		void compute(const uint32_t slot);
+	public:
+		TransformHierarchy();
+
+		Node create(const Node parent);
+		// The node's descendants go with it at the next update().
+		void destroy(const Node node);
+		bool isValid(const Node node) const;
+
+		// NONE makes the node a root. Fails if parent is inside the node's
+		// own subtree.
+		bool setParent(const Node node, const Node parent);
+		Node getParent(const Node node) const;
+
+		void setPosition(const Node node, const glm::vec3& position);
+		void setRotation(const Node node, const glm::quat& rotation);
+		void setScale(const Node node, const glm::vec3& scale);
+		void setLocal(const Node node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+		const glm::vec3& getPosition(const Node node) const;
+		const glm::quat& getRotation(const Node node) const;
+		const glm::vec3& getScale(const Node node) const;
+
+		// As of the last update().
+		const glm::aligned_mat4& getWorldMatrix(const Node node) const;
+		glm::vec3 getWorldPosition(const Node node) const;
+
+		void update();
+
+		size_t getNodeCount() const;
+	};
+}
@@ -1,5 +1,7 @@
 #include "engine/engine.h"
 
+#include <filesystem>
+
 int main() {
     Engine::WindowCreateInfo info;
 
@@ -10,10 +12,17 @@ int main() {
 
 #if GAME_DEBUG
     std::ostringstream ossResolution;
-    ossResolution << "main: Resolution: " << Engine::Window::getWidth() << "x" << TT::Window::getHeight();
+    ossResolution << "main: Resolution: " << Engine::Window::getWidth() << "x" << Engine::Window::getHeight();
     std::string formattedResolution = ossResolution.str();
 
     Logger::Log(Logger::INFO, formattedResolution);
+
+    Engine::ShaderHotReload::enable();
+#else
+    // Release builds read packed assets; debug keeps loose files for hot reload.
+    if (std::filesystem::exists("assets.pack")) {
+        Engine::Assets::mount("assets.pack");
+    }
 #endif
 
     while (Engine::Window::isRunning())
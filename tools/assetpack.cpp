@@ -0,0 +1,95 @@
+#include "../engine/archive/archive.h"
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Packs loose asset files into one ".pack" archive that the engine mounts
+// with Engine::Assets::mount. Entries keep the paths given on the command
+// line, so run it from the directory the game loads assets from.
+
+static void printUsage() {
+	std::cerr << "usage: assetpack <output.pack> [--lz4] [--align <bytes>] <files or directories...>\n"
+		<< "  --lz4    compress entries that shrink with LZ4\n"
+		<< "  --align  blob alignment, a power of two (default 16)\n";
+}
+
+static bool readFile(const std::filesystem::path& path, std::vector<std::byte>& data) {
+	std::ifstream stream(path, std::ios::binary | std::ios::ate);
+	if (!stream.is_open()) return false;
+
+	data = std::vector<std::byte>((size_t)stream.tellg());
+	stream.seekg(0);
+
+	return (bool)stream.read((char*)data.data(), (std::streamsize)data.size());
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+
+	const std::string output = argv[1];
+
+	bool compress = false;
+	uint32_t alignment = 16;
+	std::vector<std::filesystem::path> files;
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument == "--lz4") {
+			compress = true;
+		}
+		else if (argument == "--align" && i + 1 < argc) {
+			alignment = (uint32_t)std::stoul(argv[++i]);
+		}
+		else if (std::filesystem::is_directory(argument)) {
+			for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(argument)) {
+				if (entry.is_regular_file()) files.push_back(entry.path());
+			}
+		}
+		else if (std::filesystem::is_regular_file(argument)) {
+			files.push_back(argument);
+		}
+		else {
+			std::cerr << "assetpack: no such file or directory \"" << argument << "\"\n";
+			printUsage();
+			return 1;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Engine::AssetArchiveBuilder builder;
+	size_t totalBytes = 0;
+
+	for (const std::filesystem::path& file : files) {
+		std::vector<std::byte> data;
+
+		if (!readFile(file, data)) {
+			std::cerr << "assetpack: could not read \"" << file.string() << "\"\n";
+			return 1;
+		}
+
+		totalBytes += data.size();
+		builder.add(file.generic_string(), std::move(data), compress);
+	}
+
+	std::string error;
+	if (!builder.save(output, alignment, error)) {
+		std::cerr << "assetpack: " << error << '\n';
+		return 1;
+	}
+
+	const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << output << ": " << files.size() << " files, " << totalBytes << " bytes -> "
+		<< std::filesystem::file_size(output) << " bytes" << (compress ? " (LZ4)" : "") << ", " << milliseconds << " ms\n";
+
+	return 0;
+}
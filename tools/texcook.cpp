@@ -0,0 +1,79 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "../include/stb_image.h"
+
+#include "../engine/ctex/ctex.h"
+
+#include <iostream>
+#include <string>
+#include <chrono>
+
+// Cooks PNG/JPG/TGA images into block-compressed ".ctex" textures with a
+// precomputed mip chain, so the game uploads them without decoding.
+// Runs on the CPU only.
+
+static void printUsage() {
+	std::cerr << "usage: texcook <input> <output.ctex> [bc1|bc3|bc4|bc5] [--srgb] [--no-mipmaps]\n"
+		<< "  bc1  RGB, 4 bits per texel (default)\n"
+		<< "  bc3  RGBA, 8 bits per texel\n"
+		<< "  bc4  R, 4 bits per texel\n"
+		<< "  bc5  RG (normal maps), 8 bits per texel\n";
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+
+	const std::string input = argv[1];
+	const std::string output = argv[2];
+
+	Engine::CompressedTexture::Format format = Engine::CompressedTexture::BC1;
+	bool srgb = false, mipmaps = true;
+
+	for (int i = 3; i < argc; ++i) {
+		const std::string argument = argv[i];
+
+		if (argument == "bc1") format = Engine::CompressedTexture::BC1;
+		else if (argument == "bc3") format = Engine::CompressedTexture::BC3;
+		else if (argument == "bc4") format = Engine::CompressedTexture::BC4;
+		else if (argument == "bc5") format = Engine::CompressedTexture::BC5;
+		else if (argument == "--srgb") srgb = true;
+		else if (argument == "--no-mipmaps") mipmaps = false;
+		else {
+			std::cerr << "texcook: unknown argument \"" << argument << "\"\n";
+			printUsage();
+			return 1;
+		}
+	}
+
+	// Match the engine, which flips images on load for OpenGL's origin.
+	stbi_set_flip_vertically_on_load(true);
+
+	int width, height, channels;
+	uint8_t* pixels = stbi_load(input.c_str(), &width, &height, &channels, 4);
+
+	if (!pixels) {
+		std::cerr << "texcook: could not load \"" << input << "\": " << stbi_failure_reason() << '\n';
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Engine::CompressedTexture texture = Engine::CompressedTexture::cook(pixels, (uint32_t)width, (uint32_t)height, format, srgb, mipmaps);
+	stbi_image_free(pixels);
+
+	const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (!texture.save(output)) {
+		std::cerr << "texcook: could not write \"" << output << "\"\n";
+		return 1;
+	}
+
+	std::cout << input << " -> " << output << ": " << width << "x" << height << ' '
+		<< Engine::CompressedTexture::getFormatName(format) << (srgb ? " sRGB" : "") << ", "
+		<< texture.levels.size() << " levels, " << texture.data.size() << " bytes ("
+		<< (size_t)width * height * 4 << " uncompressed), " << milliseconds << " ms\n";
+
+	return 0;
+}